@@ -17,7 +17,6 @@ except:
 
 import os, gc
 from glob import glob
-from threading import Thread, Lock, Event
 try:
     from PIL import Image, ImageTk
 except:
@@ -142,9 +141,8 @@ class CameraWindow(Tkinter.Toplevel):
             if ((modelList is None) and (len(models) == 0)):
                 tkMessageBox.showerror(title = 'No models found', message = 'The specified directory does not contain any model file.')
             else:
-                self.detectorLock.acquire()
                 try:
-                    # Destroy old detector (if any)
+                    # Destroy old detector (if any) and the stream running on it
                     if not (self.detector is None):
                         del self.detector
                     # Create new detector
@@ -162,7 +160,6 @@ class CameraWindow(Tkinter.Toplevel):
                 except Exception as e:
                     tkMessageBox.showerror(title = 'Detector initialization failed', message = 'Could not initialize detector:\n{!s}'.format(e))
                     self.detector = None
-                self.detectorLock.release()
 
 
     def changeDevice(self, deviceIndex):
@@ -176,6 +173,8 @@ class CameraWindow(Tkinter.Toplevel):
             if not (self.currentDevice is None):
                 self.after_cancel(self.pollId)
                 del self.currentDevice # stop running capture
+            if not (self.detector is None):
+                self.detector.stopStream()
             if (deviceIndex < 0):
                 self.fpsText.set('No device opened')
                 del self.lblVideo._img
@@ -188,8 +187,6 @@ class CameraWindow(Tkinter.Toplevel):
                 if self.detector is None:
                     self.initializeDetector()
                 if not (self.detector is None):
-                    if not self.detectorThread.is_alive():
-                        self.detectorThread.start()
                     self.currentDeviceIndex = deviceIndex
                     self.currentDevice = Capture(deviceIndex)
                     self.fpsTimer.start()
@@ -206,6 +203,22 @@ class CameraWindow(Tkinter.Toplevel):
                 # Scale down if camera input is high-resolution
                 if (frame.size[0] > self.maxVideoSize[0]) or (frame.size[1] > self.maxVideoSize[1]):
                     frame.thumbnail(self.maxVideoSize, Image.BILINEAR)
+                # Provide the frame to the stream detector, which processes the stages of detection
+                # of consecutive frames concurrently and drops frames it cannot keep up with
+                if not (self.detector is None):
+                    self.detector.pushFrame(frame)
+                    self.detectionTimer.start()
+                # Check for new detection results
+                result = self.detector.getStreamDetections() if not (self.detector is None) else None
+                if not (result is None):
+                    self.detections = result[1]
+                    for d in self.detections:
+                        if not d.classname in self.colorMap:
+                            self.colorMap[d.classname] = gui_utils.getAnnotationColor(self.nextColorIndex)
+                            self.nextColorIndex += 1
+                    self.frmDetection.detections = self.detections
+                    self.detectionTimer.stop()
+                    self.detectionTimer.start()
                 # Draw bounding boxes
                 for d in self.detections:
                     frame = d.drawToImage(frame, self.colorMap[d.classname] if d.classname in self.colorMap else (0, 0, 0))
@@ -218,21 +231,6 @@ class CameraWindow(Tkinter.Toplevel):
                     self.fpsTimer.stop()
                     self.fpsFrameCount = 0
                     self.fpsTimer.start()
-                # Check for new detection results
-                if self.detectionsAvailable.is_set():
-                    for d in self.detections:
-                        if not d.classname in self.colorMap:
-                            self.colorMap[d.classname] = gui_utils.getAnnotationColor(self.nextColorIndex)
-                            self.nextColorIndex += 1
-                    self.frmDetection.detections = self.detections
-                    self.detectionsAvailable.clear()
-                    self.detectionTimer.stop()
-                # Provide a copy of the frame to the detecting thread
-                if self.needNewFrame.is_set():
-                    self.detectionFrame = frame.copy()
-                    self.needNewFrame.clear()
-                    self.frameAvailable.set()
-                    self.detectionTimer.start()
                 # Update frame and detection rate
                 self.fpsText.set('{:.1f} frames/sec  |  {:.1f} detections/sec  |  {:d} models loaded'.format(\
                     10.0 * self.fpsTimer.rate, self.detectionTimer.rate, self.numModels))
@@ -241,22 +239,6 @@ class CameraWindow(Tkinter.Toplevel):
                 self.pollId = self.after(1, self.pollVideoFrame)
 
 
-    def detect_threaded(self):
-        """Detects objects in the video stream in a separate thread."""
-        
-        self.needNewFrame.set()
-        while not self.terminateThread.is_set():
-            if self.frameAvailable.wait(1):
-                self.frameAvailable.clear()
-                self.detectorLock.acquire()
-                try:
-                    self.detections = self.detector.detect(self.detectionFrame)
-                finally:
-                    self.detectorLock.release()
-                self.detectionsAvailable.set()
-                self.needNewFrame.set()
-
-
     def _createWidgets(self):
         s = ttk.Style(self.master)
         s.configure("CameraDetection.TFrame", background = '#cacaca')
@@ -324,14 +306,7 @@ class CameraWindow(Tkinter.Toplevel):
         self.nextColorIndex = 0
         self.maxVideoSize = tuple(config.getInt('GUI', x, min = 64) for x in ('max_video_width', 'max_video_height'))
         self.detector = None # Detector instance created by initializeDetector()
-        self.detections = ()
-        self.detectionFrame = None # copy of a video frame for the detecting thread to work on
-        self.detectorThread = Thread(name = 'CameraDetectorThread', target = self.detect_threaded)
-        self.detectorLock = Lock()
-        self.needNewFrame = Event() # signalled if the detecting thread request a new frame
-        self.frameAvailable = Event() # signalled if a frame has been provided in 'detectionFrame' for the detecting thread
-        self.detectionsAvailable = Event() # signalled if the detecting thread has stored new results in 'detections'
-        self.terminateThread = Event() # signalled if the detecting thread shall terminate
+        self.detections = () # detections of the latest frame processed by the stream detector
         self.currentDevice = None # Capture object of the currently opened device
         self.currentDeviceIndex = -1
         self.fpsTimer = utils.Timer(1)
@@ -354,10 +329,9 @@ class CameraWindow(Tkinter.Toplevel):
         if (evt.widget is self):
             if not (self.currentDevice is None):
                 self.after_cancel(self.pollId)
-            # Stop detecting thread
-            if self.detectorThread.is_alive():
-                self.terminateThread.set()
-                self.detectorThread.join()
+            # Stop stream detector
+            if not (self.detector is None):
+                self.detector.stopStream()
             # Stop running capture
             if not (self.currentDevice is None):
                 del self.currentDevice
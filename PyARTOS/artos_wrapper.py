@@ -20,6 +20,14 @@ THOPT_NONE = 0
 THOPT_OVERLAPPING = 1
 THOPT_LOOCV = 2
 
+FILTER_CACHE_FULL = 0
+FILTER_CACHE_HALF_PRECISION = 1
+FILTER_CACHE_ON_THE_FLY = 2
+
+FFT_PLANNING_ESTIMATE = 0
+FFT_PLANNING_MEASURE = 1
+FFT_PLANNING_PATIENT = 2
+
 PARAM_TYPE_INT = 0
 PARAM_TYPE_SCALAR = 1
 PARAM_TYPE_STRING = 2
@@ -72,6 +80,19 @@ class FlatDetection(Structure):
                 ('bottom', c_int)]
 
 
+# FlatBatchStatistics structure definition according to libartos.h
+class FlatBatchStatistics(Structure):
+    _fields_ = [('num_images', c_uint),
+                ('num_threads', c_uint),
+                ('seconds', c_float),
+                ('images_per_second', c_float),
+                ('mean_latency', c_float),
+                ('latency_p50', c_float),
+                ('latency_p90', c_float),
+                ('latency_p99', c_float),
+                ('max_latency', c_float)]
+
+
 # FlatBoundingBox structure definition according to libartos.h
 class FlatBoundingBox(Structure):
     _fields_ = [('left', c_uint),
@@ -127,6 +148,7 @@ c_ubyte_p = POINTER(c_ubyte)
 c_uint_p = POINTER(c_uint)
 c_float_p = POINTER(c_float)
 FlatDetection_p = POINTER(FlatDetection)
+FlatBatchStatistics_p = POINTER(FlatBatchStatistics)
 FlatBoundingBox_p = POINTER(FlatBoundingBox)
 RawTestResult_p = POINTER(RawTestResult)
 SynsetSearchResult_p = POINTER(SynsetSearchResult)
@@ -182,12 +204,68 @@ class _LibARTOS(object):
             self._errcheck_num_fe
         )
         
+        # get_patchwork_geometry function
+        self._register_func('get_patchwork_geometry',
+            (c_int, c_uint, c_uint_p, c_uint_p, c_uint_p),
+            ((1, 'detector'), (1, 'plane_width'), (1, 'plane_height'), (1, 'num_planes'))
+        )
+        
+        # set_filter_cache_policy function
+        self._register_func('set_filter_cache_policy',
+            (c_int, c_uint, c_uint, c_ulonglong),
+            ((1, 'detector'), (1, 'policy'), (1, 'budget', 0))
+        )
+        
+        # get_filter_cache_memory function
+        self._register_func('get_filter_cache_memory',
+            (c_int, c_uint, POINTER(c_ulonglong)),
+            ((1, 'detector'), (1, 'bytes'))
+        )
+        
+        # set_fft_planning_rigor function
+        self._register_func('set_fft_planning_rigor',
+            (c_int, c_uint, c_uint, c_bool),
+            ((1, 'detector'), (1, 'rigor'), (1, 'background_upgrade', False))
+        )
+        
+        # set_fftw_wisdom_file function
+        self._register_func('set_fftw_wisdom_file',
+            (None, c_char_p),
+            ((1, 'wisdom_file'),)
+        )
+        
         # detect_file_jpeg function
         self._register_func('detect_file_jpeg',
             (c_int, c_uint, c_char_p, FlatDetection_p, c_uint_p),
             ((1, 'detector'), (1, 'imagefile'), (1, 'detection_buf'), (1, 'detection_buf_size'))
         )
 
+        # detect_batch_files_jpeg function
+        self._register_func('detect_batch_files_jpeg',
+            (c_int, c_uint, POINTER(c_char_p), c_uint, FlatDetection_p, c_uint, c_uint_p, POINTER(c_int), c_uint, FlatBatchStatistics_p),
+            ((1, 'detector'), (1, 'imagefiles'), (1, 'num_images'), (1, 'detection_buf'), (1, 'max_detections'),
+             (1, 'num_detections'), (1, 'image_results', None), (1, 'num_threads', 0), (1, 'stats', None))
+        )
+
+        # stream_push_raw function
+        self._register_func('stream_push_raw',
+            (c_int, c_uint, c_ubyte_p, c_uint, c_uint, c_bool, c_uint_p),
+            ((1, 'detector'), (1, 'img_data'), (1, 'img_width'), (1, 'img_height'), (1, 'grayscale'), (1, 'frame_id', None))
+        )
+        
+        # stream_get_detections function
+        self._register_func('stream_get_detections',
+            (c_int, c_uint, FlatDetection_p, c_uint_p, c_uint_p, c_uint),
+            ((1, 'detector'), (1, 'detection_buf'), (1, 'detection_buf_size'), (1, 'frame_id', None), (1, 'timeout', 0)),
+            self._errcheck_stream_get_detections
+        )
+        
+        # stream_stop function
+        self._register_func('stream_stop',
+            (c_int, c_uint),
+            ((1, 'detector'),)
+        )
+
         # detect_file_featuredump function
         self._register_func('detect_file_featuredump',
             (c_int, c_uint, c_char_p, c_uint, c_uint, FlatDetection_p, c_uint_p),
@@ -498,6 +576,13 @@ class _LibARTOS(object):
         return args
 
 
+    @staticmethod
+    def _errcheck_stream_get_detections(result, func, args):
+        if (result < 0) and (result != DETECT_RES_NO_RESULTS):
+            raise LibARTOSException(result)
+        return args
+
+
     @staticmethod
     def _errcheck_common(result, func, args):
         if (result < 0):
@@ -256,6 +256,76 @@ class Detector(object):
         """
         
         return libartos.num_feature_extractors_in_detector(self.handle)
+    
+    
+    def patchworkGeometry(self):
+        """Returns the geometry of the patchwork planes used for computing convolutions in the Fourier domain.
+        
+        The plane size is chosen by a cost model when the first image is processed and whenever an image does not fit
+        into the current planes, so it may be used to track the effect of different image resolutions on the detector.
+        
+        Returns: A `(width, height, num_planes)` tuple, where `num_planes` is the number of planes needed for the last image.
+                 If no image has been processed yet, all values will be 0.
+        """
+        
+        width, height, num_planes = ctypes.c_uint(0), ctypes.c_uint(0), ctypes.c_uint(0)
+        libartos.get_patchwork_geometry(self.handle, width, height, num_planes)
+        return (width.value, height.value, num_planes.value)
+    
+    
+    def setFilterCachePolicy(self, policy, budget = 0):
+        """Selects how the transformed filters of the models are kept in memory between detections.
+        
+        policy - One of the following constants from the artos_wrapper module:
+                 FILTER_CACHE_FULL - Keep the transformed filters in single precision (default, fastest).
+                 FILTER_CACHE_HALF_PRECISION - Keep them in half precision, which halves the memory needed at
+                                               the cost of a conversion on each use and a slight loss of accuracy.
+                 FILTER_CACHE_ON_THE_FLY - Do not keep them, but transform the filters on each detection.
+        budget - Maximum number of bytes to be occupied by cached filters. If exceeded, the filters of the classes
+                 used least recently will be evicted from the cache. 0 means no limit. The budget applies to each
+                 thread processing images concurrently (e.g. the workers of detectBatch()) separately, since
+                 each of them keeps a cache of its own.
+        
+        If an invalid policy is given, a LibARTOSException is thrown.
+        """
+        
+        libartos.set_filter_cache_policy(self.handle, policy, budget)
+    
+    
+    def filterCacheMemory(self):
+        """Returns the number of bytes currently occupied by the cached transformed filters of the models,
+        summed up over all threads used by the detector."""
+        
+        bytes = ctypes.c_ulonglong(0)
+        libartos.get_filter_cache_memory(self.handle, bytes)
+        return bytes.value
+    
+    
+    def setPlanningRigor(self, rigor, backgroundUpgrade = False):
+        """Sets how much time FFTW spends on planning the transforms whenever the size of the images increases.
+        
+        rigor - One of the following constants from the artos_wrapper module:
+                FFT_PLANNING_ESTIMATE - Plan heuristically (fast planning, slower transforms).
+                FFT_PLANNING_MEASURE - Measure some candidate plans.
+                FFT_PLANNING_PATIENT - Measure many candidate plans (default, slow planning, fastest transforms).
+        backgroundUpgrade - If set to True and the requested plans cannot be obtained from FFTW wisdom, the detector
+                            will start with estimated plans and switch to plans of the requested rigor as soon as
+                            they have been created by a background thread.
+        
+        If an invalid rigor is given, a LibARTOSException is thrown.
+        """
+        
+        libartos.set_fft_planning_rigor(self.handle, rigor, backgroundUpgrade)
+    
+    
+    @staticmethod
+    def setWisdomFile(filename):
+        """Sets the file FFTW wisdom is loaded from and saved to by all detectors.
+        
+        filename - Path of the wisdom file. An empty string disables loading and saving wisdom.
+        """
+        
+        libartos.set_fftw_wisdom_file(utils.str2bytes(filename))
 
 
     def detect(self, img, limit = 3):
@@ -292,6 +362,101 @@ class Detector(object):
         return [Detection.fromFlatDetection(buf[i]) for i in range(buf_size.value)]
     
 
+    def detectBatch(self, imgFiles, limit = 3, numThreads = 0, returnStatistics = False):
+        """Detects objects in a batch of JPEG images, which are processed concurrently by a pool of worker threads.
+        
+        This is faster than calling detect() for each image, especially when dealing with many small images.
+        
+        imgFiles - Sequence with the paths of the JPEG files.
+        limit - Maximum number of detections returned per image (affects memory allocated for library call).
+        numThreads - Number of worker threads. 0 means the number of available CPU threads.
+        returnStatistics - If set to True, a dictionary with the throughput and the distribution of the time
+                           needed per image (in milliseconds) will be returned in addition.
+        Returns: A list with a list of Detection instances for each image. If returnStatistics is True, a tuple
+                 of that list and a dictionary with the statistics.
+        
+        If an error occurs, a LibARTOSException is thrown.
+        """
+        
+        if utils.is_str(imgFiles):
+            raise TypeError('{0}.detectBatch expects argument imgFiles to be a sequence of strings'.format(self.__class__.__name__))
+        if (limit < 1):
+            limit = 1
+        
+        # Allocate buffer memory, where the library will store the detection results
+        numImages = len(imgFiles)
+        filenames = (ctypes.c_char_p * numImages)(*(utils.str2bytes(f) for f in imgFiles))
+        buf = (artos_wrapper.FlatDetection * (numImages * limit))()
+        numDetections = (ctypes.c_uint * numImages)()
+        stats = artos_wrapper.FlatBatchStatistics()
+        
+        # Run detector
+        libartos.detect_batch_files_jpeg(self.handle, filenames, numImages, buf, limit, numDetections, None, numThreads, ctypes.byref(stats))
+        
+        # Convert detection results
+        detections = [[Detection.fromFlatDetection(buf[i * limit + j]) for j in range(numDetections[i])] for i in range(numImages)]
+        if returnStatistics:
+            return (detections, { field : getattr(stats, field) for field, _ in stats._fields_ })
+        else:
+            return detections
+    
+
+    def pushFrame(self, img):
+        """Pushes a frame of a video stream to the stream detector of this detector.
+        
+        The feature extraction, convolution and non-maximum suppression of consecutive frames are processed concurrently
+        in a pipeline by background threads, which is started with the first frame. This function does not block: If frames
+        are pushed faster than they can be processed, waiting frames are discarded in favour of the newest one.
+        The results can be retrieved using getStreamDetections(). Adding models stops the stream.
+        
+        img - The frame as PIL.Image.Image object.
+        Returns: The ID of the frame. Frames are numbered consecutively beginning with 1.
+        
+        If an error occurs, a LibARTOSException is thrown.
+        """
+        
+        if not isinstance(img, Image.Image):
+            raise TypeError('{0}.pushFrame expects argument img to be PIL.Image.Image'.format(self.__class__.__name__))
+        
+        frameId = ctypes.c_uint(0)
+        imgdata, grayscale = utils.img2buffer(img)
+        libartos.stream_push_raw(self.handle, ctypes.cast(imgdata, artos_wrapper.c_ubyte_p), img.size[0], img.size[1], grayscale, frameId)
+        return frameId.value
+    
+    
+    def getStreamDetections(self, limit = 3, timeout = 0):
+        """Retrieves the detections of the most recent frame pushed by pushFrame() which has been processed completely.
+        
+        limit - Maximum number of detections returned (affects memory allocated for library call).
+        timeout - Maximum number of milliseconds to wait for new results.
+        Returns: A tuple with the ID of the frame and a list of Detection instances or None if no new results have been
+                 available within the timeout.
+        
+        If an error occurs, a LibARTOSException is thrown.
+        """
+        
+        if (limit < 1):
+            limit = 1
+        
+        # Allocate buffer memory, where the library will store the detection results
+        buf_size = ctypes.c_uint(limit)
+        buf = (artos_wrapper.FlatDetection * buf_size.value)()
+        frameId = ctypes.c_uint(0)
+        
+        if libartos.stream_get_detections(self.handle, buf, buf_size, frameId, timeout) == artos_wrapper.DETECT_RES_NO_RESULTS:
+            return None
+        return (frameId.value, [Detection.fromFlatDetection(buf[i]) for i in range(buf_size.value)])
+    
+    
+    def stopStream(self):
+        """Stops the stream detector of this detector and discards frames which are being processed.
+        
+        The next call to pushFrame() will start a new stream.
+        """
+        
+        libartos.stream_stop(self.handle)
+    
+    
     def detectOnFeatureDump(self, feature_dump_file, img_size, limit = 3):
         """Detects objects in a pre-computed feature pyramid which match one of the models added before using addModel() or addModels().
         
@@ -0,0 +1,128 @@
+#ifndef ARTOS_BOUNDEDQUEUE_H
+#define ARTOS_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace ARTOS
+{
+
+/**
+* A thread-safe FIFO queue with a maximum number of elements for passing work between the stages of a pipeline.
+*
+* If the queue is full, push() either blocks until a consumer has removed an element or, if the queue has been
+* created with `dropOldest` set to true, discards the oldest element, so that the newest items always win.
+*/
+template<class T>
+class BoundedQueue
+{
+
+public:
+
+    /**
+    * @param[in] capacity The maximum number of elements in the queue (at least 1).
+    *
+    * @param[in] dropOldest If set to true, pushing to a full queue discards the oldest element
+    * instead of blocking.
+    */
+    BoundedQueue(std::size_t capacity = 1, bool dropOldest = false)
+    : m_capacity((capacity > 0) ? capacity : 1), m_dropOldest(dropOldest), m_closed(false), m_numDropped(0) {};
+    
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue & operator=(const BoundedQueue &) = delete;
+    
+    /**
+    * Appends an element to the queue.
+    *
+    * @param[in] item The element.
+    *
+    * @return Returns false if the queue has been closed and the element has not been added.
+    */
+    bool push(T && item)
+    {
+        std::unique_lock<std::mutex> lock(this->m_mutex);
+        if (this->m_dropOldest)
+        {
+            if (!this->m_closed && this->m_items.size() >= this->m_capacity)
+            {
+                this->m_items.pop_front();
+                this->m_numDropped++;
+            }
+        }
+        else
+            this->m_notFull.wait(lock, [this]() { return this->m_closed || this->m_items.size() < this->m_capacity; });
+        if (this->m_closed)
+            return false;
+        this->m_items.push_back(std::move(item));
+        lock.unlock();
+        this->m_notEmpty.notify_one();
+        return true;
+    };
+    
+    /**
+    * Removes the oldest element from the queue, waiting until one is available.
+    *
+    * @param[out] item Receives the element.
+    *
+    * @return Returns false if the queue has been closed and is empty.
+    */
+    bool pop(T & item)
+    {
+        std::unique_lock<std::mutex> lock(this->m_mutex);
+        this->m_notEmpty.wait(lock, [this]() { return this->m_closed || !this->m_items.empty(); });
+        if (this->m_items.empty())
+            return false;
+        item = std::move(this->m_items.front());
+        this->m_items.pop_front();
+        lock.unlock();
+        this->m_notFull.notify_one();
+        return true;
+    };
+    
+    /**
+    * Closes the queue: Subsequent calls to push() will fail and pop() will fail as soon as the queue is empty.
+    * Threads waiting in push() or pop() are woken up.
+    *
+    * @param[in] discard If set to true, the elements remaining in the queue are discarded.
+    */
+    void close(bool discard = false)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->m_mutex);
+            this->m_closed = true;
+            if (discard)
+                this->m_items.clear();
+        }
+        this->m_notEmpty.notify_all();
+        this->m_notFull.notify_all();
+    };
+    
+    /**
+    * @return Returns the number of elements discarded by push() because the queue was full.
+    */
+    std::size_t numDropped() const
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        return this->m_numDropped;
+    };
+
+
+protected:
+
+    std::size_t m_capacity;
+    bool m_dropOldest;
+    bool m_closed;
+    std::size_t m_numDropped;
+    std::deque<T> m_items;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+
+};
+
+}
+
+#endif
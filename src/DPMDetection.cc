@@ -3,15 +3,50 @@
 #include <iomanip>
 #include <fstream>
 #include <limits>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "DPMDetection.h"
 #include "sysutils.h"
 #include "Intersector.h"
+#include "NonMaximaSuppression.h"
+#include "ScoreKernels.h"
 #include "timingtools.h"
 
 using namespace ARTOS;
 using namespace std;
 
+/**
+* @return Returns the number of threads available to the calling thread.
+*/
+static int maxThreads()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return max(1u, thread::hardware_concurrency());
+#endif
+}
+
+/**
+* Sets the number of threads used by parallel regions started by the calling thread.
+*/
+static void setNumThreads(int numThreads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(numThreads);
+#endif
+}
+
 DPMDetection::DPMDetection ( bool verbose, double overlap, int interval )
 {
     init ( verbose, overlap, interval );
@@ -41,6 +76,14 @@ void DPMDetection::init ( bool verbose, double overlap, int interval )
     this->interval = interval;
     this->verbose = verbose;
     this->nextModelIndex = 0;
+    this->memoryBudget = 0;
+    this->numPlanes = 0;
+    this->planeSize = Size();
+    this->models = make_shared<ModelSet>();
+    this->contextRegistry = make_shared<ContextRegistry>();
+    this->patchworkContext = make_shared<PatchworkContext>();
+    this->contextRegistry->contexts.push_back(this->patchworkContext);
+    this->idleContexts.assign(1, this->patchworkContext);
 }
 
 
@@ -98,31 +141,37 @@ int DPMDetection::addModel ( const std::string & classname, Mixture && model, do
 
 int DPMDetection::addModelPointer ( const std::string & classname, Mixture * mixture, double threshold, const std::string & synsetId )
 {
-    pair< map<std::string, Mixture*>::iterator, bool > insertResult = mixtures.insert ( pair<std::string, Mixture*> ( classname, mixture ) );
-    if (insertResult.second)
-        modelIndices[classname] = this->nextModelIndex++;
+    shared_ptr<const Mixture> managedMixture = this->manageMixture(mixture);
+    lock_guard<mutex> lock(this->modelMutex);
+    shared_ptr<ModelSet> modelSet = make_shared<ModelSet>(*(this->getModelSet()));
+    
+    if (modelSet->mixtures.find(classname) == modelSet->mixtures.end())
+        modelSet->modelIndices[classname] = this->nextModelIndex++;
     else
     {
-        delete insertResult.first->second;
-        insertResult.first->second = mixture;
+        modelSet->cascades.erase(classname);
+        lock_guard<mutex> stateLock(this->stateMutex);
+        this->cascadeStats.erase(classname);
     }
-    thresholds[classname] = threshold;
-    synsetIds[classname] = synsetId;
+    modelSet->mixtures[classname] = managedMixture;
+    modelSet->thresholds[classname] = threshold;
+    modelSet->synsetIds[classname] = synsetId;
     
     int feIndex = -1;
-    for (int i = 0; i < featureExtractors.size(); i++)
-        if (*(featureExtractors[i]) == *(mixture->featureExtractor()))
+    for (int i = 0; i < modelSet->featureExtractors.size(); i++)
+        if (*(modelSet->featureExtractors[i]) == *(mixture->featureExtractor()))
         {
             feIndex = i;
             break;
         }
     if (feIndex < 0)
     {
-        feIndex = featureExtractors.size();
-        featureExtractors.push_back(mixture->featureExtractor());
+        feIndex = modelSet->featureExtractors.size();
+        modelSet->featureExtractors.push_back(mixture->featureExtractor());
     }
-    featureExtractorIndices[classname] = static_cast<unsigned int>(feIndex);
+    modelSet->featureExtractorIndices[classname] = static_cast<unsigned int>(feIndex);
 
+    this->setModelSet(modelSet);
     return ARTOS_RES_OK;
 }
 
@@ -140,8 +189,9 @@ int DPMDetection::replaceModel ( const unsigned int modelIndex, Mixture && model
 
 const Mixture * DPMDetection::getModel(const string & classname) const
 {
-    map<string, Mixture*>::const_iterator it = mixtures.find(classname);
-    return (it != mixtures.end()) ? it->second : NULL;
+    const shared_ptr<const ModelSet> modelSet = this->getModelSet();
+    map< string, shared_ptr<const Mixture> >::const_iterator it = modelSet->mixtures.find(classname);
+    return (it != modelSet->mixtures.end()) ? it->second.get() : NULL;
 }
 
 const Mixture * DPMDetection::getModel(const unsigned int modelIndex) const
@@ -152,196 +202,334 @@ const Mixture * DPMDetection::getModel(const unsigned int modelIndex) const
 
 std::string DPMDetection::getClassnameFromIndex( const unsigned int modelIndex ) const
 {
-    for (map<string, unsigned int>::const_iterator it = modelIndices.begin(); it != modelIndices.end(); it++)
+    const shared_ptr<const ModelSet> modelSet = this->getModelSet();
+    for (map<string, unsigned int>::const_iterator it = modelSet->modelIndices.begin(); it != modelSet->modelIndices.end(); it++)
         if (it->second == modelIndex)
             return it->first;
     return "";
 }
 
 Size DPMDetection::minModelSize() const
+{
+    return this->getModelSet()->minModelSize();
+}
+
+Size DPMDetection::maxModelSize() const
+{
+    return this->getModelSet()->maxModelSize();
+}
+
+Size DPMDetection::ModelSet::minModelSize() const
 {
     Size s;
-    for (map<std::string, Mixture*>::const_iterator m = this->mixtures.begin(); m != this->mixtures.end(); ++m)
+    for (map< std::string, shared_ptr<const Mixture> >::const_iterator m = this->mixtures.begin(); m != this->mixtures.end(); ++m)
         s = (s.min() == 0) ? m->second->minSize() : min(s, m->second->minSize());
     return s;
 }
 
-Size DPMDetection::maxModelSize() const
+Size DPMDetection::ModelSet::maxModelSize() const
 {
     Size s;
-    for (map<std::string, Mixture*>::const_iterator m = this->mixtures.begin(); m != this->mixtures.end(); ++m)
+    for (map< std::string, shared_ptr<const Mixture> >::const_iterator m = this->mixtures.begin(); m != this->mixtures.end(); ++m)
         s = max(s, m->second->maxSize());
     return s;
 }
 
+DPMDetection::DPMDetection ( DPMDetection && other )
+: overlap(other.overlap), interval(other.interval), verbose(other.verbose), nextModelIndex(other.nextModelIndex),
+  memoryBudget(other.memoryBudget), numPlanes(other.numPlanes), planeSize(other.planeSize), models(other.getModelSet()),
+  contextRegistry(move(other.contextRegistry)), patchworkContext(move(other.patchworkContext)),
+  cascadeStats(move(other.cascadeStats)), idleContexts(1, this->patchworkContext), batchContexts(move(other.batchContexts))
+{
+    // Leave the other detector in a usable state without any models
+    other.models = make_shared<ModelSet>();
+    other.cascadeStats.clear();
+    other.contextRegistry = make_shared<ContextRegistry>();
+    other.patchworkContext = make_shared<PatchworkContext>();
+    other.contextRegistry->contexts.push_back(other.patchworkContext);
+    other.resetContexts();
+}
+
 DPMDetection::~DPMDetection()
 {
-    for ( map<std::string, Mixture *>::iterator i = mixtures.begin(); i != mixtures.end(); i++ )
+}
+
+int DPMDetection::detect ( const JPEGImage & image, vector<Detection> & detections )
+{
+    DetectionState state = this->defaultState();
+    int errcode = this->detect(state, image, detections);
+    this->adoptState(state);
+    return errcode;
+}
+
+int DPMDetection::detect ( const JPEGImage & image, vector<Detection> & detections, const Rectangle & roi,
+                           unsigned int minObjectHeight, unsigned int maxObjectHeight )
+{
+    if ( this->getModelSet()->mixtures.size() == 0 )
+        return ARTOS_DETECT_RES_NO_MODELS;
+    if ( image.empty() )
+        return ARTOS_DETECT_RES_INVALID_IMAGE;
+    
+    // Clip the region of interest to the image
+    Rectangle region(0, 0, image.width(), image.height());
+    if (!roi.empty())
+    {
+        region.setX(max(roi.x(), 0));
+        region.setY(max(roi.y(), 0));
+        region.setWidth(min(roi.x() + roi.width(), image.width()) - region.x());
+        region.setHeight(min(roi.y() + roi.height(), image.height()) - region.y());
+        if (region.width() <= 0 || region.height() <= 0)
+            return ARTOS_RES_OK;
+    }
+    
+    DetectionState state = this->defaultState();
+    state.minObjectHeight = minObjectHeight;
+    state.maxObjectHeight = maxObjectHeight;
+    vector<Detection> regionDetections;
+    int errcode;
+    if (region.width() == image.width() && region.height() == image.height())
+        errcode = this->detect(state, image, regionDetections);
+    else
+        errcode = this->detect(state, image.crop(region.x(), region.y(), region.width(), region.height()), regionDetections);
+    this->adoptState(state);
+    
+    // Translate the detections to image coordinates
+    for (Detection & detection : regionDetections)
     {
-        Mixture *mixture = i->second;
-        if ( mixture != NULL ) 
-            delete mixture;
+        detection.setX(detection.Rectangle::x() + region.x());
+        detection.setY(detection.Rectangle::y() + region.y());
     }
-    mixtures.clear();
+    detections.insert(detections.begin(), regionDetections.begin(), regionDetections.end());
+    return errcode;
 }
 
-int DPMDetection::detect ( const JPEGImage & image, vector<Detection> & detections )
+int DPMDetection::detect ( const JPEGImage & image, vector<Detection> & detections,
+                           unsigned int minObjectHeight, unsigned int maxObjectHeight )
 {
-    if ( mixtures.size() == 0 )
+    return this->detect(image, detections, Rectangle(), minObjectHeight, maxObjectHeight);
+}
+
+int DPMDetection::detect ( DetectionState & state, const JPEGImage & image, vector<Detection> & detections )
+{
+    const ModelSet & models = *(state.models);
+    if ( models.mixtures.size() == 0 )
         return ARTOS_DETECT_RES_NO_MODELS;
 
     int errcode;
-    unsigned int minLevelSize = min(5, this->minModelSize().min());
     
     // Separate detection for every unique feature extractor
-    for (unsigned int feIndex = 0; feIndex < this->featureExtractors.size(); feIndex++)
+    for (unsigned int feIndex = 0; feIndex < models.featureExtractors.size(); feIndex++)
     {
+        if (feIndex < state.extractorContexts.size())
+            state.context = state.extractorContexts[feIndex].get();
+        
+        FeaturePyramid pyramid;
+        this->applyThreadBudget(state);
+        errcode = this->computePyramid(state, image, feIndex, pyramid);
+        if (errcode != ARTOS_RES_OK)
+            return errcode;
+        if (pyramid.empty()) // objects of the requested height cannot be detected
+            continue;
+
+        errcode = this->detect(state, image.width(), image.height(), pyramid, detections, feIndex);
+        if (errcode != ARTOS_RES_OK)
+            return errcode;
     
-        // Compute the features
-        if (this->verbose)
-            start();
+    }
 
-        FeaturePyramid pyramid(image, this->featureExtractors[feIndex], this->interval, minLevelSize);
+    return errcode;
+}
 
-        if (pyramid.empty())
-        {
-            if (this->verbose)
-                cerr << "\nCould not create feature pyramid! Image may be invalid." << endl;
-            return ARTOS_DETECT_RES_INVALID_IMAGE;
-        }
+int DPMDetection::computePyramid(const DetectionState & state, const JPEGImage & image, unsigned int featureExtractorIndex,
+                                 FeaturePyramid & pyramid) const
+{
+    const ModelSet & models = *(state.models);
+    unsigned int minLevelSize = min(5, models.minModelSize().min());
+    const shared_ptr<FeatureExtractor> & featureExtractor = models.featureExtractors[featureExtractorIndex];
+    
+    // Restrict the pyramid to the levels needed for objects of the requested height
+    double minScale = 0.0, maxScale = 0.0;
+    if (state.minObjectHeight > 0 || state.maxObjectHeight > 0)
+        this->levelScaleRange(models, featureExtractorIndex, state.minObjectHeight, state.maxObjectHeight, minScale, maxScale);
+    
+    // Compute the features
+    if (state.verbose)
+        start();
 
-        if (this->verbose)
+    pyramid = FeaturePyramid(image, featureExtractor, this->interval, minLevelSize, minScale, maxScale);
+
+    if (pyramid.empty() && (minScale > 0 || maxScale > 0)
+            && !FeaturePyramid::computeScales(Size(image.width(), image.height()), featureExtractor, this->interval, minLevelSize).empty())
+    {
+        if (state.verbose)
         {
-            cerr << "Computed " << pyramid.featureExtractor()->type() << " features in " << stop() << " ms for an image of size " <<
-                    image.width() << " x " << image.height() << endl;
+            stop();
+            cerr << "No pyramid levels needed for objects of the requested height." << endl;
         }
+        return ARTOS_RES_OK;
+    }
+    else if (pyramid.empty())
+    {
+        if (state.verbose)
+            cerr << "\nCould not create feature pyramid! Image may be invalid." << endl;
+        return ARTOS_DETECT_RES_INVALID_IMAGE;
+    }
 
-        errcode = this->detect( image.width(), image.height(), pyramid, detections, feIndex);
-        if (errcode != ARTOS_RES_OK)
-            return errcode;
-    
+    if (state.verbose)
+    {
+        cerr << "Computed " << pyramid.featureExtractor()->type() << " features in " << stop() << " ms for an image of size " <<
+                image.width() << " x " << image.height() << endl;
     }
+    
+    return ARTOS_RES_OK;
+}
 
+int DPMDetection::detect(int width, int height, const FeaturePyramid & pyramid, vector<Detection> & detections, unsigned int featureExtractorIndex)
+{
+    DetectionState state = this->defaultState();
+    int errcode = this->detect(state, width, height, pyramid, detections, featureExtractorIndex);
+    this->adoptState(state);
     return errcode;
 }
 
-int DPMDetection::detect(int width, int height, const FeaturePyramid & pyramid, vector<Detection> & detections, unsigned int featureExtractorIndex)
+int DPMDetection::detect(DetectionState & state, int width, int height, const FeaturePyramid & pyramid,
+                         vector<Detection> & detections, unsigned int featureExtractorIndex)
 {
-    int errcode = this->initPatchwork(pyramid.levels()[0].rows(), pyramid.levels()[0].cols(), pyramid.levels()[0].channels());
+    if ( state.verbose )
+        start();
+    
+    vector< vector<Detection> > candidates;
+    int errcode = this->findCandidates(state, width, height, pyramid, candidates, featureExtractorIndex);
     if (errcode != ARTOS_RES_OK)
+    {
+        if (state.verbose)
+            stop();
         return errcode;
-
-    if ( this->verbose )
-        start();
+    }
+    this->suppressCandidates(state, candidates, detections);
     
-    for ( map<std::string, Mixture *>::iterator m = this->mixtures.begin(); m != this->mixtures.end(); m++ )
-        if (this->featureExtractorIndices[m->first] == featureExtractorIndex)
-        {
-            Mixture * mixture = m->second;
-            const std::string & classname = m->first;
-            double threshold = thresholds[classname];
-            const std::string & synsetId = synsetIds[classname];
-            unsigned int modelIndex = modelIndices[classname];
+    if (state.verbose)
+        cerr << "Computed the convolutions and distance transforms in " << stop() << " ms" << endl;
 
-            // Compute the scores
-            if (this->verbose)
-                cerr << "Running detector for " << classname << endl;
-            vector<ScalarMatrix> scores;
-            vector<Mixture::Indices> argmaxes;
-            vector<Detection> single_detections;
-            mixture->convolve(pyramid, scores, argmaxes);
-            
-            // Cache the size of the models
-            vector<Size> sizes(mixture->models().size());
-            for (int i = 0; i < sizes.size(); ++i)
-                sizes[i] = mixture->models()[i].rootSize();
-            
-            // For each scale
-            for (int i = 0; i < scores.size(); ++i)
-            {
-                const double scale = pyramid.scales()[i];
-              
-                const int rows = scores[i].rows();
-                const int cols = scores[i].cols();
-              
-                for (int y = 0; y < rows; ++y)
-                {
-                    for (int x = 0; x < cols; ++x)
-                    {
-                        const float score = scores[i](y, x);
-                  
-                        if (score > threshold)
-                        {
-                            if (((y == 0) || (x == 0) || (score > scores[i](y - 1, x - 1))) &&
-                              ((y == 0) || (score > scores[i](y - 1, x))) &&
-                              ((y == 0) || (x == cols - 1) || (score > scores[i](y - 1, x + 1))) &&
-                              ((x == 0) || (score > scores[i](y, x - 1))) &&
-                              ((x == cols - 1) || (score > scores[i](y, x + 1))) &&
-                              ((y == rows - 1) || (x == 0) || (score > scores[i](y + 1, x - 1))) &&
-                              ((y == rows - 1) || (score > scores[i](y + 1, x))) &&
-                              ((y == rows - 1) || (x == cols - 1) || (score > scores[i](y + 1, x + 1))))
-                            {
-                                const Size pos = pyramid.featureExtractor()->cellCoordsToPixels(Size(x / scale + 0.5, y / scale + 0.5));
-                                const Size size = pyramid.featureExtractor()->cellsToPixels(Size(
-                                        sizes[argmaxes[i](y, x)].width / scale + 0.5,
-                                        sizes[argmaxes[i](y, x)].height / scale + 0.5
-                                ));
-                                Rectangle bndbox(pos.width, pos.height, size.width, size.height);
-                      
-                                // Truncate the object
-                                bndbox.setX(max(bndbox.x(), 0));
-                                bndbox.setY(max(bndbox.y(), 0));
-                                bndbox.setWidth(min(bndbox.width(), width - bndbox.x()));
-                                bndbox.setHeight(min(bndbox.height(), height - bndbox.y()));
-                                  
-                                if (!bndbox.empty())
-                                    single_detections.push_back(Detection(score, scale, x, y, bndbox, classname, synsetId, modelIndex));
+    return ARTOS_RES_OK;
+}
 
-                            }
-                        }
-                    }
-                }
-            }
+int DPMDetection::findCandidates(DetectionState & state, int width, int height, const FeaturePyramid & pyramid,
+                                 vector< vector<Detection> > & candidates, unsigned int featureExtractorIndex)
+{
+    this->applyThreadBudget(state);
+    int errcode = this->initPatchwork(state, pyramid);
+    if (errcode != ARTOS_RES_OK)
+        return errcode;
+    
+    // Compute the scores of all mixtures at once
+    vector<std::string> classnames;
+    vector< vector< vector<ScalarMatrix> > > allScores;
+    this->convolveMixtures(state, pyramid, featureExtractorIndex, classnames, allScores);
+    
+    this->applyThreadBudget(state);
+    for (size_t c = 0; c < classnames.size(); ++c)
+    {
+        if (state.verbose)
+            cerr << "Running detector for " << classnames[c] << endl;
+        candidates.push_back(vector<Detection>());
+        this->collectCandidates(state, width, height, pyramid, classnames[c], allScores[c], candidates.back());
+    }
 
-            if (this->verbose)
-                cerr << "Number of detections before non-maximum suppression: " << single_detections.size() << endl;
+    return ARTOS_RES_OK;
+}
 
-            // Non maxima suppression
-            sort(single_detections.begin(), single_detections.end());
+void DPMDetection::collectCandidates(const DetectionState & state, int width, int height, const FeaturePyramid & pyramid,
+                                     const std::string & classname, const vector< vector<ScalarMatrix> > & componentScores,
+                                     vector<Detection> & candidates, int firstLevel) const
+{
+    const ModelSet & models = *(state.models);
+    const Mixture * mixture = models.mixtures.at(classname).get();
+    double threshold = models.thresholds.at(classname);
+    const std::string & synsetId = models.synsetIds.at(classname);
+    unsigned int modelIndex = models.modelIndices.at(classname);
+    
+    // Cache the size of the models
+    vector<Size> sizes(mixture->models().size());
+    for (int i = 0; i < sizes.size(); ++i)
+        sizes[i] = mixture->models()[i].rootSize();
+    
+    // For each scale
+    size_t nbLevels = (componentScores.empty()) ? 0 : pyramid.levels().size();
+    for (const vector<ScalarMatrix> & component : componentScores)
+        nbLevels = min(nbLevels, component.size());
+    vector<const ScalarMatrix *> components(componentScores.size());
+    vector<ScorePeak> peaks;
+    for (int i = max(firstLevel, 0); i < nbLevels; ++i)
+    {
+        const double scale = pyramid.scales()[i];
+        
+        // Find the local maxima of the scores of the best components above the threshold
+        for (size_t k = 0; k < components.size(); ++k)
+            components[k] = &componentScores[k][i];
+        FindPeaks(components, threshold, peaks);
+        
+        for (const ScorePeak & peak : peaks)
+        {
+            const Size pos = pyramid.featureExtractor()->cellCoordsToPixels(Size(peak.x / scale + 0.5, peak.y / scale + 0.5));
+            const Size size = pyramid.featureExtractor()->cellsToPixels(Size(
+                    sizes[peak.component].width / scale + 0.5,
+                    sizes[peak.component].height / scale + 0.5
+            ));
+            if ((state.minObjectHeight > 0 && size.height < static_cast<int>(state.minObjectHeight))
+                    || (state.maxObjectHeight > 0 && size.height > static_cast<int>(state.maxObjectHeight)))
+                continue;
+            Rectangle bndbox(pos.width, pos.height, size.width, size.height);
             
-            for (int i = 1; i < single_detections.size(); ++i)
-                single_detections.resize(remove_if(single_detections.begin() + i, single_detections.end(),
-                        Intersector(single_detections[i - 1], this->overlap, true)) -
-                        single_detections.begin());
+            // Truncate the object
+            bndbox.setX(max(bndbox.x(), 0));
+            bndbox.setY(max(bndbox.y(), 0));
+            bndbox.setWidth(min(bndbox.width(), width - bndbox.x()));
+            bndbox.setHeight(min(bndbox.height(), height - bndbox.y()));
+              
+            if (!bndbox.empty())
+                candidates.push_back(Detection(peak.score, scale, peak.x, peak.y, bndbox, classname, synsetId, modelIndex));
+        }
+    }
+}
 
-            if (this->verbose)
-                cerr << "Number of detections after non-maximum suppression: " << single_detections.size() << endl;
+void DPMDetection::suppressCandidates(const DetectionState & state, vector< vector<Detection> > & candidates,
+                                      vector<Detection> & detections) const
+{
+    for (vector<Detection> & single_detections : candidates)
+    {
+        if (state.verbose)
+            cerr << "Number of detections before non-maximum suppression: " << single_detections.size() << endl;
 
-            detections.insert ( detections.begin(), single_detections.begin(), single_detections.end() );
-        }
-    
-    if (this->verbose)
-        cerr << "Computed the convolutions and distance transforms in " << stop() << " ms" << endl;
+        // Non maxima suppression
+        sort(single_detections.begin(), single_detections.end());
+        SuppressNonMaxima(single_detections, this->overlap, true);
 
-    return ARTOS_RES_OK;
+        if (state.verbose)
+            cerr << "Number of detections after non-maximum suppression: " << single_detections.size() << endl;
+
+        detections.insert ( detections.begin(), single_detections.begin(), single_detections.end() );
+    }
 }
 
 int DPMDetection::detectMax ( const JPEGImage & image, Detection & detection )
 {
-    if ( mixtures.size() == 0 )
+    DetectionState state = this->defaultState();
+    const ModelSet & models = *(state.models);
+    if ( models.mixtures.size() == 0 )
         return ARTOS_DETECT_RES_NO_MODELS;
     
-    unsigned int minLevelSize = min(5, this->minModelSize().min());
+    unsigned int minLevelSize = min(5, models.minModelSize().min());
 
     // Separate detection for every unique feature extractor
-    for (unsigned int feIndex = 0; feIndex < this->featureExtractors.size(); feIndex++)
+    for (unsigned int feIndex = 0; feIndex < models.featureExtractors.size(); feIndex++)
     {
         
         // Compute the features
         if (this->verbose)
             start();
         
-        FeaturePyramid pyramid(image, this->featureExtractors[feIndex], this->interval, minLevelSize);
+        FeaturePyramid pyramid(image, models.featureExtractors[feIndex], this->interval, minLevelSize);
 
         if (pyramid.empty())
         {
@@ -355,65 +543,80 @@ int DPMDetection::detectMax ( const JPEGImage & image, Detection & detection )
                     image.width() << " x " << image.height() << endl;
         }
 
-        int errcode = this->initPatchwork(pyramid.levels()[0].rows(), pyramid.levels()[0].cols(), pyramid.levels()[0].channels());
+        int errcode = this->initPatchwork(state, pyramid);
         if (errcode != ARTOS_RES_OK)
             return errcode;
 
         if ( this->verbose )
             start();
 
+        // Compute the scores of all mixtures at once
+        vector<std::string> classnames;
+        vector< vector< vector<ScalarMatrix> > > allScores;
+        this->convolveMixtures(state, pyramid, feIndex, classnames, allScores);
+        this->adoptState(state);
+
         FeatureScalar score, maxScore = -1 * numeric_limits<FeatureScalar>::infinity();
         int y, x;
-        for ( map<std::string, Mixture *>::iterator m = this->mixtures.begin(); m != this->mixtures.end(); m++ )
-            if (this->featureExtractorIndices[m->first] == feIndex)
+        for (size_t c = 0; c < classnames.size(); ++c)
+        {
+            const std::string & classname = classnames[c];
+            const Mixture * mixture = models.mixtures.at(classname).get();
+            const std::string & synsetId = models.synsetIds.at(classname);
+            unsigned int modelIndex = models.modelIndices.at(classname);
+
+            // Look up the scores
+            if (this->verbose)
+                cerr << "Running detector for " << classname << endl;
+            const vector< vector<ScalarMatrix> > & componentScores = allScores[c];
+            
+            // Cache the size of the models
+            vector<Size> sizes(mixture->models().size());
+            for (int i = 0; i < sizes.size(); ++i)
+                sizes[i] = mixture->models()[i].rootSize();
+            
+            // For each scale
+            size_t nbLevels = (componentScores.empty()) ? 0 : pyramid.levels().size();
+            for (const vector<ScalarMatrix> & component : componentScores)
+                nbLevels = min(nbLevels, component.size());
+            vector<const ScalarMatrix *> components(componentScores.size());
+            ScalarMatrix scores;
+            Mixture::Indices argmaxes;
+            for (int i = 0; i < nbLevels; ++i)
             {
-                Mixture * mixture = m->second;
-                const std::string & classname = m->first;
-                const std::string & synsetId = synsetIds[classname];
-                unsigned int modelIndex = modelIndices[classname];
-
-                // Compute the scores
-                if (this->verbose)
-                    cerr << "Running detector for " << classname << endl;
-                vector<ScalarMatrix> scores;
-                vector<Mixture::Indices> argmaxes;
-                mixture->convolve(pyramid, scores, argmaxes);
-                
-                // Cache the size of the models
-                vector<Size> sizes(mixture->models().size());
-                for (int i = 0; i < sizes.size(); ++i)
-                    sizes[i] = mixture->models()[i].rootSize();
+                const double scale = pyramid.scales()[i];
                 
-                // For each scale
-                for (int i = 0; i < scores.size(); ++i)
+                for (size_t k = 0; k < components.size(); ++k)
+                    components[k] = &componentScores[k][i];
+                MaxComponents(components, scores, &argmaxes);
+                if (scores.size() == 0)
+                    continue;
+              
+                score = scores.maxCoeff(&y, &x);
+                if (score > maxScore)
                 {
-                    const double scale = pyramid.scales()[i];
-                  
-                    score = scores[i].maxCoeff(&y, &x);
-                    if (score > maxScore)
+                    const Size pos = pyramid.featureExtractor()->cellCoordsToPixels(Size(x / scale + 0.5, y / scale + 0.5));
+                    const Size size = pyramid.featureExtractor()->cellsToPixels(Size(
+                            sizes[argmaxes(y, x)].width / scale + 0.5,
+                            sizes[argmaxes(y, x)].height / scale + 0.5
+                    ));
+                    Rectangle bndbox(pos.width, pos.height, size.width, size.height);
+                      
+                    // Truncate the object
+                    bndbox.setX(max(bndbox.x(), 0));
+                    bndbox.setY(max(bndbox.y(), 0));
+                    bndbox.setWidth(min(bndbox.width(), image.width() - bndbox.x()));
+                    bndbox.setHeight(min(bndbox.height(), image.height() - bndbox.y()));
+                      
+                    if (!bndbox.empty())
                     {
-                        const Size pos = pyramid.featureExtractor()->cellCoordsToPixels(Size(x / scale + 0.5, y / scale + 0.5));
-                        const Size size = pyramid.featureExtractor()->cellsToPixels(Size(
-                                sizes[argmaxes[i](y, x)].width / scale + 0.5,
-                                sizes[argmaxes[i](y, x)].height / scale + 0.5
-                        ));
-                        Rectangle bndbox(pos.width, pos.height, size.width, size.height);
-                          
-                        // Truncate the object
-                        bndbox.setX(max(bndbox.x(), 0));
-                        bndbox.setY(max(bndbox.y(), 0));
-                        bndbox.setWidth(min(bndbox.width(), image.width() - bndbox.x()));
-                        bndbox.setHeight(min(bndbox.height(), image.height() - bndbox.y()));
-                          
-                        if (!bndbox.empty())
-                        {
-                            detection = Detection(score, scale, x, y, bndbox, classname, synsetId, modelIndex);
-                            maxScore = score;
-                        }
+                        detection = Detection(score, scale, x, y, bndbox, classname, synsetId, modelIndex);
+                        maxScore = score;
                     }
                 }
-
             }
+
+        }
      
         if (this->verbose)
             cerr << "Computed the convolutions and distance transforms in " << stop() << " ms" << endl;
@@ -423,40 +626,1050 @@ int DPMDetection::detectMax ( const JPEGImage & image, Detection & detection )
     return ARTOS_RES_OK;
 }
 
-int DPMDetection::initPatchwork(unsigned int rows, unsigned int cols, unsigned int numFeatures)
+int DPMDetection::detectBatch ( const vector<JPEGImage> & images, vector< vector<Detection> > & detections,
+                                BatchStatistics * stats, vector<int> * results, unsigned int numThreads )
 {
-    // Initialize the Patchwork class (only when necessary)
-    const Size maxFilterSize = this->maxModelSize(); // the Mixture class will add padding according to the filter size
-    int w = (rows + maxFilterSize.height + 2 + 15) & ~15;
-    int h = (cols + maxFilterSize.width + 2 + 15) & ~15;
-    if ( w > Patchwork::MaxCols() || h > Patchwork::MaxRows() || numFeatures != Patchwork::NumFeatures() )
+    const shared_ptr<const ModelSet> modelSet = this->getModelSet();
+    if ( modelSet->mixtures.size() == 0 )
+        return ARTOS_DETECT_RES_NO_MODELS;
+    
+    const int totalThreads = (numThreads > 0) ? numThreads : maxThreads();
+    const int numWorkers = max(1, min(totalThreads, static_cast<int>(images.size())));
+    detections.assign(images.size(), vector<Detection>());
+    vector<int> imageResults(images.size(), ARTOS_RES_OK);
+    vector<double> latencies(images.size(), 0.0);
+    
+    // Take patchwork contexts for the workers from the pool or create new ones with the same settings
+    vector<DetectionState> states;
+    for (int w = 0; w < numWorkers; ++w)
     {
-        w = max(w, Patchwork::MaxCols());
-        h = max(h, Patchwork::MaxRows());
-        if (this->verbose) {
-            cerr << "Init values for Patchwork: " << w << " x " << h << " x " << numFeatures << endl;
+        states.push_back(DetectionState(NULL, false));
+        states.back().models = modelSet;
+        states.back().lease = this->acquireContext(this->batchContexts);
+        states.back().context = states.back().lease.get();
+        states.back().totalThreads = totalThreads;
+    }
+    
+    // Distribute the images among the workers in contiguous blocks. Workers take images from the front
+    // of their own queue and steal from the back of the others' queues.
+    struct WorkQueue
+    {
+        mutex lock;
+        deque<size_t> images;
+    };
+    vector<WorkQueue> queues(numWorkers);
+    for (int w = 0; w < numWorkers; ++w)
+        for (size_t img = images.size() * w / numWorkers; img < images.size() * (w + 1) / numWorkers; ++img)
+            queues[w].images.push_back(img);
+    
+    auto nextImage = [&queues, numWorkers](int w, size_t & img)
+    {
+        for (int k = 0; k < numWorkers; ++k)
+        {
+            WorkQueue & queue = queues[(w + k) % numWorkers];
+            lock_guard<mutex> lock(queue.lock);
+            if (!queue.images.empty())
+            {
+                if (k == 0)
+                {
+                    img = queue.images.front();
+                    queue.images.pop_front();
+                }
+                else
+                {
+                    img = queue.images.back();
+                    queue.images.pop_back();
+                }
+                return true;
+            }
+        }
+        return false;
+    };
+    
+    // Workers without images left lend their threads to the remaining ones, which pick them up
+    // before the next stage of their current detection (see applyThreadBudget())
+    atomic<int> activeWorkers(numWorkers);
+    for (DetectionState & state : states)
+        state.activeWorkers = &activeWorkers;
+    vector<chrono::steady_clock::time_point> lastFinish(numWorkers);
+    auto worker = [&](int w)
+    {
+        size_t img;
+        while (nextImage(w, img))
+        {
+            const chrono::steady_clock::time_point imageStart = chrono::steady_clock::now();
+            imageResults[img] = this->detect(states[w], images[img], detections[img]);
+            lastFinish[w] = chrono::steady_clock::now();
+            latencies[img] = chrono::duration<double, milli>(lastFinish[w] - imageStart).count();
+        }
+        activeWorkers--;
+    };
+    
+    const chrono::steady_clock::time_point batchStart = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int w = 1; w < numWorkers; ++w)
+        threads.push_back(thread(worker, w));
+    {
+        // The calling thread acts as the first worker, but its number of OpenMP threads must be restored
+        const int ompThreads = maxThreads();
+        worker(0);
+        setNumThreads(ompThreads);
+    }
+    for (thread & t : threads)
+        t.join();
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - batchStart).count();
+    
+    // Keep the number of planes and cascade statistics of the image finished last
+    vector<int> workerOrder(numWorkers);
+    for (int w = 0; w < numWorkers; ++w)
+        workerOrder[w] = w;
+    sort(workerOrder.begin(), workerOrder.end(), [&lastFinish](int a, int b) { return lastFinish[a] < lastFinish[b]; });
+    for (int w : workerOrder)
+        this->adoptState(states[w]);
+    
+    if (stats)
+    {
+        *stats = BatchStatistics();
+        stats->numImages = images.size();
+        stats->numThreads = numWorkers;
+        stats->seconds = seconds;
+        stats->imagesPerSecond = (seconds > 0) ? images.size() / seconds : 0;
+        if (!latencies.empty())
+        {
+            vector<double> sorted(latencies);
+            sort(sorted.begin(), sorted.end());
+            auto percentile = [&sorted](double p) { return sorted[static_cast<size_t>(ceil(p * sorted.size())) - 1]; };
+            for (double latency : sorted)
+                stats->meanLatency += latency;
+            stats->meanLatency /= sorted.size();
+            stats->latencyP50 = percentile(0.5);
+            stats->latencyP90 = percentile(0.9);
+            stats->latencyP99 = percentile(0.99);
+            stats->maxLatency = sorted.back();
+        }
+    }
+    
+    if (results)
+        *results = imageResults;
+    for (int result : imageResults)
+        if (result != ARTOS_RES_OK)
+            return result;
+    return ARTOS_RES_OK;
+}
+
+int DPMDetection::detectAnytime ( const JPEGImage & image, vector<Detection> & detections, unsigned int timeLimit,
+                                  AnytimeStatistics * stats, const vector<std::string> & classPriority )
+{
+    const chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    auto elapsed = [&startTime]() { return chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count(); };
+    auto expired = [&]() { return timeLimit > 0 && elapsed() >= timeLimit; };
+    
+    DetectionState state = this->defaultState();
+    const ModelSet & models = *(state.models);
+    if ( models.mixtures.size() == 0 )
+        return ARTOS_DETECT_RES_NO_MODELS;
+    AnytimeStatistics anytimeStats;
+    
+    // Order the classes by priority
+    vector<std::string> classOrder;
+    for (const std::string & classname : classPriority)
+    {
+        map< std::string, shared_ptr<const Mixture> >::const_iterator m = models.mixtures.find(classname);
+        if (m != models.mixtures.end() && !m->second->empty() && find(classOrder.begin(), classOrder.end(), classname) == classOrder.end())
+            classOrder.push_back(classname);
+    }
+    for ( map< std::string, shared_ptr<const Mixture> >::const_iterator m = models.mixtures.begin(); m != models.mixtures.end(); m++ )
+        if (!m->second->empty() && find(classOrder.begin(), classOrder.end(), m->first) == classOrder.end())
+            classOrder.push_back(m->first);
+    
+    // The pyramid of each feature extractor is divided into octaves, beginning with the coarsest one.
+    // Each octave is searched on a pyramid consisting of its levels and, if parts are involved, the levels
+    // of the next finer octave, which is the only one the root levels refer to for placing the parts.
+    struct OctavePyramids
+    {
+        vector<double> scales;
+        bool hasParts;
+        int numOctaves;
+        map<int, vector<FeatureMatrix> > octaveLevels; // computed octaves not needed as roots yet
+        int currentOctave;
+        FeaturePyramid pyramid;
+        int firstRootLevel;
+        Patchwork patchwork;
+        bool patchworkBuilt;
+        
+        OctavePyramids() : hasParts(false), numOctaves(0), currentOctave(-1), firstRootLevel(0), patchworkBuilt(false) {};
+    };
+    auto octaveBegin = [this](const OctavePyramids & op, int octave) { return max(0, static_cast<int>(op.scales.size()) - (octave + 1) * this->interval); };
+    auto octaveEnd = [this](const OctavePyramids & op, int octave) { return static_cast<int>(op.scales.size()) - octave * this->interval; };
+    const unsigned int minLevelSize = min(5, models.minModelSize().min());
+    vector<OctavePyramids> octavePyramids(models.featureExtractors.size());
+    int numOctaves = 0;
+    for (unsigned int feIndex = 0; feIndex < models.featureExtractors.size(); ++feIndex)
+    {
+        OctavePyramids & op = octavePyramids[feIndex];
+        op.scales = FeaturePyramid::computeScales(Size(image.width(), image.height()), models.featureExtractors[feIndex],
+                                                  this->interval, minLevelSize);
+        if (op.scales.empty())
+            return ARTOS_DETECT_RES_INVALID_IMAGE;
+        op.numOctaves = (op.scales.size() + this->interval - 1) / this->interval;
+        numOctaves = max(numOctaves, op.numOctaves);
+        anytimeStats.pyramidMaxScale = max(anytimeStats.pyramidMaxScale, op.scales.front());
+    }
+    for (const std::string & classname : classOrder)
+    {
+        OctavePyramids & op = octavePyramids[models.featureExtractorIndices.at(classname)];
+        for (const Model & model : models.mixtures.at(classname)->models())
+            op.hasParts = op.hasParts || (model.nbParts() > 0);
+        anytimeStats.numUnits += op.numOctaves;
+        anytimeStats.maxScale[classname] = 0.0;
+    }
+    
+    // Computes the features of the levels of an octave of the pyramid of a feature extractor
+    auto computeOctave = [&](unsigned int feIndex, int octave)
+    {
+        OctavePyramids & op = octavePyramids[feIndex];
+        if (op.octaveLevels.find(octave) != op.octaveLevels.end())
+            return true;
+        const int begin = octaveBegin(op, octave), end = octaveEnd(op, octave);
+        FeaturePyramid octavePyramid(image, models.featureExtractors[feIndex], this->interval, minLevelSize,
+                                     op.scales[end - 1], op.scales[begin]);
+        if (octavePyramid.levels().size() != static_cast<size_t>(end - begin))
+            return false;
+        op.octaveLevels[octave] = move(octavePyramid.levels());
+        return true;
+    };
+    
+    // Prepares the pyramid and the patchwork for searching an octave
+    auto prepareOctave = [&](unsigned int feIndex, int octave)
+    {
+        OctavePyramids & op = octavePyramids[feIndex];
+        if (op.currentOctave == octave)
+            return ARTOS_RES_OK;
+        const bool withParts = op.hasParts && octaveBegin(op, octave) > 0;
+        if (!computeOctave(feIndex, octave) || (withParts && !computeOctave(feIndex, octave + 1)))
+            return ARTOS_DETECT_RES_INVALID_IMAGE;
+        
+        vector<FeatureMatrix> levels;
+        if (withParts)
+            levels = op.octaveLevels[octave + 1];
+        op.firstRootLevel = levels.size();
+        vector<FeatureMatrix> & rootLevels = op.octaveLevels[octave];
+        levels.insert(levels.end(), make_move_iterator(rootLevels.begin()), make_move_iterator(rootLevels.end()));
+        op.octaveLevels.erase(octave);
+        
+        const int end = octaveEnd(op, octave);
+        vector<double> scales(op.scales.begin() + (end - levels.size()), op.scales.begin() + end);
+        op.pyramid = FeaturePyramid(this->interval, move(levels), &scales, models.featureExtractors[feIndex]);
+        op.currentOctave = octave;
+        op.patchwork = Patchwork();
+        op.patchworkBuilt = false;
+        return ARTOS_RES_OK;
+    };
+    
+    // Use a context of its own for each feature extractor, since switching between feature extractors with
+    // different numbers of features from one unit of work to the next would re-initialize the context every time
+    if (models.featureExtractors.size() > 1)
+    {
+        state.extractorContexts.push_back(state.lease);
+        for (unsigned int feIndex = 1; feIndex < models.featureExtractors.size(); ++feIndex)
+            state.extractorContexts.push_back(this->acquireContext(this->idleContexts));
+    }
+    auto selectContext = [&state](unsigned int feIndex)
+    {
+        if (feIndex < state.extractorContexts.size())
+            state.context = state.extractorContexts[feIndex].get();
+    };
+    
+    // Initialize the patchwork contexts for the size of the entire pyramid in advance, so that they do not have
+    // to be re-initialized for each octave. The size of the levels is estimated without computing the features.
+    int errcode = ARTOS_RES_OK;
+    for (unsigned int feIndex = 0; feIndex < models.featureExtractors.size() && errcode == ARTOS_RES_OK; ++feIndex)
+    {
+        const shared_ptr<FeatureExtractor> & featureExtractor = models.featureExtractors[feIndex];
+        selectContext(feIndex);
+        vector<Size> levels;
+        for (double scale : octavePyramids[feIndex].scales)
+            levels.push_back(featureExtractor->pixelsToCells(Size(image.width() * scale + 0.5, image.height() * scale + 0.5)));
+        errcode = this->initPatchwork(state, levels, featureExtractor->numFeatures());
+    }
+    
+    vector< vector<Detection> > candidates(classOrder.size());
+    bool timeout = false;
+    for (int octave = 0; octave < numOctaves && !timeout && errcode == ARTOS_RES_OK; ++octave)
+        for (size_t c = 0; c < classOrder.size() && errcode == ARTOS_RES_OK; ++c)
+        {
+            const std::string & classname = classOrder[c];
+            const unsigned int feIndex = models.featureExtractorIndices.at(classname);
+            OctavePyramids & op = octavePyramids[feIndex];
+            if (octave >= op.numOctaves)
+                continue;
+            if (expired())
+            {
+                timeout = true;
+                break;
+            }
+            
+            errcode = prepareOctave(feIndex, octave);
+            if (errcode != ARTOS_RES_OK)
+                break;
+            selectContext(feIndex);
+            if (!models.getCascade(classname) && !op.patchworkBuilt)
+            {
+                errcode = this->initPatchwork(state, op.pyramid);
+                if (errcode != ARTOS_RES_OK)
+                    break;
+                op.patchwork = Patchwork(*(state.context), op.pyramid, models.patchworkPadding(feIndex));
+                op.patchworkBuilt = true;
+            }
+            
+            vector< vector< vector<ScalarMatrix> > > scores;
+            this->convolveMixtures(state, op.pyramid, vector<std::string>(1, classname), scores,
+                                   (op.patchworkBuilt) ? &op.patchwork : NULL);
+            this->collectCandidates(state, image.width(), image.height(), op.pyramid, classname, scores[0],
+                                    candidates[c], op.firstRootLevel);
+            anytimeStats.maxScale[classname] = op.scales[octaveBegin(op, octave)];
+            anytimeStats.numUnitsProcessed++;
+        }
+    
+    if (errcode == ARTOS_RES_OK)
+        this->suppressCandidates(state, candidates, detections);
+    this->adoptState(state);
+    
+    anytimeStats.complete = (anytimeStats.numUnitsProcessed == anytimeStats.numUnits);
+    anytimeStats.milliseconds = elapsed();
+    if (state.verbose)
+        cerr << "Processed " << anytimeStats.numUnitsProcessed << " of " << anytimeStats.numUnits << " units of work in "
+             << anytimeStats.milliseconds << " ms" << endl;
+    if (stats)
+        *stats = anytimeStats;
+    return errcode;
+}
+
+int DPMDetection::detectTiled ( const JPEGImage & image, vector<Detection> & detections, unsigned int planeSize,
+                                unsigned int numThreads )
+{
+    const shared_ptr<const ModelSet> modelSet = this->getModelSet();
+    const ModelSet & models = *modelSet;
+    if ( models.mixtures.size() == 0 )
+        return ARTOS_DETECT_RES_NO_MODELS;
+    if ( image.empty() )
+        return ARTOS_DETECT_RES_INVALID_IMAGE;
+    
+    // A band of object heights processed on tiles of the same size
+    struct Band
+    {
+        unsigned int minHeight, maxHeight;
+        double maxScale; // largest scale of the pyramid levels needed
+        Size overlap; // largest extent of objects in the band plus some tolerance
+        Size tileSize;
+    };
+    struct Tile
+    {
+        size_t band;
+        Rectangle region;
+    };
+    
+    // Determine the smallest objects which can be detected and the largest aspect ratio of the models
+    const unsigned int minLevelSize = min(5, models.minModelSize().min());
+    const Size padding = models.maxModelSize() / 2 + 1; // the same padding is used by initPatchwork()
+    double minObjectHeight = numeric_limits<double>::infinity(), maxAspectRatio = 0.0;
+    Size maxCellSize;
+    for ( map< std::string, shared_ptr<const Mixture> >::const_iterator m = models.mixtures.begin(); m != models.mixtures.end(); m++ )
+    {
+        const shared_ptr<FeatureExtractor> & featureExtractor = models.featureExtractors[models.featureExtractorIndices.at(m->first)];
+        const vector<double> scales = FeaturePyramid::computeScales(Size(image.width(), image.height()), featureExtractor,
+                                                                    this->interval, minLevelSize);
+        if (scales.empty())
+            return ARTOS_DETECT_RES_INVALID_IMAGE;
+        maxCellSize = max(maxCellSize, featureExtractor->cellSize());
+        for (const Model & model : m->second->models())
+        {
+            const Size rootSize = featureExtractor->cellsToPixels(model.rootSize());
+            minObjectHeight = min(minObjectHeight, rootSize.height / scales.front());
+            maxAspectRatio = max(maxAspectRatio, static_cast<double>(rootSize.width) / rootSize.height);
+        }
+    }
+    
+    // Divide the range of object heights into octaves until a single tile covers the entire image
+    vector<Band> bands;
+    int minPlaneSize = 0;
+    for (unsigned int height = max(1, static_cast<int>(minObjectHeight)); bands.empty() || bands.back().maxHeight > 0; height *= 2)
+    {
+        Band band;
+        band.minHeight = height;
+        band.maxHeight = 2 * height - 1;
+        band.maxScale = 0.0;
+        for (unsigned int feIndex = 0; feIndex < models.featureExtractors.size(); ++feIndex)
+        {
+            // levelScaleRange() asks for scales above 2 if the band contains objects smaller than the models
+            // (or their parts, which are evaluated at twice the scale of the root). But the pyramid of a tile
+            // never has levels beyond its first octave at twice the resolution of the tile (see
+            // FeaturePyramid::computeScales()), so larger scales would only shrink the tiles without enabling
+            // any additional detections.
+            double minScale, maxScale;
+            this->levelScaleRange(models, feIndex, band.minHeight, band.maxHeight, minScale, maxScale);
+            band.maxScale = max(band.maxScale, min(maxScale, 2.0));
+        }
+        band.overlap = Size(ceil(maxAspectRatio * band.maxHeight), band.maxHeight) + maxCellSize * 2;
+        
+        // Tiles must be at least twice as large as their overlap, otherwise the plane has to be larger
+        for (const shared_ptr<FeatureExtractor> & featureExtractor : models.featureExtractors)
+        {
+            const Size minTileCells = featureExtractor->pixelsToCells(Size(
+                    ceil(2 * band.overlap.width * band.maxScale), ceil(2 * band.overlap.height * band.maxScale)
+            )) + padding;
+            minPlaneSize = max(minPlaneSize, max(minTileCells.width, minTileCells.height));
+        }
+        
+        if (max(band.overlap.width, band.overlap.height) * 2 >= max(image.width(), image.height()))
+            band.maxHeight = 0; // the last band covers the entire image
+        bands.push_back(band);
+    }
+    int plane = max(static_cast<int>(planeSize), minPlaneSize);
+    while (!PatchworkContext::isFFTFriendly(plane) || plane % 2 != 0)
+        plane++;
+    
+    // Split the image into tiles, the last tile of each row and column being aligned with the border of the image
+    vector<Tile> tiles;
+    for (size_t b = 0; b < bands.size(); ++b)
+    {
+        Band & band = bands[b];
+        Size tileSize = Size(image.width(), image.height());
+        if (band.maxHeight > 0)
+        {
+            // The tiles must fit on the planes of all feature extractors
+            for (const shared_ptr<FeatureExtractor> & featureExtractor : models.featureExtractors)
+            {
+                const Size maxTileSize = featureExtractor->cellsToPixels(Size(plane) - padding);
+                tileSize = min(tileSize, Size(maxTileSize.width / band.maxScale, maxTileSize.height / band.maxScale));
+            }
+            tileSize = min(max(tileSize, band.overlap * 2), Size(image.width(), image.height()));
+        }
+        band.tileSize = tileSize;
+        auto tileOffsets = [](int imageSize, int tileSize, int overlap)
+        {
+            vector<int> offsets(1, 0);
+            while (offsets.back() + tileSize < imageSize)
+                offsets.push_back(min(offsets.back() + tileSize - overlap, imageSize - tileSize));
+            return offsets;
+        };
+        for (int y : tileOffsets(image.height(), tileSize.height, band.overlap.height))
+            for (int x : tileOffsets(image.width(), tileSize.width, band.overlap.width))
+                tiles.push_back(Tile{ b, Rectangle(x, y, tileSize.width, tileSize.height) });
+    }
+    
+    // Take a patchwork context for each feature extractor for the workers from the pool and initialize them
+    // with the fixed plane size and the filters of the mixtures associated with that feature extractor
+    const int totalThreads = (numThreads > 0) ? numThreads : maxThreads();
+    const int numWorkers = max(1, min(totalThreads, static_cast<int>(tiles.size())));
+    vector<DetectionState> states;
+    for (int w = 0; w < numWorkers; ++w)
+    {
+        states.push_back(DetectionState(NULL, false));
+        states.back().models = modelSet;
+        for (unsigned int feIndex = 0; feIndex < models.featureExtractors.size(); ++feIndex)
+        {
+            shared_ptr<PatchworkContext> lease = this->acquireContext(this->batchContexts);
+            PatchworkContext & context = *lease;
+            const int numFeatures = models.featureExtractors[feIndex]->numFeatures();
+            if (context.maxRows() != plane || context.maxCols() != plane || context.numFeatures() != numFeatures)
+            {
+                if (!context.init(plane, plane, numFeatures))
+                    return ARTOS_RES_INTERNAL_ERROR;
+                for ( map< std::string, shared_ptr<const Mixture> >::const_iterator i = models.mixtures.begin(); i != models.mixtures.end(); i++ )
+                    if (!models.getCascade(i->first) && models.featureExtractorIndices.at(i->first) == feIndex)
+                        i->second->cacheFilters(context);
+            }
+            states.back().extractorContexts.push_back(lease);
+        }
+        states.back().context = states.back().extractorContexts[0].get();
+    }
+    if (this->verbose)
+        cerr << "Processing " << tiles.size() << " tiles in " << bands.size() << " bands of object heights on planes of size "
+             << plane << " x " << plane << endl;
+    
+    // Process the tiles in parallel
+    atomic<size_t> nextTile(0);
+    vector< vector<Detection> > workerDetections(numWorkers);
+    vector<int> workerResults(numWorkers, ARTOS_RES_OK);
+    auto worker = [&](int w)
+    {
+        setNumThreads(max(1, totalThreads / numWorkers));
+        DetectionState & state = states[w];
+        for (size_t t = nextTile++; t < tiles.size() && workerResults[w] == ARTOS_RES_OK; t = nextTile++)
+        {
+            const Tile & tile = tiles[t];
+            const Band & band = bands[tile.band];
+            state.minObjectHeight = band.minHeight;
+            state.maxObjectHeight = band.maxHeight;
+            
+            vector<Detection> tileDetections;
+            const Rectangle & region = tile.region;
+            if (region.width() == image.width() && region.height() == image.height())
+                workerResults[w] = this->detect(state, image, tileDetections);
+            else
+                workerResults[w] = this->detect(state, image.crop(region.x(), region.y(), region.width(), region.height()), tileDetections);
+            
+            // Discard detections touching inner borders of the tile, which lie completely inside of another tile
+            for (Detection & detection : tileDetections)
+                if ((region.x() == 0 || detection.left() > 0)
+                        && (region.y() == 0 || detection.top() > 0)
+                        && (region.x() + region.width() == image.width() || detection.right() < region.width() - 1)
+                        && (region.y() + region.height() == image.height() || detection.bottom() < region.height() - 1))
+                {
+                    detection.setX(detection.Rectangle::x() + region.x());
+                    detection.setY(detection.Rectangle::y() + region.y());
+                    workerDetections[w].push_back(detection);
+                }
+        }
+    };
+    vector<thread> threads;
+    for (int w = 1; w < numWorkers; ++w)
+        threads.push_back(thread(worker, w));
+    {
+        // The calling thread acts as the first worker, but its number of OpenMP threads must be restored
+        const int ompThreads = maxThreads();
+        worker(0);
+        setNumThreads(ompThreads);
+    }
+    for (thread & t : threads)
+        t.join();
+    for (int w = 0; w < numWorkers; ++w)
+        this->adoptState(states[w]);
+    for (int result : workerResults)
+        if (result != ARTOS_RES_OK)
+            return result;
+    
+    // Suppress duplicates found in overlapping tiles or adjacent bands
+    map< std::string, vector<Detection> > classDetections;
+    for (vector<Detection> & dets : workerDetections)
+        for (Detection & detection : dets)
+            classDetections[detection.classname].push_back(detection);
+    vector< vector<Detection> > candidates;
+    for (map< std::string, vector<Detection> >::iterator it = classDetections.begin(); it != classDetections.end(); ++it)
+        candidates.push_back(move(it->second));
+    DetectionState state(NULL, this->verbose);
+    state.models = modelSet;
+    this->suppressCandidates(state, candidates, detections);
+    return ARTOS_RES_OK;
+}
+
+void DPMDetection::convolveMixtures(DetectionState & state, const FeaturePyramid & pyramid, unsigned int featureExtractorIndex,
+                                    vector<std::string> & classnames,
+                                    vector< vector< vector<ScalarMatrix> > > & scores)
+{
+    // Collect the mixtures associated with the given feature extractor
+    const ModelSet & models = *(state.models);
+    classnames.clear();
+    for ( map< std::string, shared_ptr<const Mixture> >::const_iterator m = models.mixtures.begin(); m != models.mixtures.end(); m++ )
+        if (models.featureExtractorIndices.at(m->first) == featureExtractorIndex && !m->second->empty())
+            classnames.push_back(m->first);
+    this->convolveMixtures(state, pyramid, classnames, scores);
+}
+
+void DPMDetection::convolveMixtures(DetectionState & state, const FeaturePyramid & pyramid, const vector<std::string> & classnames,
+                                    vector< vector< vector<ScalarMatrix> > > & scores, const Patchwork * sharedPatchwork)
+{
+    PatchworkContext & context = *(state.context);
+    const ModelSet & models = *(state.models);
+    
+    // Look up the mixtures and their cascades
+    vector<const Mixture *> mixtures;
+    vector<const StarCascade *> mixtureCascades;
+    Size maxSize;
+    for (const std::string & classname : classnames)
+    {
+        mixtures.push_back(models.mixtures.at(classname).get());
+        mixtureCascades.push_back(models.getCascade(classname));
+        if (!mixtureCascades.back())
+            maxSize = max(maxSize, mixtures.back()->maxSize());
+    }
+    
+    scores.resize(mixtures.size());
+    for (size_t m = 0; m < mixtures.size(); ++m)
+        scores[m].assign(mixtures[m]->models().size(), vector<ScalarMatrix>());
+    
+    // Evaluate the mixtures in cascade mode location by location
+    for (size_t m = 0; m < mixtures.size(); ++m)
+        if (mixtureCascades[m])
+        {
+            StarCascade::Statistics & stats = state.cascadeStats[classnames[m]];
+            mixtureCascades[m]->computeScores(pyramid, scores[m], &stats);
+            if (state.verbose)
+            {
+                cerr << "Cascade of " << classnames[m] << " evaluated " << stats.locations << " locations:";
+                for (size_t s = 0; s < stats.pruned.size(); ++s)
+                    cerr << " " << StarCascade::stageName(s) << " pruned " << stats.pruned[s] << " of " << stats.evaluated[s] << ";";
+                cerr << endl;
+            }
+        }
+    if (maxSize.width == 0) // no mixtures left to be convolved densely
+        return;
+    
+    // Build a single patchwork for all other mixtures
+    Patchwork ownPatchwork;
+    if (!sharedPatchwork)
+        ownPatchwork = Patchwork(context, pyramid, maxSize / 2 + 1);
+    const Patchwork & patchwork = (sharedPatchwork) ? *sharedPatchwork : ownPatchwork;
+    state.numPlanes = patchwork.nbPlanes();
+    state.planeSize = Size(context.maxCols(), context.maxRows());
+    if (patchwork.empty())
+        return;
+    
+    // Determine how many filters may be convolved at once without exceeding the memory budget:
+    // For each filter, the products with all planes and the convolutions with all levels are kept in memory.
+    size_t maxFilters = numeric_limits<size_t>::max();
+    if (this->memoryBudget > 0)
+    {
+        size_t levelCells = 0;
+        for (const FeatureMatrix & level : pyramid.levels())
+            levelCells += level.rows() * level.cols();
+        const size_t bytesPerFilter = static_cast<size_t>(patchwork.nbPlanes()) * context.maxRows() * context.halfCols() * sizeof(Patchwork::Scalar)
+                                      + levelCells * sizeof(FeatureScalar);
+        maxFilters = max(static_cast<size_t>(1), this->memoryBudget / bytesPerFilter);
+    }
+    
+    // Convolve the patchwork with the filters of as many models as fit into the budget at once
+    // and merge the scores of those models into the scores of their mixtures
+    vector< pair<int, int> > chunkModels; // (mixture, model) pairs
+    vector<size_t> chunkOffsets; // offsets of the filters of each model in chunkFilters
+    vector<const Patchwork::Filter *> chunkFilters;
+    auto processChunk = [&]()
+    {
+        vector< vector<ScalarMatrix> > convolutions;
+        patchwork.convolve(chunkFilters, convolutions);
+        if (!convolutions.empty())
+        {
+            // Models of the same mixture are processed sequentially, different mixtures in parallel
+            vector<size_t> groups;
+            for (size_t k = 0; k < chunkModels.size(); ++k)
+                if (k == 0 || chunkModels[k].first != chunkModels[k - 1].first)
+                    groups.push_back(k);
+            groups.push_back(chunkModels.size());
+            
+            int g;
+#pragma omp parallel for private(g)
+            for (g = 0; g < static_cast<int>(groups.size()) - 1; ++g)
+                for (size_t k = groups[g]; k < groups[g + 1]; ++k)
+                {
+                    const int m = chunkModels[k].first;
+                    const size_t nbFilters = ((k + 1 < chunkOffsets.size()) ? chunkOffsets[k + 1] : chunkFilters.size()) - chunkOffsets[k];
+                    vector< vector<ScalarMatrix> > modelConvolutions(nbFilters);
+                    for (size_t f = 0; f < nbFilters; ++f)
+                        modelConvolutions[f].swap(convolutions[chunkOffsets[k] + f]);
+                    mixtures[m]->computeComponentScores(pyramid, chunkModels[k].second, modelConvolutions,
+                                                        scores[m][chunkModels[k].second]);
+                }
+        }
+        chunkModels.clear();
+        chunkOffsets.clear();
+        chunkFilters.clear();
+    };
+    
+    // The transformed filters of a mixture are only retrieved when needed and released after its last chunk,
+    // so that filters which are not cached permanently (see PatchworkContext::setFilterCachePolicy()) do not
+    // have to be held in memory for all mixtures at once
+    vector< shared_ptr<const PatchworkContext::FilterList> > mixtureFilters(mixtures.size());
+    for (size_t m = 0; m < mixtures.size(); ++m)
+        for (size_t k = 0, offset = 0; k < mixtures[m]->models().size() && !mixtureCascades[m]; ++k)
+        {
+            const size_t nbFilters = mixtures[m]->models()[k].nbParts() + 1;
+            if (!chunkFilters.empty() && chunkFilters.size() + nbFilters > maxFilters)
+            {
+                processChunk();
+                for (size_t done = 0; done < m; ++done)
+                    mixtureFilters[done].reset();
+            }
+            if (!mixtureFilters[m])
+                mixtureFilters[m] = context.filters(*(mixtures[m]));
+            chunkModels.push_back(make_pair(static_cast<int>(m), static_cast<int>(k)));
+            chunkOffsets.push_back(chunkFilters.size());
+            for (size_t f = 0; f < nbFilters; ++f)
+                chunkFilters.push_back(&(*mixtureFilters[m])[offset + f]);
+            offset += nbFilters;
+        }
+    if (!chunkFilters.empty())
+        processChunk();
+}
+
+void DPMDetection::levelScaleRange(const ModelSet & models, unsigned int featureExtractorIndex, unsigned int minObjectHeight,
+                                   unsigned int maxObjectHeight, double & minScale, double & maxScale) const
+{
+    // An object of height h (in cells) at scale s is (h / s) cells high in the image
+    const shared_ptr<FeatureExtractor> & featureExtractor = models.featureExtractors[featureExtractorIndex];
+    const double cellHeight = featureExtractor->cellSize().height;
+    double smallest = numeric_limits<double>::infinity(), largest = 0.0;
+    bool hasParts = false;
+    for ( map< std::string, shared_ptr<const Mixture> >::const_iterator m = models.mixtures.begin(); m != models.mixtures.end(); m++ )
+        if (models.featureExtractorIndices.at(m->first) == featureExtractorIndex)
+            for (const Model & model : m->second->models())
+            {
+                const double rootHeight = model.rootSize().height * cellHeight;
+                if (maxObjectHeight > 0)
+                    smallest = min(smallest, rootHeight / maxObjectHeight);
+                if (minObjectHeight > 0)
+                    largest = max(largest, rootHeight / minObjectHeight);
+                hasParts = hasParts || (model.nbParts() > 0);
+            }
+    
+    // The height of detections is rounded to whole cells, so include one more level on each side.
+    // Parts are evaluated at twice the resolution of the root.
+    const double levelStep = pow(2.0, 1.0 / this->interval);
+    minScale = (maxObjectHeight > 0 && smallest < numeric_limits<double>::infinity()) ? smallest / levelStep : 0.0;
+    maxScale = (minObjectHeight > 0 && largest > 0) ? largest * levelStep * ((hasParts) ? 2 : 1) : 0.0;
+}
+
+Size DPMDetection::ModelSet::patchworkPadding(unsigned int featureExtractorIndex) const
+{
+    Size maxSize;
+    for ( map< std::string, shared_ptr<const Mixture> >::const_iterator m = this->mixtures.begin(); m != this->mixtures.end(); m++ )
+        if (this->featureExtractorIndices.at(m->first) == featureExtractorIndex && !m->second->empty() && !this->getCascade(m->first))
+            maxSize = max(maxSize, m->second->maxSize());
+    return maxSize / 2 + 1;
+}
+
+shared_ptr<PatchworkContext> DPMDetection::createPatchworkContext() const
+{
+    shared_ptr<PatchworkContext> context = make_shared<PatchworkContext>();
+    context->setPlanningRigor(this->patchworkContext->planningRigor());
+    context->setFilterCachePolicy(this->patchworkContext->filterCachePolicy(), this->patchworkContext->filterCacheBudget());
+    context->setSIMDLevel(this->patchworkContext->simdLevel());
+    
+    lock_guard<mutex> lock(this->contextRegistry->mutex);
+    vector< weak_ptr<PatchworkContext> > & contexts = this->contextRegistry->contexts;
+    contexts.erase(remove_if(contexts.begin(), contexts.end(), [](const weak_ptr<PatchworkContext> & c) { return c.expired(); }),
+                   contexts.end());
+    contexts.push_back(context);
+    return context;
+}
+
+size_t DPMDetection::getFilterCacheMemory() const
+{
+    size_t memory = 0;
+    lock_guard<mutex> lock(this->contextRegistry->mutex);
+    for (const weak_ptr<PatchworkContext> & c : this->contextRegistry->contexts)
+    {
+        shared_ptr<PatchworkContext> context = c.lock();
+        if (context)
+            memory += context->filterCacheMemory();
+    }
+    return memory;
+}
+
+DPMDetection::DetectionState DPMDetection::defaultState()
+{
+    DetectionState state(NULL, this->verbose);
+    state.models = this->getModelSet();
+    state.lease = this->acquireContext(this->idleContexts);
+    state.context = state.lease.get();
+    return state;
+}
+
+shared_ptr<PatchworkContext> DPMDetection::acquireContext(vector< shared_ptr<PatchworkContext> > & pool)
+{
+    shared_ptr<PatchworkContext> context;
+    {
+        lock_guard<mutex> lock(this->contextMutex);
+        vector< shared_ptr<PatchworkContext> >::iterator it = find(pool.begin(), pool.end(), this->patchworkContext);
+        if (it == pool.end() && !pool.empty())
+            it = pool.end() - 1;
+        if (it != pool.end())
+        {
+            context = *it;
+            pool.erase(it);
+        }
+    }
+    if (!context)
+        context = this->createPatchworkContext();
+    
+    // Return the context to the pool as soon as the last detection using it has finished
+    return shared_ptr<PatchworkContext>(context.get(), [this, &pool, context](PatchworkContext *)
+    {
+        lock_guard<mutex> lock(this->contextMutex);
+        pool.push_back(context);
+    });
+}
+
+void DPMDetection::resetContexts()
+{
+    lock_guard<mutex> lock(this->contextMutex);
+    this->idleContexts.assign(1, this->patchworkContext);
+    this->batchContexts.clear();
+}
+
+void DPMDetection::setModelSet(const shared_ptr<const ModelSet> & modelSet)
+{
+    // Only the mixtures of new or replaced classes and of classes whose cascade has been disabled need to be
+    // transformed, the filters of the others are cached already
+    const shared_ptr<const ModelSet> currentSet = this->getModelSet();
+    vector<const Mixture *> newMixtures;
+    for ( map< std::string, shared_ptr<const Mixture> >::const_iterator m = modelSet->mixtures.begin(); m != modelSet->mixtures.end(); m++ )
+    {
+        map< std::string, shared_ptr<const Mixture> >::const_iterator current = currentSet->mixtures.find(m->first);
+        if (!modelSet->getCascade(m->first) && (current == currentSet->mixtures.end() || current->second != m->second || currentSet->getCascade(m->first)))
+            newMixtures.push_back(m->second.get());
+    }
+    if (newMixtures.empty())
+    {
+        atomic_store(&this->models, modelSet);
+        return;
+    }
+    
+    // Cache the transformed filters in the idle contexts, taking them out of their pool one at a time,
+    // so that other detections can use the remaining ones in the meantime
+    vector<PatchworkContext *> warmed;
+    for (vector< shared_ptr<PatchworkContext> > * pool : { &this->idleContexts, &this->batchContexts })
+        while (true)
+        {
+            shared_ptr<PatchworkContext> context;
+            {
+                lock_guard<mutex> lock(this->contextMutex);
+                for (vector< shared_ptr<PatchworkContext> >::iterator it = pool->begin(); it != pool->end(); ++it)
+                    if (find(warmed.begin(), warmed.end(), it->get()) == warmed.end())
+                    {
+                        context = *it;
+                        pool->erase(it);
+                        break;
+                    }
+            }
+            if (!context)
+                break;
+            
+            warmed.push_back(context.get());
+            if (context->numFeatures() > 0)
+                for (const Mixture * mixture : newMixtures)
+                    if (mixture->featureExtractor()->numFeatures() == context->numFeatures() && !context->hasFilters(*mixture))
+                        mixture->cacheFilters(*context);
+            
+            lock_guard<mutex> lock(this->contextMutex);
+            pool->push_back(context);
+        }
+    
+    atomic_store(&this->models, modelSet);
+}
+
+shared_ptr<const Mixture> DPMDetection::manageMixture(Mixture * mixture) const
+{
+    shared_ptr<ContextRegistry> registry = this->contextRegistry;
+    return shared_ptr<const Mixture>(mixture, [registry](const Mixture * m)
+    {
+        {
+            lock_guard<mutex> lock(registry->mutex);
+            for (const weak_ptr<PatchworkContext> & c : registry->contexts)
+            {
+                shared_ptr<PatchworkContext> context = c.lock();
+                if (context)
+                    context->releaseFilters(*m);
+            }
+        }
+        delete m;
+    });
+}
+
+void DPMDetection::applyThreadBudget(const DetectionState & state) const
+{
+    if (state.activeWorkers)
+        setNumThreads(max(1, state.totalThreads / max(1, state.activeWorkers->load())));
+}
+
+
+void DPMDetection::adoptState(const DetectionState & state)
+{
+    lock_guard<mutex> lock(this->stateMutex);
+    if (state.numPlanes >= 0)
+    {
+        this->numPlanes = state.numPlanes;
+        this->planeSize = state.planeSize;
+    }
+    for (map<std::string, StarCascade::Statistics>::const_iterator it = state.cascadeStats.begin(); it != state.cascadeStats.end(); ++it)
+        this->cascadeStats[it->first] = it->second;
+}
+
+int DPMDetection::initPatchwork(DetectionState & state, const FeaturePyramid & pyramid)
+{
+    vector<Size> levels;
+    for (const FeatureMatrix & level : pyramid.levels())
+        levels.push_back(Size(level.cols(), level.rows()));
+    return this->initPatchwork(state, levels, pyramid.levels()[0].channels());
+}
+
+int DPMDetection::initPatchwork(DetectionState & state, const vector<Size> & levels, int numFeatures)
+{
+    // Initialize the Patchwork context (only when necessary)
+    PatchworkContext & context = *(state.context);
+    const ModelSet & models = *(state.models);
+    const Size padding = models.maxModelSize() / 2 + 1; // the same padding is used by convolveMixtures()
+    const int rows = levels[0].height + padding.height;
+    const int cols = levels[0].width + padding.width;
+    if ( rows > context.maxRows() || cols > context.maxCols() || numFeatures != context.numFeatures() )
+    {
+        // Choose the plane size with the lowest estimated cost, not smaller than the current one to avoid
+        // re-initializations when switching between images of different size
+        int numFilters = 0;
+        for ( map< std::string, shared_ptr<const Mixture> >::const_iterator i = models.mixtures.begin(); i != models.mixtures.end(); i++ )
+            if (!models.getCascade(i->first))
+                numFilters += i->second->nbFilters();
+        int numPlanes;
+        const Size planeSize = PatchworkContext::choosePlaneSize(levels, padding, numFeatures, max(numFilters, 1),
+                                                                 Size(context.maxCols(), context.maxRows()), &numPlanes);
+        if (state.verbose) {
+            cerr << "Init values for Patchwork: " << planeSize.height << " x " << planeSize.width << " x " << numFeatures
+                 << " (" << numPlanes << " planes)" << endl;
             start();
         }
 
-        if (!Patchwork::Init(w, h, numFeatures)) {
-            if (this->verbose)
+        if (!context.init(planeSize.height, planeSize.width, numFeatures)) {
+            if (state.verbose)
                 cerr << "\nCould not initialize the Patchwork class" << endl;
             return ARTOS_RES_INTERNAL_ERROR;
         }
-        if (this->verbose) {
+        if (state.verbose) {
             cerr << "Initialized FFTW in " << stop() << " ms" << endl;
             start();
         }
         
         // Cache filters
-        for ( map<std::string, Mixture *>::iterator i = this->mixtures.begin(); i != this->mixtures.end(); i++ )
-            i->second->cacheFilters();
-        if (this->verbose) 
+        for ( map< std::string, shared_ptr<const Mixture> >::const_iterator i = models.mixtures.begin(); i != models.mixtures.end(); i++ )
+            if (!models.getCascade(i->first))
+                i->second->cacheFilters(context);
+        if (state.verbose) 
             cerr << "Transformed the filters in " << stop() << " ms" << endl;
     }
+    else if (context.upgradePlans() && state.verbose)
+        cerr << "Switched to FFTW plans upgraded in the background" << endl;
     return ARTOS_RES_OK;
 }
 
+int DPMDetection::enableCascade(const std::string & classname, const vector<JPEGImage> & images,
+                                const vector< vector<Rectangle> > & objects, int pcaDim, double tolerance)
+{
+    lock_guard<mutex> lock(this->modelMutex);
+    DetectionState state = this->defaultState();
+    const ModelSet & models = *(state.models);
+    map< std::string, shared_ptr<const Mixture> >::const_iterator mixtureIt = models.mixtures.find(classname);
+    if (mixtureIt == models.mixtures.end() || mixtureIt->second->empty())
+        return ARTOS_DETECT_RES_NO_MODELS;
+    if (images.empty())
+        return ARTOS_DETECT_RES_NO_IMAGES;
+    if (images.size() != objects.size())
+        return ARTOS_DETECT_RES_INVALID_ANNOTATIONS;
+    
+    const Mixture & mixture = *(mixtureIt->second);
+    shared_ptr<StarCascade> cascade = make_shared<StarCascade>(mixture, pcaDim);
+    unsigned int minLevelSize = min(5, models.minModelSize().min());
+    vector<Size> sizes(mixture.models().size());
+    for (size_t i = 0; i < sizes.size(); ++i)
+        sizes[i] = mixture.models()[i].rootSize();
+    
+    for (size_t img = 0; img < images.size(); ++img)
+    {
+        if (objects[img].empty())
+            continue;
+        
+        // Run the model densely on the image
+        FeaturePyramid pyramid(images[img], mixture.featureExtractor(), this->interval, minLevelSize);
+        if (pyramid.empty())
+            return ARTOS_DETECT_RES_INVALID_IMAGE;
+        int errcode = this->initPatchwork(state, pyramid);
+        if (errcode != ARTOS_RES_OK)
+            return errcode;
+        vector<ScalarMatrix> scores;
+        vector<Mixture::Indices> argmaxes;
+        mixture.convolve(*(state.context), pyramid, scores, argmaxes);
+        if (scores.empty())
+            return ARTOS_RES_INTERNAL_ERROR;
+        
+        // Find the best detection of each object
+        for (const Rectangle & object : objects[img])
+        {
+            const Intersector intersector(object, 0.5);
+            FeatureScalar bestScore = -numeric_limits<FeatureScalar>::infinity();
+            int bestLevel = -1, bestX = 0, bestY = 0;
+            for (size_t i = 0; i < scores.size(); ++i)
+            {
+                const double scale = pyramid.scales()[i];
+                for (int y = 0; y < scores[i].rows(); ++y)
+                    for (int x = 0; x < scores[i].cols(); ++x)
+                        if (scores[i](y, x) > bestScore)
+                        {
+                            const Size pos = pyramid.featureExtractor()->cellCoordsToPixels(Size(x / scale + 0.5, y / scale + 0.5));
+                            const Size size = pyramid.featureExtractor()->cellsToPixels(Size(
+                                    sizes[argmaxes[i](y, x)].width / scale + 0.5,
+                                    sizes[argmaxes[i](y, x)].height / scale + 0.5
+                            ));
+                            if (intersector(Rectangle(pos.width, pos.height, size.width, size.height)))
+                            {
+                                bestScore = scores[i](y, x);
+                                bestLevel = i;
+                                bestX = x;
+                                bestY = y;
+                            }
+                        }
+            }
+            if (bestLevel >= 0)
+                cascade->addPositive(pyramid, bestLevel, bestX, bestY, argmaxes[bestLevel](bestY, bestX));
+        }
+    }
+    
+    if (this->verbose)
+        cerr << "Learning cascade thresholds for " << classname << " from " << cascade->nbPositives() << " positive samples" << endl;
+    if (cascade->nbPositives() == 0)
+        return ARTOS_DETECT_RES_NO_RESULTS;
+    cascade->learnThresholds(tolerance, models.thresholds.at(classname));
+    
+    shared_ptr<ModelSet> modelSet = make_shared<ModelSet>(models);
+    modelSet->cascades[classname] = cascade;
+    this->setModelSet(modelSet);
+    lock_guard<mutex> stateLock(this->stateMutex);
+    this->cascadeStats.erase(classname);
+    return ARTOS_RES_OK;
+}
+
+int DPMDetection::enableCascade(const std::string & classname, const StarCascade & cascade)
+{
+    lock_guard<mutex> lock(this->modelMutex);
+    shared_ptr<ModelSet> modelSet = make_shared<ModelSet>(*(this->getModelSet()));
+    map< std::string, shared_ptr<const Mixture> >::const_iterator mixtureIt = modelSet->mixtures.find(classname);
+    if (mixtureIt == modelSet->mixtures.end() || cascade.empty()
+            || cascade.nbComponents() != static_cast<int>(mixtureIt->second->models().size()))
+        return ARTOS_DETECT_RES_NO_MODELS;
+    modelSet->cascades[classname] = make_shared<StarCascade>(cascade);
+    this->setModelSet(modelSet);
+    lock_guard<mutex> stateLock(this->stateMutex);
+    this->cascadeStats.erase(classname);
+    return ARTOS_RES_OK;
+}
+
+void DPMDetection::disableCascade(const std::string & classname)
+{
+    {
+        lock_guard<mutex> lock(this->modelMutex);
+        shared_ptr<ModelSet> modelSet = make_shared<ModelSet>(*(this->getModelSet()));
+        if (modelSet->cascades.erase(classname) > 0)
+            this->setModelSet(modelSet);
+    }
+    lock_guard<mutex> lock(this->stateMutex);
+    this->cascadeStats.erase(classname);
+}
+
+const StarCascade * DPMDetection::getCascade(const std::string & classname) const
+{
+    return this->getModelSet()->getCascade(classname);
+}
+
+const StarCascade * DPMDetection::ModelSet::getCascade(const std::string & classname) const
+{
+    map< std::string, shared_ptr<const StarCascade> >::const_iterator it = this->cascades.find(classname);
+    return (it != this->cascades.end()) ? it->second.get() : NULL;
+}
+
+StarCascade::Statistics DPMDetection::getCascadeStatistics(const std::string & classname) const
+{
+    lock_guard<mutex> lock(this->stateMutex);
+    map<std::string, StarCascade::Statistics>::const_iterator it = this->cascadeStats.find(classname);
+    return (it != this->cascadeStats.end()) ? it->second : StarCascade::Statistics();
+}
+
 int DPMDetection::addModels ( const std::string & modellistfn )
 {
     ifstream ifs ( modellistfn.c_str(), ifstream::in);
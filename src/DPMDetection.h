@@ -3,10 +3,15 @@
 
 #include <string>
 #include <map>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 #include "libartos_def.h"
 #include "Mixture.h"
 #include "Patchwork.h"
+#include "PatchworkContext.h"
+#include "StarCascade.h"
 #include "JPEGImage.h"
 
 namespace ARTOS
@@ -43,8 +48,56 @@ struct Detection : public Rectangle
     }
 };
 
+/**
+* Throughput and latency of a batch of images processed by DPMDetection::detectBatch().
+*/
+struct BatchStatistics
+{
+    unsigned int numImages; /**< Number of images processed. */
+    unsigned int numThreads; /**< Number of worker threads processing images concurrently. */
+    double seconds; /**< Wall-clock time needed for the whole batch in seconds. */
+    double imagesPerSecond; /**< Number of images processed per second. */
+    double meanLatency; /**< Mean time needed for a single image in milliseconds. */
+    double latencyP50; /**< Median of the time needed for a single image in milliseconds. */
+    double latencyP90; /**< 90th percentile of the time needed for a single image in milliseconds. */
+    double latencyP99; /**< 99th percentile of the time needed for a single image in milliseconds. */
+    double maxLatency; /**< Maximum time needed for a single image in milliseconds. */
+    
+    BatchStatistics() : numImages(0), numThreads(0), seconds(0), imagesPerSecond(0), meanLatency(0),
+                        latencyP50(0), latencyP90(0), latencyP99(0), maxLatency(0) {};
+};
+
+/**
+* Information about the work done by DPMDetection::detectAnytime() before its deadline.
+*/
+struct AnytimeStatistics
+{
+    bool complete; /**< True if all classes have been searched for on all pyramid levels. */
+    unsigned int numUnits; /**< Number of units of work (one class on one octave of the feature pyramid). */
+    unsigned int numUnitsProcessed; /**< Number of units of work processed before the deadline. */
+    double pyramidMaxScale; /**< Largest scale of the feature pyramid (scales greater than 1 are upsampled). */
+    std::map<std::string, double> maxScale; /**< For each class, the largest scale searched, 0 if it has not been searched at all.
+                                                 Levels with a scale less than this have all been searched, so that only small
+                                                 objects may have been missed if this is less than `pyramidMaxScale`. */
+    double milliseconds; /**< Time needed in milliseconds. */
+    
+    AnytimeStatistics() : complete(false), numUnits(0), numUnitsProcessed(0), pyramidMaxScale(0), milliseconds(0) {};
+};
+
 /**
 * Class for fast detection of objects on images using deformable part models, based on the FFLD library.
+*
+* detect(), detectMax(), detectAnytime(), detectTiled() and detectBatch() may be called concurrently from
+* multiple threads on the same instance. Each running detection uses a patchwork context of its own, which is
+* taken from a pool and returned after the detection, so that FFTW plans and transformed filters are reused.
+*
+* Models can be added or replaced and cascades can be enabled or disabled while detections are running, without
+* having to wait for them: Each detection works on a snapshot of the models taken when it starts, while the
+* modifications are applied to a copy, which is used by all detections started after the modification has
+* returned. The transformed filters of new models are cached in the idle patchwork contexts before the new models
+* are used, so that subsequent detections do not have to wait for them. Other settings must not be changed while
+* detections are running.
+*
 * @author Erik Rodner
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
 */
@@ -118,7 +171,18 @@ public:
     */
     DPMDetection ( Mixture && model, double threshold = 0.8, bool verbose = false, double overlap = 0.5, int interval = 10 );
 
+    /**
+    * Moves the models and settings of another detector to a new one, leaving the other one without models.
+    * No detections or streams (see StreamDetector) may be running on the other detector.
+    *
+    * @param[in] other The detector to be moved.
+    */
+    DPMDetection ( DPMDetection && other );
+
     ~DPMDetection();
+    
+    DPMDetection ( const DPMDetection & ) = delete;
+    DPMDetection & operator= ( const DPMDetection & ) = delete;
 
     /**
     * Detects objects in a given image which match one of the models added before using addModel() or addModels().
@@ -131,6 +195,55 @@ public:
     */
     int detect ( const JPEGImage & image, std::vector<Detection> & detections );
 
+    /**
+    * Detects objects of a given range of heights in a region of interest of an image, which match one of the models
+    * added before using addModel() or addModels().
+    *
+    * Features are only computed for the region of interest and only for the scales needed for detecting objects
+    * of the given height, which reduces the cost of feature computation as well as of the convolutions accordingly.
+    * Objects are truncated at the borders of the region of interest just like at the borders of the image.
+    *
+    * @param[in] image The image.
+    *
+    * @param[out] detections A vector that will receive information about the detected objects. Their bounding boxes
+    * are given in the coordinates of the image, not of the region of interest.
+    *
+    * @param[in] roi The region of interest. It will be clipped to the image. An empty rectangle means the entire image.
+    *
+    * @param[in] minObjectHeight Only objects with a height of at least this number of pixels will be detected.
+    * 0 means no limit.
+    *
+    * @param[in] maxObjectHeight Only objects with a height of at most this number of pixels will be detected.
+    * 0 means no limit.
+    *
+    * @return Returns zero on success, otherwise a negative error code. If the region of interest is too small
+    * for the feature pyramid, ARTOS_DETECT_RES_INVALID_IMAGE will be returned.
+    */
+    int detect ( const JPEGImage & image, std::vector<Detection> & detections, const Rectangle & roi,
+                 unsigned int minObjectHeight = 0, unsigned int maxObjectHeight = 0 );
+
+    /**
+    * Detects objects of a given range of heights in an image, which match one of the models added before
+    * using addModel() or addModels(). Features will only be computed for the scales needed for detecting
+    * objects of that height.
+    *
+    * This is equivalent to calling `detect(image, detections, Rectangle(), minObjectHeight, maxObjectHeight)`.
+    *
+    * @param[in] image The image.
+    *
+    * @param[out] detections A vector that will receive information about the detected objects.
+    *
+    * @param[in] minObjectHeight Only objects with a height of at least this number of pixels will be detected.
+    * 0 means no limit.
+    *
+    * @param[in] maxObjectHeight Only objects with a height of at most this number of pixels will be detected.
+    * 0 means no limit.
+    *
+    * @return Returns zero on success, otherwise a negative error code.
+    */
+    int detect ( const JPEGImage & image, std::vector<Detection> & detections,
+                 unsigned int minObjectHeight, unsigned int maxObjectHeight );
+
     /**
     * Matches the models added before using addModel() or addModels() against a given feature pyramid to detect objects.
     *
@@ -159,6 +272,98 @@ public:
     * @return Returns zero on success, otherwise a negative error code.
     */
     int detectMax ( const JPEGImage & image, Detection & detection );
+
+    /**
+    * Detects objects in a batch of images, which are processed concurrently by a pool of worker threads.
+    *
+    * Instead of parallelizing the computations for a single image, each worker processes whole images,
+    * which scales better for small images. Images are distributed evenly among the workers in advance and
+    * workers which have run out of images steal them from the others. Once no images are left to be stolen,
+    * the threads of idle workers are lent to the remaining ones for parallelizing the computations for their
+    * last images, so that a few large images at the end of a batch do not delay its completion. Workers take
+    * up the lent threads before each stage of a detection (feature pyramid, convolutions and peak search).
+    *
+    * Each worker uses a patchwork context of its own, which is kept for subsequent batches. Thus, memory
+    * needed for convolutions and cached filters grows with the number of workers. Note that scores near the
+    * borders of pyramid levels depend slightly on the size of the patchwork planes, which each context chooses
+    * based on the images it has processed before, so that they may differ marginally from those found by detect().
+    *
+    * @param[in] images The images.
+    *
+    * @param[out] detections Receives the detections for each image.
+    *
+    * @param[out] stats Optionally, receives the throughput and the distribution of the time needed per image.
+    *
+    * @param[out] results Optionally, receives the result of detect() for each image. Images which
+    * could not be processed do not prevent the remaining images from being processed.
+    *
+    * @param[in] numThreads Number of worker threads. 0 means the number of threads available to OpenMP.
+    *
+    * @return Returns zero if all images have been processed successfully, otherwise the error code of the
+    * first image which failed.
+    */
+    int detectBatch ( const std::vector<JPEGImage> & images, std::vector< std::vector<Detection> > & detections,
+                      BatchStatistics * stats = 0, std::vector<int> * results = 0, unsigned int numThreads = 0 );
+    
+    /**
+    * Detects objects in an image within a given time limit, returning the detections found so far if the
+    * time limit is exceeded.
+    *
+    * The work is divided into units, each searching for one class on one octave of the feature pyramid.
+    * Octaves are processed from coarse to fine, i.e. large objects are searched for first, and the classes
+    * on each octave in the order of priority given by `classPriority`. The time limit is checked between
+    * units of work, so that it may be exceeded by the time needed for one unit. Features are only computed
+    * for the octaves which are actually processed and a single patchwork is shared by all classes on an octave.
+    *
+    * Apart from scores near the borders of pyramid levels, which depend slightly on the layout of the patchwork
+    * planes, the result equals that of detect() if the time limit is not exceeded. Since each octave is convolved
+    * on patchwork planes of its own and the levels referred to by parts are convolved twice, the total time needed
+    * is higher than that of detect().
+    *
+    * @param[in] image The image.
+    *
+    * @param[out] detections A vector that will receive information about the detected objects.
+    *
+    * @param[in] timeLimit The maximum number of milliseconds to spend. 0 means no limit.
+    *
+    * @param[out] stats Optionally, receives information about which classes and scales have been searched.
+    *
+    * @param[in] classPriority Names of the classes to be searched for first, in order of decreasing priority.
+    * Classes not contained in this list are searched for afterwards in alphabetical order.
+    *
+    * @return Returns zero on success, otherwise a negative error code. Exceeding the time limit is not an error.
+    */
+    int detectAnytime ( const JPEGImage & image, std::vector<Detection> & detections, unsigned int timeLimit,
+                        AnytimeStatistics * stats = 0, const std::vector<std::string> & classPriority = std::vector<std::string>() );
+    
+    /**
+    * Detects objects in a large image by splitting it into overlapping tiles, which are processed in parallel
+    * on patchwork planes of fixed size, so that the memory needed does not grow with the size of the image.
+    *
+    * The range of object heights is divided into octaves. For each octave, the image is split into tiles whose
+    * pyramid levels needed for objects of that height fit into a single plane and which overlap by the largest
+    * extent of such objects, so that each object lies completely inside of at least one tile. Detections touching
+    * the inner borders of a tile are discarded in favour of those found in the neighbouring tile and non-maximum
+    * suppression is applied to the detections of all tiles. Objects as high as the image are searched for on the
+    * entire image at once, which is feasible since only the coarsest levels of the pyramid are needed for them.
+    *
+    * Since the features of a tile are not aligned with those of the entire image, scores may differ slightly
+    * from those computed by detect().
+    *
+    * @param[in] image The image.
+    *
+    * @param[out] detections A vector that will receive information about the detected objects.
+    *
+    * @param[in] planeSize The number of rows and columns of the patchwork planes (in cells). It will be rounded up to
+    * an FFT-friendly size and increased if the tiles would not be considerably larger than the models otherwise.
+    *
+    * @param[in] numThreads Number of tiles processed concurrently. 0 means the number of threads available to OpenMP.
+    * Each thread uses a patchwork context of its own, which is shared with detectBatch().
+    *
+    * @return Returns zero on success, otherwise a negative error code.
+    */
+    int detectTiled ( const JPEGImage & image, std::vector<Detection> & detections, unsigned int planeSize = 256,
+                      unsigned int numThreads = 0 );
     
     /**
     * Adds a model to the detection stack.
@@ -269,7 +474,7 @@ public:
     /**
     * @return The number of mixtures in the detection stack.
     */
-    unsigned int getNumModels() const { return this->mixtures.size(); };
+    unsigned int getNumModels() const { return this->getModelSet()->mixtures.size(); };
     
     /**
     * Returns a model added before using addModel() or addModels().
@@ -277,6 +482,7 @@ public:
     * @param[in] classname The class name of the model to be returned.
     *
     * @return Returns a pointer to a Mixture object or NULL if there is no model with that class name.
+    * The pointer becomes invalid when the model is replaced and no detection using it is running anymore.
     */
     const Mixture * getModel(const std::string & classname) const;
     
@@ -316,7 +522,173 @@ public:
     * @note Though mixing models which use different feature extractors is possible, it is not recommended, since a separate
     * feature pyramid would have to be built for every feature extractor, which will slow down detection significantly.
     */
-    int differentFeatureExtractors() const { return this->featureExtractors.size(); };
+    int differentFeatureExtractors() const { return this->getModelSet()->featureExtractors.size(); };
+    
+    /**
+    * Limits the amount of memory used for the convolutions of the filters with the feature pyramid.
+    *
+    * By default, all filters are convolved with the feature pyramid at once, which requires memory for the
+    * products of every filter with every patchwork plane in the Fourier domain and for the convolutions of
+    * every filter with every pyramid level. If a budget is set, the filters will be processed in chunks of
+    * as many models as fit into the budget and the scores of each model will be computed as soon as the
+    * convolutions of its filters are available, so that the convolutions can be released.
+    *
+    * @param[in] bytes Approximate maximum number of bytes to be used for the convolutions. A model
+    * whose filters exceed the budget on their own will be processed alone. 0 means no limit.
+    */
+    void setMemoryBudget(size_t bytes) { this->memoryBudget = bytes; };
+    
+    /**
+    * @return Returns the memory budget for the convolutions set by setMemoryBudget(), 0 meaning no limit.
+    */
+    size_t getMemoryBudget() const { return this->memoryBudget; };
+    
+    /**
+    * Selects how the transformed filters of the models of this detector are kept in memory between detections.
+    *
+    * By default, they are cached in single precision, which needs `maxRows x halfCols x numFeatures` complex
+    * numbers per filter for the current patchwork plane size and may sum up to gigabytes for large catalogs of models.
+    * See PatchworkContext::setFilterCachePolicy() for the alternatives.
+    *
+    * @param[in] policy The cache policy.
+    *
+    * @param[in] budget Maximum number of bytes to be occupied by cached filters. If exceeded, the filters of the
+    * classes used least recently will be evicted and transformed again when needed. 0 means no limit.
+    * The budget applies to each patchwork context separately: concurrent detections and the workers of
+    * detectBatch() and detectTiled() use contexts of their own, so that the total memory occupied by
+    * cached filters may reach the budget times the number of contexts in use at the same time.
+    */
+    void setFilterCachePolicy(FilterCachePolicy policy, size_t budget = 0)
+    {
+        this->patchworkContext->setFilterCachePolicy(policy, budget);
+        this->resetContexts(); // will be re-created with the new policy when needed
+    };
+    
+    /**
+    * @return Returns the policy used for keeping transformed filters in memory.
+    */
+    FilterCachePolicy getFilterCachePolicy() const { return this->patchworkContext->filterCachePolicy(); };
+    
+    /**
+    * @return Returns the number of bytes currently occupied by the cached transformed filters of this detector,
+    * summed up over all its patchwork contexts.
+    */
+    size_t getFilterCacheMemory() const;
+    
+    /**
+    * Sets how much time FFTW spends on planning the transforms whenever the patchwork planes have to be resized.
+    *
+    * With a background upgrade, detection starts immediately with estimated plans and switches to plans
+    * of the requested rigor at the beginning of the first detection after they have been created by a
+    * background thread. See PatchworkContext::setPlanningRigor() for details.
+    *
+    * @param[in] rigor The rigor of the FFTW planner. The default is PlanningRigor::PATIENT.
+    *
+    * @param[in] backgroundUpgrade Whether to plan with the requested rigor in the background.
+    */
+    void setPlanningRigor(PlanningRigor rigor, bool backgroundUpgrade = false)
+    {
+        this->patchworkContext->setPlanningRigor(rigor, backgroundUpgrade);
+        this->resetContexts(); // will be re-created with the new rigor when needed
+    };
+    
+    /**
+    * @return Returns the rigor of the FFTW plans currently in use.
+    */
+    PlanningRigor getCurrentPlanningRigor() const { return this->patchworkContext->currentPlanningRigor(); };
+    
+    /**
+    * @return Returns the size of the patchwork planes used for convolving the feature pyramid of the last image
+    * processed by this detector with the models in the Fourier domain. It is chosen by a cost model the first time
+    * an image is processed and whenever an image does not fit into the current planes. A size of 0 x 0 is returned
+    * if no image has been processed yet.
+    */
+    Size getPlaneSize() const
+    {
+        std::lock_guard<std::mutex> lock(this->stateMutex);
+        return this->planeSize;
+    };
+    
+    /**
+    * @return Returns the number of patchwork planes needed for the last image processed by this detector.
+    */
+    int getNumPlanes() const
+    {
+        std::lock_guard<std::mutex> lock(this->stateMutex);
+        return this->numPlanes;
+    };
+    
+    /**
+    * Switches the detection of a class to cascade mode: Instead of convolving the whole feature pyramid with
+    * all filters in the Fourier domain, each root location is evaluated stage by stage with PCA-projected and
+    * full filters and pruned as soon as its partial score falls below the threshold of the stage. Parts are
+    * only evaluated at root locations which survive (see StarCascade).
+    *
+    * The pruning thresholds are learned from positive samples: The model is run densely on the given images and,
+    * for each annotated object, the best-scoring detection overlapping it by at least 50% is used as positive sample.
+    *
+    * @param[in] classname The name of the class.
+    *
+    * @param[in] images Images containing objects of that class.
+    *
+    * @param[in] objects The bounding boxes of the objects on each image.
+    *
+    * @param[in] pcaDim Number of dimensions of the PCA projection used by the first stage of each filter.
+    *
+    * @param[in] tolerance Fraction of the positive samples which may be pruned at each stage. Greater values lead
+    * to faster, but less accurate detection.
+    *
+    * @return ARTOS_RES_OK on success or one of the following error codes on failure:
+    *         - ARTOS_DETECT_RES_NO_MODELS (no model has been added for that class)
+    *         - ARTOS_DETECT_RES_NO_IMAGES (no images given)
+    *         - ARTOS_DETECT_RES_INVALID_ANNOTATIONS (number of images and bounding box lists differ)
+    *         - ARTOS_DETECT_RES_INVALID_IMAGE (an image could not be processed)
+    *         - ARTOS_DETECT_RES_NO_RESULTS (none of the objects has been detected by the model)
+    *         - ARTOS_RES_INTERNAL_ERROR
+    */
+    int enableCascade(const std::string & classname, const std::vector<JPEGImage> & images,
+                      const std::vector< std::vector<Rectangle> > & objects, int pcaDim = 5, double tolerance = 0.0);
+    
+    /**
+    * Switches the detection of a class to cascade mode using a given cascade, e.g. with thresholds
+    * set explicitly by StarCascade::setThresholds().
+    *
+    * @param[in] classname The name of the class.
+    *
+    * @param[in] cascade The cascade, which must have been constructed from the model of that class.
+    *
+    * @return ARTOS_RES_OK on success or ARTOS_DETECT_RES_NO_MODELS if no model has been added for that class
+    * or the cascade does not match the model.
+    */
+    int enableCascade(const std::string & classname, const StarCascade & cascade);
+    
+    /**
+    * Switches the detection of a class back to dense evaluation of all filters.
+    *
+    * @param[in] classname The name of the class.
+    */
+    void disableCascade(const std::string & classname);
+    
+    /**
+    * @param[in] classname The name of a class.
+    *
+    * @return Returns the cascade used for detecting that class or NULL if cascade mode is disabled for it.
+    */
+    const StarCascade * getCascade(const std::string & classname) const;
+    
+    /**
+    * @param[in] classname The name of a class.
+    *
+    * @return Returns the number of locations evaluated and pruned at each stage of the cascade of a class
+    * during the last detection.
+    */
+    StarCascade::Statistics getCascadeStatistics(const std::string & classname) const;
+    
+    
+    /**
+    * Make the StreamDetector class a friend so that it can run the stages of detection concurrently.
+    */
+    friend class StreamDetector;
 
 
 protected:
@@ -325,16 +697,340 @@ protected:
     int interval;
     bool verbose;
     unsigned int nextModelIndex;
+    size_t memoryBudget;
+    int numPlanes;
+    Size planeSize;
 
-    std::map<std::string, Mixture*> mixtures;
-    std::map<std::string, double> thresholds;
-    std::map<std::string, std::string> synsetIds;
-    std::map<std::string, unsigned int> modelIndices;
-    std::map<std::string, unsigned int> featureExtractorIndices;
+    /**
+    * The models of this detector along with everything associated with them. A set is never modified
+    * once it has been published using setModelSet(), so that detections can use it without locking.
+    */
+    struct ModelSet
+    {
+        std::map< std::string, std::shared_ptr<const Mixture> > mixtures;
+        std::map<std::string, double> thresholds;
+        std::map<std::string, std::string> synsetIds;
+        std::map<std::string, unsigned int> modelIndices;
+        std::map<std::string, unsigned int> featureExtractorIndices;
+        
+        std::vector< std::shared_ptr<FeatureExtractor> > featureExtractors;
+        
+        std::map< std::string, std::shared_ptr<const StarCascade> > cascades; /**< Cascades of the classes detected in cascade mode. */
+        
+        /**
+        * @param[in] classname The name of a class.
+        *
+        * @return Returns the cascade used for detecting that class or NULL if cascade mode is disabled for it.
+        */
+        const StarCascade * getCascade(const std::string & classname) const;
+        
+        /**
+        * @return Returns the minimum size of all models in this set.
+        */
+        Size minModelSize() const;
+        
+        /**
+        * @return Returns the maximum size of all models in this set.
+        */
+        Size maxModelSize() const;
+        
+        /**
+        * @param[in] featureExtractorIndex The index of a feature extractor in `featureExtractors`.
+        *
+        * @return Returns the padding of the patchwork for the mixtures using the given feature extractor,
+        * which are not detected in cascade mode.
+        */
+        Size patchworkPadding(unsigned int featureExtractorIndex) const;
+    };
     
-    std::vector< std::shared_ptr<FeatureExtractor> > featureExtractors;
+    std::shared_ptr<const ModelSet> models; /**< The current set of models. Must be accessed using getModelSet() and setModelSet(). */
+    std::mutex modelMutex; /**< Serializes modifications of the set of models. */
+    
+    /**
+    * All patchwork contexts created by a detector, whether idle or in use, for releasing the transformed
+    * filters of mixtures which are not used anymore.
+    */
+    struct ContextRegistry
+    {
+        std::mutex mutex;
+        std::vector< std::weak_ptr<PatchworkContext> > contexts;
+    };
+    std::shared_ptr<ContextRegistry> contextRegistry;
     
-    int initPatchwork(unsigned int rows, unsigned int cols, unsigned int numFeatures);
+    std::shared_ptr<PatchworkContext> patchworkContext; /**< FFTW plans and transformed filters used by this detector. */
+    
+    std::map<std::string, StarCascade::Statistics> cascadeStats; /**< Pruning statistics of the last detection of each cascade. */
+    
+    std::vector< std::shared_ptr<PatchworkContext> > idleContexts; /**< Contexts for single detections not in use at the moment. */
+    std::vector< std::shared_ptr<PatchworkContext> > batchContexts; /**< Contexts for the workers of detectBatch() and detectTiled() and for StreamDetector not in use at the moment. */
+    std::mutex contextMutex; /**< Protects `idleContexts` and `batchContexts`. */
+    mutable std::mutex stateMutex; /**< Protects `numPlanes`, `planeSize` and `cascadeStats`. */
+    
+    /**
+    * Everything modified by a single detection, so that several detections can be run concurrently
+    * using different patchwork contexts.
+    */
+    struct DetectionState
+    {
+        std::shared_ptr<const ModelSet> models; /**< The snapshot of the models used by the detection. */
+        PatchworkContext * context; /**< The patchwork context used for convolutions. */
+        std::shared_ptr<PatchworkContext> lease; /**< Returns the context to its pool when the state is destroyed (see acquireContext()). */
+        std::vector< std::shared_ptr<PatchworkContext> > extractorContexts; /**< If not empty, the leased context used for each feature extractor instead of `context`. */
+        bool verbose; /**< Whether to log debug and timing information (not thread-safe). */
+        int numPlanes; /**< Receives the number of patchwork planes of the last pyramid, -1 if no patchwork has been built. */
+        Size planeSize; /**< Receives the size of the patchwork planes of the last pyramid. */
+        std::map<std::string, StarCascade::Statistics> cascadeStats; /**< Receives the statistics of each cascade. */
+        unsigned int minObjectHeight; /**< Minimum height of detected objects in pixels (0 for no limit). */
+        unsigned int maxObjectHeight; /**< Maximum height of detected objects in pixels (0 for no limit). */
+        const std::atomic<int> * activeWorkers; /**< Number of workers sharing `totalThreads` (see applyThreadBudget()) or `NULL`. */
+        int totalThreads; /**< Number of threads shared by all workers of a batch. */
+        
+        DetectionState(PatchworkContext * context = 0, bool verbose = false)
+        : context(context), verbose(verbose), numPlanes(-1), minObjectHeight(0), maxObjectHeight(0),
+          activeWorkers(NULL), totalThreads(0) {};
+    };
+    
+    /**
+    * @return Returns the state for a detection using the current set of models and a patchwork context not used
+    * by any other detection. This is the context of this detector unless detections are running concurrently.
+    */
+    DetectionState defaultState();
+    
+    /**
+    * Takes a patchwork context from a pool of idle contexts, preferring the context of this detector,
+    * or creates a new one if the pool is empty.
+    *
+    * @param[in,out] pool The pool (`idleContexts` or `batchContexts`).
+    *
+    * @return Returns a pointer to the context. When the last copy of it is destroyed, the context is returned
+    * to the pool, so that it is only used by one detection at a time.
+    */
+    std::shared_ptr<PatchworkContext> acquireContext(std::vector< std::shared_ptr<PatchworkContext> > & pool);
+    
+    /**
+    * Removes all patchwork contexts except the context of this detector from the pools, so that they will
+    * be re-created with the current settings. Must not be called while detections are running.
+    */
+    void resetContexts();
+    
+    /**
+    * @return Returns the current set of models.
+    */
+    std::shared_ptr<const ModelSet> getModelSet() const { return std::atomic_load(&this->models); };
+    
+    /**
+    * Replaces the current set of models. Detections running at the moment keep using the old set.
+    *
+    * Before the new set is published, the transformed filters of the mixtures of new or replaced classes are cached
+    * in all idle patchwork contexts which have been initialized already and do not hold them yet, one at a time, so
+    * that detections do not have to wait for them. The filters of the other classes are not transformed again.
+    * `modelMutex` must be held by the caller, which must have created the new set as a copy of the current one.
+    *
+    * @param[in] modelSet The new set of models.
+    */
+    void setModelSet(const std::shared_ptr<const ModelSet> & modelSet);
+    
+    /**
+    * Takes ownership of a mixture for being stored in a ModelSet.
+    *
+    * @param[in] mixture The mixture.
+    *
+    * @return Returns a pointer which deletes the mixture and releases its transformed filters from all
+    * patchwork contexts of this detector when the mixture is not used by any set of models anymore.
+    */
+    std::shared_ptr<const Mixture> manageMixture(Mixture * mixture) const;
+    
+    /**
+    * Stores the number of planes and the cascade statistics of a detection in the members of this detector,
+    * where they can be retrieved by getNumPlanes() and getCascadeStatistics().
+    */
+    void adoptState(const DetectionState & state);
+    
+    /**
+    * Sets the number of threads used by the calling thread for the next stage of a detection to its share of
+    * the threads of the batch, if the state belongs to a worker of detectBatch(). This is called before each
+    * stage, so that workers processing their last images get the threads of those which have finished already.
+    */
+    void applyThreadBudget(const DetectionState & state) const;
+    
+    /**
+    * Implementation of detect() for a given detection state.
+    */
+    int detect ( DetectionState & state, const JPEGImage & image, std::vector<Detection> & detections );
+    
+    /**
+    * Implementation of detect() on a feature pyramid for a given detection state.
+    */
+    int detect ( DetectionState & state, int width, int height, const FeaturePyramid & pyramid,
+                 std::vector<Detection> & detections, unsigned int featureExtractorIndex );
+    
+    /**
+    * Computes the feature pyramid of an image for one of the feature extractors used by the models.
+    * If the height of the objects to be detected is limited by the detection state, only the levels
+    * needed for detecting objects of that height will be computed.
+    *
+    * @param[in] state The detection state.
+    *
+    * @param[in] image The image.
+    *
+    * @param[in] featureExtractorIndex The index of the feature extractor in `featureExtractors`.
+    *
+    * @param[out] pyramid Receives the feature pyramid.
+    *
+    * @return ARTOS_RES_OK on success or ARTOS_DETECT_RES_INVALID_IMAGE if the pyramid could not be computed.
+    * If objects of the height requested by the detection state cannot be detected at all, the pyramid will
+    * be empty, but ARTOS_RES_OK will be returned.
+    */
+    int computePyramid ( const DetectionState & state, const JPEGImage & image, unsigned int featureExtractorIndex,
+                         FeaturePyramid & pyramid ) const;
+    
+    /**
+    * Finds the local maxima of the scores of all mixtures associated with a given feature extractor
+    * on a feature pyramid, without applying non-maximum suppression. Detections whose height is outside
+    * of the range given by the detection state are discarded.
+    *
+    * @param[in,out] state The detection state.
+    *
+    * @param[in] width The width of the image the pyramid has been computed from.
+    *
+    * @param[in] height The height of the image the pyramid has been computed from.
+    *
+    * @param[in] pyramid The feature pyramid.
+    *
+    * @param[out] candidates A vector with the candidate detections of each class will be appended to this.
+    *
+    * @param[in] featureExtractorIndex The index of the feature extractor in `featureExtractors`.
+    *
+    * @return ARTOS_RES_OK on success or ARTOS_RES_INTERNAL_ERROR if the patchwork context could not be initialized.
+    */
+    int findCandidates ( DetectionState & state, int width, int height, const FeaturePyramid & pyramid,
+                         std::vector< std::vector<Detection> > & candidates, unsigned int featureExtractorIndex );
+    
+    /**
+    * Applies non-maximum suppression to the candidate detections found by findCandidates() for each class.
+    *
+    * @param[in] state The detection state (only used for logging).
+    *
+    * @param[in,out] candidates The candidate detections of each class. They will be sorted and suppressed in-place.
+    *
+    * @param[in,out] detections The remaining detections will be inserted at the beginning of this vector.
+    */
+    void suppressCandidates ( const DetectionState & state, std::vector< std::vector<Detection> > & candidates,
+                              std::vector<Detection> & detections ) const;
+    
+    /**
+    * Determines the range of scales of pyramid levels needed for detecting objects of a given height
+    * with the models associated with a feature extractor, including the levels needed for the parts.
+    *
+    * @param[in] models The set of models.
+    *
+    * @param[in] featureExtractorIndex The index of the feature extractor in `featureExtractors`.
+    *
+    * @param[in] minObjectHeight Minimum height of the objects in pixels (0 for no limit).
+    *
+    * @param[in] maxObjectHeight Maximum height of the objects in pixels (0 for no limit).
+    *
+    * @param[out] minScale Receives the smallest scale needed.
+    *
+    * @param[out] maxScale Receives the largest scale needed or 0 if there is no limit.
+    */
+    void levelScaleRange ( const ModelSet & models, unsigned int featureExtractorIndex, unsigned int minObjectHeight,
+                           unsigned int maxObjectHeight, double & minScale, double & maxScale ) const;
+    
+    /**
+    * @return Returns a new patchwork context with the same settings as the context of this detector,
+    * which is added to the registry of contexts.
+    */
+    std::shared_ptr<PatchworkContext> createPatchworkContext() const;
+    
+    /**
+    * Initializes the patchwork context of a detection state for a given feature pyramid if the levels of
+    * the pyramid do not fit into the current patchwork planes. The new plane size will be chosen by
+    * PatchworkContext::choosePlaneSize() and all filters will be transformed again.
+    *
+    * @param[in,out] state The detection state.
+    *
+    * @param[in] pyramid The feature pyramid to be processed.
+    *
+    * @return ARTOS_RES_OK on success or ARTOS_RES_INTERNAL_ERROR if the context could not be initialized.
+    */
+    int initPatchwork(DetectionState & state, const FeaturePyramid & pyramid);
+    
+    /**
+    * Initializes the patchwork context of a given detection state for pyramids with levels of given size,
+    * if it is not large enough already.
+    *
+    * @param[in,out] state The detection state.
+    *
+    * @param[in] levels The size of each pyramid level (in cells), beginning with the largest one.
+    *
+    * @param[in] numFeatures The number of features per cell.
+    *
+    * @return ARTOS_RES_OK on success or ARTOS_RES_INTERNAL_ERROR if the context could not be initialized.
+    */
+    int initPatchwork(DetectionState & state, const std::vector<Size> & levels, int numFeatures);
+    
+    /**
+    * Computes the scores of all mixtures associated with a given feature extractor, using a single
+    * Patchwork built from the pyramid and convolved with the filters of all those mixtures at once.
+    *
+    * @param[in,out] state The detection state.
+    *
+    * @param[in] pyramid The feature pyramid.
+    *
+    * @param[in] featureExtractorIndex The index of the feature extractor in `featureExtractors`.
+    *
+    * @param[out] classnames Receives the names of the classes whose scores have been computed.
+    *
+    * @param[out] scores Scores of each model (mixture component) of each of those classes for each pyramid level
+    * (`classes x models x levels`). The best model at each position is not selected here, so that detect() can
+    * do so while searching for local maxima (see FindPeaks()).
+    */
+    void convolveMixtures(DetectionState & state, const FeaturePyramid & pyramid, unsigned int featureExtractorIndex,
+                          std::vector<std::string> & classnames,
+                          std::vector< std::vector< std::vector<ScalarMatrix> > > & scores);
+    
+    /**
+    * Computes the scores of the mixtures of given classes, which must be associated with the feature extractor
+    * the pyramid has been computed with.
+    *
+    * @param[in,out] state The detection state.
+    *
+    * @param[in] pyramid The feature pyramid.
+    *
+    * @param[in] classnames The names of the classes whose scores are to be computed.
+    *
+    * @param[out] scores Scores of each model (mixture component) of each of those classes for each pyramid level
+    * (`classes x models x levels`).
+    *
+    * @param[in] patchwork A patchwork built from the pyramid with a padding sufficient for all those mixtures,
+    * which may be shared by multiple calls. If NULL, a patchwork will be built if necessary.
+    */
+    void convolveMixtures(DetectionState & state, const FeaturePyramid & pyramid, const std::vector<std::string> & classnames,
+                          std::vector< std::vector< std::vector<ScalarMatrix> > > & scores, const Patchwork * patchwork = 0);
+    
+    /**
+    * Searches for local maxima of the scores of a mixture and turns them into candidate detections.
+    *
+    * @param[in] state The detection state.
+    *
+    * @param[in] width The width of the image.
+    *
+    * @param[in] height The height of the image.
+    *
+    * @param[in] pyramid The feature pyramid the scores have been computed on.
+    *
+    * @param[in] classname The name of the class.
+    *
+    * @param[in] componentScores Scores of each model of the mixture for each pyramid level (see convolveMixtures()).
+    *
+    * @param[out] candidates Candidate detections will be appended to this vector.
+    *
+    * @param[in] firstLevel Index of the first pyramid level to be searched.
+    */
+    void collectCandidates(const DetectionState & state, int width, int height, const FeaturePyramid & pyramid,
+                           const std::string & classname, const std::vector< std::vector<ScalarMatrix> > & componentScores,
+                           std::vector<Detection> & candidates, int firstLevel = 0) const;
 
     int addModelPointer ( const std::string & classname, Mixture * model, double threshold, const std::string & synsetId = "" );
 
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <utility>
 #include <cstring>
+#include <mutex>
 #include <Eigen/Core>
 #include "strutils.h"
 using namespace ARTOS;
@@ -16,6 +17,7 @@ using namespace std;
 typedef HOGFeatureExtractor DefaultFeatureExtractor;
 
 shared_ptr<FeatureExtractor> FeatureExtractor::dfltFeatureExtractor = nullptr;
+static mutex dfltFeatureExtractorMutex;
 
 static shared_ptr<FeatureExtractor> createHOGFeatureExtractor() { return make_shared<HOGFeatureExtractor>(); };
 
@@ -62,6 +64,14 @@ Size FeatureExtractor::pixelCoordsToCells(const Size & pixels) const
 }
 
 
+void FeatureExtractor::extract(const JPEGImage & img, const vector<Size> & cellSizes, vector<FeatureMatrix> & feats) const
+{
+    feats.resize(cellSizes.size());
+    for (size_t i = 0; i < cellSizes.size(); ++i)
+        this->extract(img, feats[i], cellSizes[i]);
+}
+
+
 int32_t FeatureExtractor::getIntParam(const string & paramName) const
 {
     auto it = this->m_intParams.find(paramName);
@@ -246,6 +256,7 @@ shared_ptr<FeatureExtractor> FeatureExtractor::create(const string & type)
 
 shared_ptr<FeatureExtractor> FeatureExtractor::defaultFeatureExtractor()
 {
+    lock_guard<mutex> lock(dfltFeatureExtractorMutex);
     if (!FeatureExtractor::dfltFeatureExtractor)
         FeatureExtractor::dfltFeatureExtractor = make_shared<DefaultFeatureExtractor>();
     return FeatureExtractor::dfltFeatureExtractor;
@@ -255,7 +266,10 @@ shared_ptr<FeatureExtractor> FeatureExtractor::defaultFeatureExtractor()
 void FeatureExtractor::setDefaultFeatureExtractor(const shared_ptr<FeatureExtractor> & newDefault)
 {
     if (newDefault)
+    {
+        lock_guard<mutex> lock(dfltFeatureExtractorMutex);
         FeatureExtractor::dfltFeatureExtractor = newDefault;
+    }
 }
 
 
@@ -290,11 +304,14 @@ void FeatureExtractor::listFeatureExtractors(vector< shared_ptr<FeatureExtractor
 ostream & ARTOS::operator<<(ostream & os, const FeatureExtractor & featureExtractor)
 {
     for (const auto & param : featureExtractor.m_intParams)
-        os << param.first << ' ' << param.second << ' ';
+        if (featureExtractor.serializesParam(param.first))
+            os << param.first << ' ' << param.second << ' ';
     for (const auto & param : featureExtractor.m_scalarParams)
-        os << param.first << ' ' << param.second << ' ';
+        if (featureExtractor.serializesParam(param.first))
+            os << param.first << ' ' << param.second << ' ';
     for (const auto & param : featureExtractor.m_stringParams)
-        os << param.first << " {str{" << param.second << "}str} ";
+        if (featureExtractor.serializesParam(param.first))
+            os << param.first << " {str{" << param.second << "}str} ";
     os << endl;
     return os;
 }
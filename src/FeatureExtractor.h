@@ -130,6 +130,17 @@ public:
     */
     virtual bool supportsMultiThread() const { return true; };
     
+    /**
+    * Specifies if extract() distributes the computation for a single image among multiple threads itself
+    * when it is not called from within a parallel region. Feature pyramids will extract large levels for
+    * which this is the case one after another instead of in parallel with other levels.
+    *
+    * @param[in] imageSize The size of the image.
+    *
+    * @return Returns true if the features of an image of the given size are extracted using multiple threads.
+    */
+    virtual bool supportsParallelExtraction(const Size & imageSize) const { return false; };
+    
     /**
     * Specifies if it is considered reasonable to process feature extraction of multiple
     * scales of an image by patchworking them together, so that multiple scales are processed at
@@ -155,6 +166,26 @@ public:
     */
     virtual Size patchworkPadding() const { return Size(); };
 
+    /**
+    * Specifies if feature pyramids should extract features only at one scale per octave and approximate
+    * the levels in between by resampling the features of the next larger octave and correcting each channel
+    * with the power law given by scalingExponents(). This reduces the number of calls to extract() for a
+    * pyramid with `interval` levels per octave by a factor of `interval`, at the cost of accuracy.
+    *
+    * @return Returns true if feature pyramids should be approximated.
+    */
+    virtual bool approximatePyramid() const { return false; };
+
+    /**
+    * Feature values extracted from an image downscaled by a factor `s` (0.5 <= `s` <= 1) can be approximated
+    * by resampling the features extracted from the original image and multiplying channel `c` with `s^-lambda_c`.
+    * The exponents `lambda_c` may be estimated from sample images using the `learn_pyramid_scaling` tool.
+    *
+    * @return Returns a vector with the exponent `lambda_c` for each feature channel `c`. If it is empty, features
+    * will be resampled without any correction.
+    */
+    virtual std::vector<FeatureScalar> scalingExponents() const { return std::vector<FeatureScalar>(); };
+
     /**
     * Converts a width and height given in cells to pixels.
     *
@@ -229,6 +260,27 @@ public:
     virtual void extract(const JPEGImage & img, FeatureMatrix & feat, const Size & cellSize) const
     { throw NotSupportedException("This feature extractor does not support variable cell sizes."); };
     
+    /**
+    * Computes features for a given image using several cell sizes.
+    *
+    * Feature pyramids use this for extracting the features of a level of the first octave, which are computed
+    * on the same image as the corresponding level of the second octave, but with half the cell size.
+    * The default implementation calls extract() for each cell size, but feature extractors may override it
+    * in order to compute intermediate results, such as image gradients, only once for all cell sizes.
+    *
+    * @param[in] img The image to compute features for.
+    *
+    * @param[in] cellSizes The sizes of the feature cells.
+    *
+    * @param[out] feats Receives the features extracted using each of the given cell sizes.
+    *
+    * @throws NotSupportedException This feature extractor does not support variable cell sizes.
+    *
+    * @note If the implementation of this function in the derived class is not thread-safe,
+    * you must override supportsMultiThread().
+    */
+    virtual void extract(const JPEGImage & img, const std::vector<Size> & cellSizes, std::vector<FeatureMatrix> & feats) const;
+    
     /**
     * Transforms a feature matrix into a feature representation of the horizontally flipped image.
     *
@@ -439,6 +491,17 @@ protected:
     std::map<std::string, int32_t> m_intParams;
     std::map<std::string, FeatureScalar> m_scalarParams;
     std::map<std::string, std::string> m_stringParams;
+    
+    /**
+    * Specifies if a parameter is to be written when the feature extractor is serialized. Parameters added in later
+    * versions of ARTOS may be omitted as long as they have their default value, so that older versions of ARTOS
+    * can still read models written by this one.
+    *
+    * @param[in] paramName The name of the parameter.
+    *
+    * @return Returns true if the parameter is to be serialized. The default implementation always returns true.
+    */
+    virtual bool serializesParam(const std::string & paramName) const { return true; };
 
     friend std::ostream & operator<<(std::ostream & os, const FeatureExtractor & featureExtractor);
     
@@ -6,12 +6,17 @@
 #include <utility>
 #include <Eigen/Core>
 #include "blf.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 using namespace ARTOS;
 using namespace std;
 
 
-FeaturePyramid::FeaturePyramid(int interval, const vector<FeatureMatrix> & levels, const vector<double> * scales)
-: m_interval(0), m_scales(), m_featureExtractor(FeatureExtractor::defaultFeatureExtractor())
+FeaturePyramid::FeaturePyramid(int interval, const vector<FeatureMatrix> & levels, const vector<double> * scales,
+                               const shared_ptr<FeatureExtractor> & featureExtractor)
+: m_interval(0), m_scales(), m_featureExtractor((featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor())
 {
     if (interval < 1)
         return;
@@ -23,8 +28,9 @@ FeaturePyramid::FeaturePyramid(int interval, const vector<FeatureMatrix> & level
 }
 
 
-FeaturePyramid::FeaturePyramid(int interval, vector<FeatureMatrix> && levels, const vector<double> * scales)
-: m_interval(0), m_scales(), m_featureExtractor(FeatureExtractor::defaultFeatureExtractor())
+FeaturePyramid::FeaturePyramid(int interval, vector<FeatureMatrix> && levels, const vector<double> * scales,
+                               const shared_ptr<FeatureExtractor> & featureExtractor)
+: m_interval(0), m_scales(), m_featureExtractor((featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor())
 {
     if (interval < 1)
         return;
@@ -36,63 +42,122 @@ FeaturePyramid::FeaturePyramid(int interval, vector<FeatureMatrix> && levels, co
 }
 
 
-FeaturePyramid::FeaturePyramid(const JPEGImage & image, const shared_ptr<FeatureExtractor> & featureExtractor, int interval, unsigned int minSize)
+FeaturePyramid::FeaturePyramid(const JPEGImage & image, const shared_ptr<FeatureExtractor> & featureExtractor, int interval, unsigned int minSize,
+                               double minScale, double maxScale)
 : m_interval(0)
 {
     this->m_featureExtractor = (featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor();
     
-    if (image.empty() || (interval < 1))
+    if (image.empty())
+        return;
+    
+    this->m_scales = FeaturePyramid::computeScales(Size(image.width(), image.height()), this->m_featureExtractor, interval, minSize);
+    
+    // Omit levels outside of the requested range of scales (which are contiguous, since scales are decreasing)
+    const double tolerance = 1e-9;
+    this->m_scales.erase(remove_if(this->m_scales.begin(), this->m_scales.end(), [=](double scale)
+    {
+        return (scale < minScale * (1 - tolerance) || (maxScale > 0 && scale > maxScale * (1 + tolerance)));
+    }), this->m_scales.end());
+    if (this->m_scales.empty())
         return;
+    m_interval = interval;
+    
+    if (this->m_featureExtractor->patchworkProcessing())
+        this->buildLevelsPatchworked(image);
+    else if (this->m_featureExtractor->approximatePyramid())
+        this->buildLevelsApproximated(image);
+    else
+        this->buildLevels(image);
+}
+
+vector<double> FeaturePyramid::computeScales(const Size & imageSize, const shared_ptr<FeatureExtractor> & featureExtractor,
+                                             int interval, unsigned int minSize)
+{
+    vector<double> scales;
+    if (imageSize.width <= 0 || imageSize.height <= 0 || interval < 1 || !featureExtractor)
+        return scales;
     
     // Compute the number of scales such that the smallest size of the last level is minSize
-    const Size minPixelSize = this->m_featureExtractor->cellsToPixels(Size(minSize));
+    const Size minPixelSize = featureExtractor->cellsToPixels(Size(minSize));
     const int maxScale = interval * ceil(log(min(
-        image.width() / static_cast<double>(minPixelSize.width),
-        image.height() / static_cast<double>(minPixelSize.height)
+        imageSize.width / static_cast<double>(minPixelSize.width),
+        imageSize.height / static_cast<double>(minPixelSize.height)
     )) / log(2.0));
     
     // Begin with scales smaller than the size of the original image if the feature extractor requires this
-    const Size maxImgSize = this->m_featureExtractor->maxImageSize();
+    const Size maxImgSize = featureExtractor->maxImageSize();
     const int minScale = max(0, static_cast<int>(max(
-        (maxImgSize.width > 0) ? ceil(log(2 * image.width() / static_cast<double>(maxImgSize.width)) / log(2.0) * interval) : 0,
-        (maxImgSize.height > 0) ? ceil(log(2 * image.height() / static_cast<double>(maxImgSize.height)) / log(2.0) * interval) : 0
+        (maxImgSize.width > 0) ? ceil(log(2 * imageSize.width / static_cast<double>(maxImgSize.width)) / log(2.0) * interval) : 0,
+        (maxImgSize.height > 0) ? ceil(log(2 * imageSize.height / static_cast<double>(maxImgSize.height)) / log(2.0) * interval) : 0
     )));
     
     // Cannot compute the pyramid on images too small
     if (maxScale - minScale < interval)
-        return;
+        return scales;
     
     // Compute scales of each level in the pyramid
-    m_interval = interval;
-    m_scales.resize(maxScale - minScale + 1);
-    
-    int i;
-#pragma omp parallel for private(i)
-    for (i = 0; i < interval; ++i)
+    scales.resize(maxScale - minScale + 1);
+    for (int i = 0; i < interval; ++i)
     {
         double scale = pow(2.0, static_cast<double>(-i) / interval);
         
         // First octave at twice the image resolution
         if (i >= minScale)
-            this->m_scales[i - minScale] = scale * 2;
+            scales[i - minScale] = scale * 2;
         
         // Second octave at the original resolution
         if (i + interval >= minScale && i + interval <= maxScale)
-            this->m_scales[i + interval - minScale] = scale;
+            scales[i + interval - minScale] = scale;
         
         // Remaining octaves
         for (int j = 2; i + j * interval <= maxScale; ++j)
         {
             scale *= 0.5;
             if (i + j * interval >= minScale)
-                this->m_scales[i + j * interval - minScale] = scale;
+                scales[i + j * interval - minScale] = scale;
         }
     }
-    
-    if (this->m_featureExtractor->patchworkProcessing())
-        this->buildLevelsPatchworked(image);
-    else
-        this->buildLevels(image);
+    return scales;
+}
+
+
+/**
+* Decides which feature extraction tasks should be processed one after another, so that the feature extractor
+* can distribute each of them among all threads, and which ones should be processed in parallel with each other.
+*
+* Only tasks whose image the feature extractor would distribute among multiple threads itself (see
+* FeatureExtractor::supportsParallelExtraction()) are candidates for sequential processing. Those are processed
+* sequentially if there are fewer tasks than threads or if they would take longer than the others together
+* need per thread. All other tasks are processed in parallel.
+*
+* @param[in] sizes The size of the image of each task.
+*
+* @param[in] featureExtractor The feature extractor.
+*
+* @param[out] sequential Receives the indices of the tasks to be processed one after another.
+*
+* @param[out] parallel Receives the indices of the tasks to be processed in parallel.
+*/
+static void scheduleExtraction(const vector<Size> & sizes, const FeatureExtractor & featureExtractor,
+                               vector<int> & sequential, vector<int> & parallel)
+{
+    sequential.clear();
+    parallel.clear();
+#ifdef _OPENMP
+    const int numThreads = (omp_in_parallel()) ? 1 : omp_get_max_threads();
+#else
+    const int numThreads = 1;
+#endif
+    double totalCost = 0;
+    for (const Size & size : sizes)
+        totalCost += static_cast<double>(size.width) * size.height;
+    for (int i = 0; i < sizes.size(); ++i)
+        if (numThreads > 1 && featureExtractor.supportsParallelExtraction(sizes[i])
+                && (sizes.size() < numThreads || static_cast<double>(sizes[i].width) * sizes[i].height * numThreads > totalCost))
+            sequential.push_back(i);
+        else
+            parallel.push_back(i);
 }
 
 
@@ -103,38 +168,221 @@ void FeaturePyramid::buildLevels(const JPEGImage & image)
     
     this->m_levels.resize(this->m_scales.size());
     
-    int i;
-    bool threadSafe = this->m_featureExtractor->supportsMultiThread();
-    #pragma omp parallel for private(i) if(threadSafe)
+    // A level of the first octave is extracted from the same scaled image as the level one octave below,
+    // but with half the cell size, so that both can be extracted at once.
+    int i, j;
+    const bool halfCellSize = (this->m_featureExtractor->cellSize().min() > 1 && this->m_featureExtractor->supportsVariableCellSize());
+    vector<int> partners(this->m_scales.size(), -1);
+    if (halfCellSize)
+        for (i = 0; i < this->m_scales.size() && this->m_scales[i] > 1.0; ++i)
+            for (j = i + 1; j < this->m_scales.size(); ++j)
+                if (this->m_scales[j] * 2 == this->m_scales[i])
+                {
+                    partners[i] = j;
+                    partners[j] = i;
+                    break;
+                }
+    
+    // Levels extracted together with their partner are a single task on the same scaled image
+    vector<int> tasks, sequential, parallel;
+    vector<Size> sizes;
     for (i = 0; i < this->m_scales.size(); ++i)
+        if (partners[i] < 0 || partners[i] > i)
+        {
+            const double scale = (partners[i] >= 0) ? this->m_scales[partners[i]]
+                                 : ((this->m_scales[i] > 1.0 && halfCellSize) ? this->m_scales[i] / 2 : this->m_scales[i]);
+            tasks.push_back(i);
+            sizes.push_back(Size(image.width() * scale + 0.5, image.height() * scale + 0.5));
+        }
+    scheduleExtraction(sizes, *(this->m_featureExtractor), sequential, parallel);
+    
+    const ImagePyramid images(image);
+    auto extractTask = [&](int i)
     {
-        double scale = this->m_scales[i];
-        
-        if (scale == 1.0)
-            this->m_featureExtractor->extract(image, m_levels[i]);
-        else if (scale > 1.0 && this->m_featureExtractor->cellSize().min() > 1 && this->m_featureExtractor->supportsVariableCellSize())
+        if (partners[i] < 0)
+            this->extractScale(images, this->m_scales[i], this->m_levels[i]);
+        else if (partners[i] > i)
         {
-            // First octave at twice the image resolution
+            const double scale = this->m_scales[partners[i]];
+            const JPEGImage scaled = (scale != 1.0) ? images.resize(image.width() * scale + 0.5, image.height() * scale + 0.5) : image;
+            vector<FeatureMatrix> feats;
             try
             {
-                this->m_featureExtractor->extract(
-                    image.resize(image.width() * scale / 2 + 0.5, image.height() * scale / 2 + 0.5),
-                    m_levels[i],
-                    this->m_featureExtractor->cellSize() / 2
-                );
+                this->m_featureExtractor->extract(scaled, { this->m_featureExtractor->cellSize() / 2, this->m_featureExtractor->cellSize() }, feats);
+                this->m_levels[i] = move(feats[0]);
+                this->m_levels[partners[i]] = move(feats[1]);
             }
             catch (NotSupportedException & e)
             {
                 // This should not happen if the feature extractor behaves consistently.
-                this->m_featureExtractor->extract(image.resize(image.width() * scale + 0.5, image.height() * scale + 0.5), m_levels[i]);
+                this->extractScale(images, this->m_scales[i], this->m_levels[i]);
+                this->extractScale(images, scale, this->m_levels[partners[i]]);
             }
         }
+    };
+    for (int t : sequential)
+        extractTask(tasks[t]);
+    bool threadSafe = this->m_featureExtractor->supportsMultiThread();
+    #pragma omp parallel for private(i) if(threadSafe)
+    for (i = 0; i < parallel.size(); ++i)
+        extractTask(tasks[parallel[i]]);
+}
+
+
+void FeaturePyramid::buildLevelsApproximated(const JPEGImage & image)
+{
+    if (image.empty() || this->m_scales.empty())
+        return;
+    
+    // Approximate each level from the features at the next larger power of two, unless that would
+    // exceed the limits of the feature extractor.
+    int i;
+    const Size maxImgSize = this->m_featureExtractor->maxImageSize();
+    vector<double> octaveScales;
+    vector<int> octaveIndices(this->m_scales.size(), -1);
+    for (i = 0; i < this->m_scales.size(); ++i)
+    {
+        const double octaveScale = pow(2.0, ceil(log(this->m_scales[i]) / log(2.0) - 1e-9));
+        if (octaveScale > 2.0
+                || (maxImgSize.width > 0 && image.width() * octaveScale + 0.5 > maxImgSize.width)
+                || (maxImgSize.height > 0 && image.height() * octaveScale + 0.5 > maxImgSize.height))
+            continue;
+        vector<double>::const_iterator octave = find(octaveScales.begin(), octaveScales.end(), octaveScale);
+        octaveIndices[i] = octave - octaveScales.begin();
+        if (octave == octaveScales.end())
+            octaveScales.push_back(octaveScale);
+    }
+    
+    // Extract features at the scale of each octave
+    const ImagePyramid images(image);
+    bool threadSafe = this->m_featureExtractor->supportsMultiThread();
+    vector<FeatureMatrix> octaves(octaveScales.size());
+    const bool halfCellSize = (this->m_featureExtractor->cellSize().min() > 1 && this->m_featureExtractor->supportsVariableCellSize());
+    vector<Size> sizes;
+    vector<int> sequential, parallel;
+    for (double octaveScale : octaveScales)
+    {
+        const double scale = (octaveScale > 1.0 && halfCellSize) ? octaveScale / 2 : octaveScale;
+        sizes.push_back(Size(image.width() * scale + 0.5, image.height() * scale + 0.5));
+    }
+    scheduleExtraction(sizes, *(this->m_featureExtractor), sequential, parallel);
+    for (int o : sequential)
+        this->extractScale(images, octaveScales[o], octaves[o]);
+    #pragma omp parallel for private(i) if(threadSafe)
+    for (i = 0; i < parallel.size(); ++i)
+        this->extractScale(images, octaveScales[parallel[i]], octaves[parallel[i]]);
+    
+    // Approximate the levels in between with the same size extractScale() would produce
+    const vector<FeatureScalar> exponents = this->m_featureExtractor->scalingExponents();
+    this->m_levels.resize(this->m_scales.size());
+    #pragma omp parallel for private(i) if(threadSafe)
+    for (i = 0; i < this->m_scales.size(); ++i)
+    {
+        const double scale = this->m_scales[i];
+        if (octaveIndices[i] < 0)
+            this->extractScale(images, scale, this->m_levels[i]);
+        else if (scale == octaveScales[octaveIndices[i]])
+            this->m_levels[i] = octaves[octaveIndices[i]];
         else
-            this->m_featureExtractor->extract(image.resize(image.width() * scale + 0.5, image.height() * scale + 0.5), m_levels[i]);
+        {
+            const Size scaledSize = (scale > 1.0 && halfCellSize)
+                                    ? Size(image.width() * scale / 2 + 0.5, image.height() * scale / 2 + 0.5) * 2
+                                    : Size(image.width() * scale + 0.5, image.height() * scale + 0.5);
+            FeaturePyramid::approximateScale(
+                octaves[octaveIndices[i]], scale / octaveScales[octaveIndices[i]],
+                this->m_featureExtractor->pixelsToCells(scaledSize), exponents, this->m_levels[i]
+            );
+        }
+    }
+}
+
+
+void FeaturePyramid::extractScale(const ImagePyramid & images, double scale, FeatureMatrix & feat) const
+{
+    const JPEGImage & image = images.image();
+    if (scale == 1.0)
+        this->m_featureExtractor->extract(image, feat);
+    else if (scale > 1.0 && this->m_featureExtractor->cellSize().min() > 1 && this->m_featureExtractor->supportsVariableCellSize())
+    {
+        // First octave at twice the image resolution
+        try
+        {
+            this->m_featureExtractor->extract(
+                images.resize(image.width() * scale / 2 + 0.5, image.height() * scale / 2 + 0.5),
+                feat,
+                this->m_featureExtractor->cellSize() / 2
+            );
+        }
+        catch (NotSupportedException & e)
+        {
+            // This should not happen if the feature extractor behaves consistently.
+            this->m_featureExtractor->extract(images.resize(image.width() * scale + 0.5, image.height() * scale + 0.5), feat);
+        }
+    }
+    else
+        this->m_featureExtractor->extract(images.resize(image.width() * scale + 0.5, image.height() * scale + 0.5), feat);
+}
+
+
+/**
+* Computes the weights of the cells of a feature matrix averaged for each cell of a downscaled version of it.
+*
+* @param[in] srcSize The number of cells along the dimension of the original feature matrix.
+*
+* @param[in] dstSize The number of cells along the dimension of the downscaled feature matrix.
+*
+* @param[in] scale The factor the original feature matrix is downscaled by.
+*
+* @param[out] taps Receives a vector for each cell of the downscaled feature matrix with pairs of indices
+* of cells of the original matrix and their weights, which sum up to 1.
+*/
+static void computeResamplingTaps(int srcSize, int dstSize, double scale, vector< vector< pair<int, FeatureScalar> > > & taps)
+{
+    taps.assign(dstSize, vector< pair<int, FeatureScalar> >());
+    for (int i = 0; i < dstSize; ++i)
+    {
+        // The cell covers the interval [start, end) of cells of the original matrix
+        const double start = i / scale, end = (i + 1) / scale;
+        for (int j = static_cast<int>(start); j < end; ++j)
+        {
+            const double overlap = min(end, j + 1.0) - max(start, static_cast<double>(j));
+            if (overlap > 1e-6)
+                taps[i].push_back(make_pair(max(0, min(j, srcSize - 1)), static_cast<FeatureScalar>(overlap * scale)));
+        }
     }
 }
 
 
+void FeaturePyramid::approximateScale(const FeatureMatrix & feat, double scale, const Size & size,
+                                      const vector<FeatureScalar> & exponents, FeatureMatrix & approx)
+{
+    approx.resize(max(0, size.height), max(0, size.width), feat.channels());
+    approx.setZero();
+    if (feat.empty() || approx.empty() || scale <= 0)
+        return;
+    
+    vector< vector< pair<int, FeatureScalar> > > xTaps, yTaps;
+    computeResamplingTaps(feat.cols(), approx.cols(), scale, xTaps);
+    computeResamplingTaps(feat.rows(), approx.rows(), scale, yTaps);
+    
+    // Resample horizontally, then vertically
+    FeatureMatrix tmp(feat.rows(), approx.cols(), feat.channels(), static_cast<FeatureScalar>(0));
+    for (FeatureMatrix::Index y = 0; y < tmp.rows(); ++y)
+        for (FeatureMatrix::Index x = 0; x < tmp.cols(); ++x)
+            for (const pair<int, FeatureScalar> & tap : xTaps[x])
+                tmp(y, x) += feat(y, tap.first) * tap.second;
+    for (FeatureMatrix::Index y = 0; y < approx.rows(); ++y)
+        for (const pair<int, FeatureScalar> & tap : yTaps[y])
+            approx.data().row(y) += tmp.data().row(tap.first) * tap.second;
+    
+    // Correct the magnitude of each channel according to the power law
+    FeatureCell correction = FeatureCell::Ones(feat.channels());
+    for (size_t c = 0; c < exponents.size() && c < feat.channels(); ++c)
+        correction(c) = static_cast<FeatureScalar>(pow(scale, -exponents[c]));
+    approx *= correction;
+}
+
+
 void FeaturePyramid::buildLevelsPatchworked(const JPEGImage & image)
 {
     if (image.empty() || this->m_scales.empty())
@@ -175,9 +423,9 @@ void FeaturePyramid::buildLevelsPatchworked(const JPEGImage & image)
         rectangles.push_back(PatchworkRectangle(scaledSize.width, scaledSize.height));
     }
     
-    int numPlanes = BLF(rectangles, maxSize.width, maxSize.height);
+    int numPlanes = PackRectangles(rectangles, maxSize.width, maxSize.height);
     if (numPlanes <= 0)
-        throw runtime_error("Could not construct feature pyramid: Bottom-left fill algorithm failed.");
+        throw runtime_error("Could not construct feature pyramid: Packing the levels into planes failed.");
     
     // Fill patchwork planes
     vector<JPEGImage> planes;
@@ -188,6 +436,7 @@ void FeaturePyramid::buildLevelsPatchworked(const JPEGImage & image)
         planes.back().toMatrix().setZero();
     }
     
+    const ImagePyramid images(image);
     #pragma omp parallel for private(i)
     for (i = 0; i < rectangles.size(); i++)
     {
@@ -195,16 +444,20 @@ void FeaturePyramid::buildLevelsPatchworked(const JPEGImage & image)
         assert(rect.plane() >= 0 && rect.plane() < planes.size());
         assert(rect.x() % this->m_featureExtractor->cellSize().width == 0 && rect.y() % this->m_featureExtractor->cellSize().height == 0);
         double scale = this->m_scales[i];
-        JPEGImage scaled = (scale != 1.0) ? image.resize(image.width() * scale + 0.5, image.height() * scale + 0.5) : image;
+        JPEGImage scaled = (scale != 1.0) ? images.resize(image.width() * scale + 0.5, image.height() * scale + 0.5) : image;
         planes[rect.plane()].toMatrix().data().block(rect.y(), rect.x() * scaled.depth(), scaled.height(), scaled.width() * scaled.depth()) = scaled.toMatrix().data();
     }
     
     // Run feature extractor over planes
     bool threadSafe = this->m_featureExtractor->supportsMultiThread();
     vector<FeatureMatrix> features(numPlanes);
+    vector<int> sequential, parallel;
+    scheduleExtraction(vector<Size>(numPlanes, maxSize), *(this->m_featureExtractor), sequential, parallel);
+    for (int p : sequential)
+        this->m_featureExtractor->extract(planes[p], features[p]);
     #pragma omp parallel for private(i) if(threadSafe)
-    for (i = 0; i < numPlanes; i++)
-        this->m_featureExtractor->extract(planes[i], features[i]);
+    for (i = 0; i < parallel.size(); i++)
+        this->m_featureExtractor->extract(planes[parallel[i]], features[parallel[i]]);
     planes.clear();
     
     // Extract levels from planes
@@ -2,6 +2,7 @@
 #define ARTOS_FEATUREPYRAMID_H
 
 #include "FeatureExtractor.h"
+#include "ImagePyramid.h"
 
 namespace ARTOS
 {
@@ -13,6 +14,10 @@ namespace ARTOS
 * 2^(1 - @c i / @c interval), so that the first scale is at double the resolution of the original image.
 * Some scales may be omitted due to restrictions of the feature extractor.
 *
+* If the feature extractor requests approximated pyramids (see FeatureExtractor::approximatePyramid()), features
+* are only extracted at the scales which are powers of two and the levels in between are approximated from the
+* next larger one of those (see approximateScale()).
+*
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
 */
 class FeaturePyramid
@@ -31,8 +36,11 @@ public:
     * @param[in] levels List of pyramid levels (at least 1).
     * @param[in] scales The scales belonging to the levels. If not given, this pyramid
     * will contain no information about scales.
+    * @param[in] featureExtractor The feature extractor the levels have been computed with.
+    * If not given, the default feature extractor is assumed.
     */
-    FeaturePyramid(int interval, const std::vector<FeatureMatrix> & levels, const std::vector<double> * scales = NULL);
+    FeaturePyramid(int interval, const std::vector<FeatureMatrix> & levels, const std::vector<double> * scales = NULL,
+                   const std::shared_ptr<FeatureExtractor> & featureExtractor = nullptr);
     
     /**
     * Constructs a pyramid from parameters and a list of levels.
@@ -40,8 +48,11 @@ public:
     * @param[in] levels List of pyramid levels (at least 1) to be moved.
     * @param[in] scales The scales belonging to the levels. If not given, this pyramid
     * will contain no information about scales.
+    * @param[in] featureExtractor The feature extractor the levels have been computed with.
+    * If not given, the default feature extractor is assumed.
     */
-    FeaturePyramid(int interval, std::vector<FeatureMatrix> && levels, const std::vector<double> * scales = NULL);
+    FeaturePyramid(int interval, std::vector<FeatureMatrix> && levels, const std::vector<double> * scales = NULL,
+                   const std::shared_ptr<FeatureExtractor> & featureExtractor = nullptr);
     
     /**
     * Constructs a pyramid from a JPEGImage.
@@ -49,8 +60,13 @@ public:
     * @param[in] featureExtractor The feature extractor to be used by this pyramid.
     * @param[in] interval Number of levels per octave in the pyramid (at least 1).
     * @param[in] minSize Minimum number of cells in x or y direction in the smallest scale in the pyramid.
+    * @param[in] minScale Levels with a scale less than this will be omitted, so that features are not computed for them.
+    * @param[in] maxScale Levels with a scale greater than this will be omitted. 0 means no limit.
+    * @note The scales of the levels are not affected by `minScale` and `maxScale`, only the first or last levels may be missing.
+    * If all levels are omitted, the pyramid will be empty.
     */
-    FeaturePyramid(const JPEGImage & image, const std::shared_ptr<FeatureExtractor> & featureExtractor = nullptr, int interval = 10, unsigned int minSize = 5);
+    FeaturePyramid(const JPEGImage & image, const std::shared_ptr<FeatureExtractor> & featureExtractor = nullptr, int interval = 10, unsigned int minSize = 5,
+                   double minScale = 0.0, double maxScale = 0.0);
     
     /**
     * @return True if the pyramid is empty. An empty pyramid has no level.
@@ -92,6 +108,31 @@ public:
     */
     std::shared_ptr<const FeatureExtractor> featureExtractor() const { return this->m_featureExtractor; };
 
+    /**
+    * Computes the scales of the levels of a pyramid constructed from an image of given size.
+    * @param[in] imageSize The size of the image.
+    * @param[in] featureExtractor The feature extractor to be used by the pyramid.
+    * @param[in] interval Number of levels per octave in the pyramid (at least 1).
+    * @param[in] minSize Minimum number of cells in x or y direction in the smallest scale in the pyramid.
+    * @return The scales of the levels in decreasing order. Empty if the image is too small for a pyramid.
+    */
+    static std::vector<double> computeScales(const Size & imageSize, const std::shared_ptr<FeatureExtractor> & featureExtractor,
+                                             int interval = 10, unsigned int minSize = 5);
+
+    /**
+    * Approximates the features of a downscaled image given the features of the original image.
+    * The features are resampled by averaging the cells covered by each cell of the downscaled image and
+    * each channel `c` is multiplied with `scale^-exponents[c]` (see FeatureExtractor::scalingExponents()).
+    * @param[in] feat The features extracted from the original image.
+    * @param[in] scale The factor the image has been downscaled by (0 < `scale` <= 1).
+    * @param[in] size The number of cells of the approximated features in x and y direction.
+    * @param[in] exponents The exponent of the power law for each channel of `feat`. Channels without an exponent
+    * will not be corrected.
+    * @param[out] approx Destination matrix for the approximated features. It will be resized to `size`.
+    */
+    static void approximateScale(const FeatureMatrix & feat, double scale, const Size & size,
+                                 const std::vector<FeatureScalar> & exponents, FeatureMatrix & approx);
+
     /**
     * Replaces the contents of this feature pyramid with data read from a binary file.
     * @param[in] filename Path of the file to deserialize the feature pyramid from.
@@ -125,6 +166,21 @@ protected:
     */
     void buildLevels(const JPEGImage & img);
     
+    /**
+    * Constructs `m_levels` according to `m_scales` by extracting features only at scales which are powers of two
+    * using `m_featureExtractor` and approximating the other levels with approximateScale().
+    * @param[in] img The image to extract features from.
+    */
+    void buildLevelsApproximated(const JPEGImage & img);
+    
+    /**
+    * Extracts features from a scaled version of an image using `m_featureExtractor`.
+    * @param[in] images The octaves of the original image.
+    * @param[in] scale The scale of the image to extract features from.
+    * @param[out] feat Destination matrix for the features.
+    */
+    void extractScale(const ImagePyramid & images, double scale, FeatureMatrix & feat) const;
+    
     /**
     * Constructs `m_levels` according to `m_scales` by placing multiple scales of the image
     * together on a plane of fixed size in order to reduce the number of calls to `m_featureExtractor->extract()`.
@@ -1,8 +1,23 @@
 #include "HOGFeatureExtractor.h"
 #include <limits>
 #include <cstdint>
+#include <cstdlib>
 #include <cmath>
 #include <cassert>
+#include <mutex>
+#include <stdexcept>
+#include "strutils.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(ARTOS_PATCHWORK_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ARTOS_X86_KERNELS
+#include <immintrin.h>
+#include "PatchworkKernels.h"
+#endif
+
 using namespace ARTOS;
 using namespace std;
 
@@ -10,15 +25,21 @@ using namespace std;
 #define M_PI 3.14159265358979323846
 #endif
 
+/** Minimum number of pixels per band of rows processed in parallel. */
+static const int MIN_BAND_PIXELS = 65536;
+
 
 HOGFeatureExtractor::HOGFeatureExtractor() : HOGFeatureExtractor(Size(8)) {};
 
 
 HOGFeatureExtractor::HOGFeatureExtractor(const Size & cellSize)
-: m_cellSize((cellSize.width > 0 && cellSize.height > 0 && cellSize.width % 2 == 0 && cellSize.height % 2 == 0) ? cellSize : Size(8))
+: m_cellSize((cellSize.width > 0 && cellSize.height > 0 && cellSize.width % 2 == 0 && cellSize.height % 2 == 0) ? cellSize : Size(8)),
+  m_approxPyramid(false)
 {
     this->m_intParams["cellSizeX"] = this->m_cellSize.width;
     this->m_intParams["cellSizeY"] = this->m_cellSize.height;
+    this->m_intParams["approxPyramid"] = 0;
+    this->m_stringParams["scalingExponents"] = "";
 };
 
 
@@ -52,6 +73,16 @@ bool HOGFeatureExtractor::supportsVariableCellSize() const
 }
 
 
+bool HOGFeatureExtractor::supportsParallelExtraction(const Size & imageSize) const
+{
+#ifdef _OPENMP
+    return (imageSize.width * imageSize.height >= 2 * MIN_BAND_PIXELS);
+#else
+    return false;
+#endif
+}
+
+
 Size HOGFeatureExtractor::pixelsToCells(const Size & pixels) const
 {
     return (pixels - this->borderSize() * 2 + this->cellSize() / 2) / this->cellSize();
@@ -66,6 +97,21 @@ void HOGFeatureExtractor::extract(const JPEGImage & img, FeatureMatrix & feat, c
 }
 
 
+void HOGFeatureExtractor::extract(const JPEGImage & img, const vector<Size> & cellSizes, vector<FeatureMatrix> & feats) const
+{
+    Gradients gradients;
+    HOGFeatureExtractor::computeGradients(img, gradients);
+    feats.resize(cellSizes.size());
+    for (size_t i = 0; i < cellSizes.size(); ++i)
+    {
+        const Size & cellSize = cellSizes[i];
+        HOGFeatureExtractor::HOG(gradients, feats[i], Size(1, 1), (cellSize.width > 0 && cellSize.height > 0) ? cellSize : this->cellSize());
+        if (feats[i].rows() > 2 && feats[i].cols() > 2)
+            feats[i].crop(1, 1, feats[i].rows() - 2, feats[i].cols() - 2); // cut off padding
+    }
+}
+
+
 void HOGFeatureExtractor::flip(const FeatureMatrix & feat, FeatureMatrix & flipped) const
 {
     // Symmetric features
@@ -99,6 +145,47 @@ void HOGFeatureExtractor::setParam(const std::string & paramName, int32_t val)
             throw invalid_argument("cellSizeY must be a positive multiple of 2.");
         this->m_cellSize.height = val;
     }
+    else if (paramName == "approxPyramid")
+    {
+        if (val != 0 && val != 1)
+            throw invalid_argument("approxPyramid must be either 0 or 1.");
+        this->m_approxPyramid = (val != 0);
+    }
+    FeatureExtractor::setParam(paramName, val);
+}
+
+
+bool HOGFeatureExtractor::serializesParam(const std::string & paramName) const
+{
+    if (paramName == "approxPyramid")
+        return this->m_approxPyramid;
+    if (paramName == "scalingExponents")
+        return !this->m_scalingExponents.empty();
+    return true;
+}
+
+
+void HOGFeatureExtractor::setParam(const std::string & paramName, const std::string & val)
+{
+    if (paramName == "scalingExponents")
+    {
+        vector<string> tokens;
+        vector<FeatureScalar> exponents;
+        splitString(val, ",", tokens);
+        for (const string & token : tokens)
+        {
+            string t = trim(token);
+            if (t.empty())
+                continue;
+            char * trailing;
+            exponents.push_back(static_cast<FeatureScalar>(strtod(t.c_str(), &trailing)));
+            if (trailing != NULL && *trailing != '\0')
+                throw invalid_argument("scalingExponents must be a comma-separated list of numbers.");
+        }
+        if (!exponents.empty() && exponents.size() != static_cast<size_t>(this->numFeatures()))
+            throw invalid_argument("scalingExponents must specify one exponent for each of the 32 feature channels.");
+        this->m_scalingExponents = exponents;
+    }
     FeatureExtractor::setParam(paramName, val);
 }
 
@@ -155,42 +242,13 @@ Size HOGFeatureExtractor::computeOptimalModelSize(const vector<Size> & sizes, co
 }
 
 
-// Bilinear interpolation among the 4 neighboring cells
-static inline void interpolate(int x, int y, int bin0, int bin1, FeatureScalar magnitude0, FeatureScalar magnitude1,
-                               const Size & cellSize, FeatureMatrix & matrix)
-{
-    // Find the bin into which (x, y) falls
-    const Size csh = cellSize / 2;
-    const int i = (y - csh.height) / cellSize.height;
-    const int j = (x - csh.width) / cellSize.width;
-    const int k = (y - csh.height) % cellSize.height;
-    const int l = (x - csh.width) % cellSize.width;
-
-    // Bilinear interpolation
-    const int a = k * 2 + 1;
-    const int b = cellSize.height * 2 - a;
-    const int c = l * 2 + 1;
-    const int d = cellSize.width * 2 - c;
-
-    matrix(i    , j    , bin0) += magnitude0 * (b * d);
-    matrix(i    , j    , bin1) += magnitude1 * (b * d);
-    matrix(i    , j + 1, bin0) += magnitude0 * (b * c);
-    matrix(i    , j + 1, bin1) += magnitude1 * (b * c);
-    matrix(i + 1, j    , bin0) += magnitude0 * (a * d);
-    matrix(i + 1, j    , bin1) += magnitude1 * (a * d);
-    matrix(i + 1, j + 1, bin0) += magnitude0 * (a * c);
-    matrix(i + 1, j + 1, bin1) += magnitude1 * (a * c);
-}
-
+// Table of all the possible tangents (1MB)
+static FeatureScalar ATAN2_TABLE[512][512] = {{0}};
+static once_flag atan2TableFilled;
 
-void HOGFeatureExtractor::HOG(const JPEGImage & image, FeatureMatrix & feat, const Size & padding, const Size & cellSize)
+static void fillAtan2Table()
 {
-    // Table of all the possible tangents (1MB)
-    static FeatureScalar ATAN2_TABLE[512][512] = {{0}};
-    
-    // Fill the atan2 table
-#pragma omp critical
-    if (ATAN2_TABLE[0][0] == 0) {
+    call_once(atan2TableFilled, []() {
         for (int dy = -255; dy <= 255; ++dy) {
             for (int dx = -255; dx <= 255; ++dx) {
                 // Angle in the range [-pi, pi]
@@ -206,22 +264,230 @@ void HOGFeatureExtractor::HOG(const JPEGImage & image, FeatureMatrix & feat, con
                 ATAN2_TABLE[dy + 255][dx + 255] = max(angle, 0.0);
             }
         }
+    });
+}
+
+
+/**
+* Computes the gradient of a single pixel of an image using the channel with the largest gradient magnitude.
+*/
+static inline void pixelGradient(const uint8_t * linem, const uint8_t * line, const uint8_t * linep, int x, int width, int depth,
+                                 FeatureScalar & magnitude, FeatureScalar & theta)
+{
+    const int xp = min(x + 1, width - 1);
+    const int xm = max(x - 1, 0);
+    
+    magnitude = 0;
+    theta = 0;
+    
+    for (int i = 0; i < depth; ++i)
+    {
+        const int dx = static_cast<int>(line[xp * depth + i]) -
+                       static_cast<int>(line[xm * depth + i]);
+        const int dy = static_cast<int>(linep[x * depth + i]) -
+                       static_cast<int>(linem[x * depth + i]);
+        
+        if (dx * dx + dy * dy > magnitude)
+        {
+            magnitude = dx * dx + dy * dy;
+            theta = ATAN2_TABLE[dy + 255][dx + 255];
+        }
     }
     
-    while (ATAN2_TABLE[510][510] == 0);
+    magnitude = sqrt(magnitude);
+}
+
+
+#ifdef ARTOS_X86_KERNELS
+
+/**
+* Computes the gradients of the pixels 1 to `width - 2` of a row of an image in blocks of 8 pixels,
+* given the rows above, at and below that row separately for each channel.
+*
+* Instead of the table lookup, the orientation is computed using a polynomial approximation of the arctangent.
+*
+* @return Returns the index of the first pixel which has not been processed.
+*/
+__attribute__((target("avx2")))
+static int gradientRowAVX2(const uint8_t * const * linem, const uint8_t * const * line, const uint8_t * const * linep,
+                           int width, int depth, FeatureScalar * magnitudes, FeatureScalar * orientations)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 tanPi8 = _mm256_set1_ps(0.4142135623730950f);
+    const __m256 pi4 = _mm256_set1_ps(0.7853981633974483f), pi2 = _mm256_set1_ps(1.5707963267948966f);
+    const __m256 pi = _mm256_set1_ps(3.1415926535897932f);
+    const __m256 toBins = _mm256_set1_ps(9.0f / 3.1415926535897932f);
+    const __m256 numBins = _mm256_set1_ps(18.0f);
+    const __m256i zero = _mm256_setzero_si256();
+    
+    int x = 1;
+    for (; x + 8 <= width - 1; x += 8)
+    {
+        // Select the channel with the largest gradient magnitude
+        __m256i bestMagnitude = zero, bestDx = zero, bestDy = zero;
+        for (int i = 0; i < depth; ++i)
+        {
+            const __m256i dx = _mm256_sub_epi32(
+                    _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(line[i] + x + 1))),
+                    _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(line[i] + x - 1))));
+            const __m256i dy = _mm256_sub_epi32(
+                    _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(linep[i] + x))),
+                    _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(linem[i] + x))));
+            const __m256i magnitude = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+            const __m256i greater = _mm256_cmpgt_epi32(magnitude, bestMagnitude);
+            bestMagnitude = _mm256_blendv_epi8(bestMagnitude, magnitude, greater);
+            bestDx = _mm256_blendv_epi8(bestDx, dx, greater);
+            bestDy = _mm256_blendv_epi8(bestDy, dy, greater);
+        }
+        _mm256_storeu_ps(magnitudes + x, _mm256_sqrt_ps(_mm256_cvtepi32_ps(bestMagnitude)));
+        
+        // atan2(dy, dx) with reduction to the range [0, tan(pi/8)]
+        const __m256 fdx = _mm256_cvtepi32_ps(bestDx), fdy = _mm256_cvtepi32_ps(bestDy);
+        const __m256 adx = _mm256_andnot_ps(signMask, fdx), ady = _mm256_andnot_ps(signMask, fdy);
+        __m256 t = _mm256_div_ps(_mm256_min_ps(adx, ady), _mm256_max_ps(_mm256_max_ps(adx, ady), one));
+        const __m256 reduce = _mm256_cmp_ps(t, tanPi8, _CMP_GT_OQ);
+        t = _mm256_blendv_ps(t, _mm256_div_ps(_mm256_sub_ps(t, one), _mm256_add_ps(t, one)), reduce);
+        const __m256 z = _mm256_mul_ps(t, t);
+        __m256 poly = _mm256_set1_ps(8.05374449538e-2f);
+        poly = _mm256_sub_ps(_mm256_mul_ps(poly, z), _mm256_set1_ps(1.38776856032e-1f));
+        poly = _mm256_add_ps(_mm256_mul_ps(poly, z), _mm256_set1_ps(1.99777106478e-1f));
+        poly = _mm256_sub_ps(_mm256_mul_ps(poly, z), _mm256_set1_ps(3.33329491539e-1f));
+        __m256 angle = _mm256_add_ps(_mm256_and_ps(reduce, pi4), _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(poly, z), t), t));
+        angle = _mm256_blendv_ps(angle, _mm256_sub_ps(pi2, angle), _mm256_cmp_ps(ady, adx, _CMP_GT_OQ));
+        angle = _mm256_blendv_ps(angle, _mm256_sub_ps(pi, angle), _mm256_castsi256_ps(_mm256_cmpgt_epi32(zero, bestDx)));
+        angle = _mm256_xor_ps(angle, _mm256_and_ps(signMask, _mm256_castsi256_ps(_mm256_cmpgt_epi32(zero, bestDy))));
+        
+        // Convert it to the range [0, 18)
+        __m256 theta = _mm256_add_ps(_mm256_mul_ps(angle, toBins), numBins);
+        theta = _mm256_blendv_ps(theta, _mm256_sub_ps(theta, numBins), _mm256_cmp_ps(theta, numBins, _CMP_GE_OQ));
+        _mm256_storeu_ps(orientations + x, _mm256_max_ps(theta, _mm256_setzero_ps()));
+    }
+    return x;
+}
+
+#endif
+
+
+/**
+* Determines into how many bands of rows an image should be split for processing them in parallel.
+*
+* @param[in] numPixels The number of pixels of the image.
+*
+* @param[in] numRows The maximum number of bands.
+*
+* @return Returns 1 if called from within a parallel region or if the image is too small for
+* parallel processing to pay off.
+*/
+static int numBands(int numPixels, int numRows)
+{
+#ifdef _OPENMP
+    if (omp_in_parallel())
+        return 1;
+    return max(1, min(min(omp_get_max_threads(), numPixels / MIN_BAND_PIXELS), numRows));
+#else
+    return 1;
+#endif
+}
+
+
+void HOGFeatureExtractor::HOG(const JPEGImage & image, FeatureMatrix & feat, const Size & padding, const Size & cellSize)
+{
+    Gradients gradients;
+    HOGFeatureExtractor::computeGradients(image, gradients);
+    HOGFeatureExtractor::HOG(gradients, feat, padding, cellSize);
+}
+
+
+void HOGFeatureExtractor::computeGradients(const JPEGImage & image, Gradients & gradients)
+{
+    fillAtan2Table();
     
     // Some shortcuts
     const int width = image.width();
     const int height = image.height();
     const int depth = image.depth();
+    assert(depth >= 1);
+    
+    gradients.width = width;
+    gradients.height = height;
+    gradients.magnitude.resize(width * height);
+    gradients.orientation.resize(width * height);
+    
+    // The rows are independent from each other, so they can be split into bands arbitrarily
+    const int bands = numBands(width * height, height);
+    
+#ifdef ARTOS_X86_KERNELS
+    // Store the channels of the image separately, so that consecutive pixels can be loaded at once
+    static const bool avx2 = (detectSIMDLevel() != SIMDLevel::NONE);
+    vector<uint8_t> planes;
+    if (avx2 && depth > 1)
+    {
+        planes.resize(width * height * depth);
+        const uint8_t * bits = image.bits();
+        int b;
+        #pragma omp parallel for private(b) if(bands > 1)
+        for (b = 0; b < bands; ++b)
+            for (int i = 0; i < depth; ++i)
+                for (int j = width * height * b / bands; j < width * height * (b + 1) / bands; ++j)
+                    planes[i * width * height + j] = bits[j * depth + i];
+    }
+#endif
+    
+    int b;
+    #pragma omp parallel for private(b) if(bands > 1)
+    for (b = 0; b < bands; ++b)
+    {
+#ifdef ARTOS_X86_KERNELS
+        vector<const uint8_t *> channelsM(depth), channels(depth), channelsP(depth);
+#endif
+        for (int y = height * b / bands; y < height * (b + 1) / bands; ++y)
+        {
+            const int yp = min(y + 1, height - 1);
+            const int ym = max(y - 1, 0);
+            
+            const uint8_t * linep = reinterpret_cast<const uint8_t *>(image.scanLine(yp));
+            const uint8_t * line = reinterpret_cast<const uint8_t *>(image.scanLine(y));
+            const uint8_t * linem = reinterpret_cast<const uint8_t *>(image.scanLine(ym));
+            
+            FeatureScalar * magnitudes = &gradients.magnitude[y * width];
+            FeatureScalar * orientations = &gradients.orientation[y * width];
+            
+            int x = 0;
+#ifdef ARTOS_X86_KERNELS
+            if (avx2 && width > 2)
+            {
+                for (int i = 0; i < depth; ++i)
+                {
+                    const uint8_t * plane = (depth > 1) ? &planes[i * width * height] : image.bits();
+                    channelsM[i] = plane + ym * width;
+                    channels[i] = plane + y * width;
+                    channelsP[i] = plane + yp * width;
+                }
+                pixelGradient(linem, line, linep, 0, width, depth, magnitudes[0], orientations[0]);
+                x = gradientRowAVX2(&channelsM[0], &channels[0], &channelsP[0], width, depth, magnitudes, orientations);
+            }
+#endif
+            for (; x < width; ++x)
+                pixelGradient(linem, line, linep, x, width, depth, magnitudes[x], orientations[x]);
+        }
+    }
+}
+
+
+void HOGFeatureExtractor::HOG(const Gradients & gradients, FeatureMatrix & feat, const Size & padding, const Size & cellSize)
+{
+    // Some shortcuts
+    const int width = gradients.width;
+    const int height = gradients.height;
     const Size padCells = cellSize * padding;
+    const Size csh = cellSize / 2;
     
     // Make sure the image is big enough
     assert(cellSize.width % 2 == 0);
     assert(cellSize.height % 2 == 0);
     assert(width >= cellSize.width / 2);
     assert(height >= cellSize.height / 2);
-    assert(depth >= 1);
     assert(padding.width >= 1);
     assert(padding.height >= 1);
     
@@ -229,51 +495,89 @@ void HOGFeatureExtractor::HOG(const JPEGImage & image, FeatureMatrix & feat, con
     feat = FeatureMatrix((height + cellSize.height / 2) / cellSize.height + padding.height * 2,
                          (width + cellSize.width / 2) / cellSize.width + padding.width * 2,
                          FeatureCell::Zero(32));
+    const int cols = feat.cols();
+    Eigen::Map<ScalarMatrix> cells = feat.asCellMatrix();
     
-    for (int y = 0; y < height; ++y)
+    // Horizontal bilinear interpolation coefficients for each pixel: The left cell receives a weight of `d`,
+    // the right one a weight of `c`.
+    vector<int> cellIndices(width);
+    vector<FeatureScalar> weightsLeft(width), weightsRight(width);
+    for (int x = 0; x < width; ++x)
     {
-        const int yp = min(y + 1, height - 1);
-        const int ym = max(y - 1, 0);
-        
-        const uint8_t * linep = reinterpret_cast<const uint8_t *>(image.scanLine(yp));
-        const uint8_t * line = reinterpret_cast<const uint8_t *>(image.scanLine(y));
-        const uint8_t * linem = reinterpret_cast<const uint8_t *>(image.scanLine(ym));
-        
-        for (int x = 0; x < width; ++x)
+        const int l = (x + padCells.width - csh.width) % cellSize.width;
+        cellIndices[x] = (x + padCells.width - csh.width) / cellSize.width;
+        weightsRight[x] = l * 2 + 1;
+        weightsLeft[x] = cellSize.width * 2 - weightsRight[x];
+    }
+    
+    // Accumulate the votes of the pixels of each row for the two horizontally neighbouring cells first
+    // and add them to the two vertically neighbouring rows of cells afterwards, instead of scattering the
+    // votes of each pixel among 4 cells.
+    // The pixels are processed in bands of rows of cells, where the pixels in rows of cell `i` vote for the
+    // rows of cells `i` and `i + 1`. Each band but the first one defers its votes for its first row of cells,
+    // which it shares with the previous band, until all bands have been processed.
+    const int offset = padCells.height - csh.height;
+    const int firstRow = offset / cellSize.height;
+    const int numRows = (height - 1 + offset) / cellSize.height - firstRow + 1;
+    const int bands = numBands(width * height, numRows);
+    vector< vector<ScalarMatrix> > deferredVotes(bands);
+    vector< vector<FeatureScalar> > deferredWeights(bands);
+    int band;
+    #pragma omp parallel for private(band) if(bands > 1)
+    for (band = 0; band < bands; ++band)
+    {
+        const int bandFirstRow = firstRow + numRows * band / bands;
+        const int bandEndRow = firstRow + numRows * (band + 1) / bands;
+        ScalarMatrix rowVotes(cols, 18);
+        for (int y = max(bandFirstRow * cellSize.height - offset, 0); y < min(bandEndRow * cellSize.height - offset, height); ++y)
         {
-            const int xp = min(x + 1, width - 1);
-            const int xm = max(x - 1, 0);
+            const FeatureScalar * magnitudes = &gradients.magnitude[y * width];
+            const FeatureScalar * orientations = &gradients.orientation[y * width];
             
-            // Use the channel with the largest gradient magnitude
-            FeatureScalar magnitude = 0;
-            FeatureScalar theta = 0;
-            
-            for (int i = 0; i < depth; ++i)
+            rowVotes.setZero();
+            for (int x = 0; x < width; ++x)
             {
-                const int dx = static_cast<int>(line[xp * depth + i]) -
-                               static_cast<int>(line[xm * depth + i]);
-                const int dy = static_cast<int>(linep[x * depth + i]) -
-                               static_cast<int>(linem[x * depth + i]);
+                const FeatureScalar magnitude = magnitudes[x];
+                const FeatureScalar theta = orientations[x];
                 
-                if (dx * dx + dy * dy > magnitude)
-                {
-                    magnitude = dx * dx + dy * dy;
-                    theta = ATAN2_TABLE[dy + 255][dx + 255];
-                }
+                // Linear interpolation between orientation bins
+                const int theta0 = theta;
+                const int theta1 = (theta0 < 17) ? (theta0 + 1) : 0;
+                const FeatureScalar magnitude1 = magnitude * (theta - theta0);
+                const FeatureScalar magnitude0 = magnitude - magnitude1;
+                
+                FeatureScalar * left = rowVotes.data() + cellIndices[x] * 18;
+                FeatureScalar * right = left + 18;
+                left[theta0] += magnitude0 * weightsLeft[x];
+                left[theta1] += magnitude1 * weightsLeft[x];
+                right[theta0] += magnitude0 * weightsRight[x];
+                right[theta1] += magnitude1 * weightsRight[x];
             }
             
-            magnitude = sqrt(magnitude);
-            
-            // Bilinear interpolation
-            const int theta0 = theta;
-            const int theta1 = (theta0 < 17) ? (theta0 + 1) : 0;
-            const FeatureScalar magnitude1 = magnitude * (theta - theta0);
-            interpolate(x + padCells.width, y + padCells.height,
-                        theta0, theta1, magnitude - magnitude1, magnitude1,
-                        cellSize, feat);
+            // Vertical bilinear interpolation
+            const int i = (y + offset) / cellSize.height;
+            const int k = (y + offset) % cellSize.height;
+            const FeatureScalar a = k * 2 + 1;
+            const FeatureScalar b = cellSize.height * 2 - a;
+            if (i == bandFirstRow && band > 0)
+            {
+                deferredVotes[band].push_back(rowVotes);
+                deferredWeights[band].push_back(b);
+            }
+            else
+                cells.block(i * cols, 0, cols, 18) += rowVotes * b;
+            cells.block((i + 1) * cols, 0, cols, 18) += rowVotes * a;
         }
     }
     
+    // Merge the votes for the rows of cells at the borders between bands
+    for (band = 1; band < bands; ++band)
+    {
+        const int i = firstRow + numRows * band / bands;
+        for (size_t j = 0; j < deferredVotes[band].size(); ++j)
+            cells.block(i * cols, 0, cols, 18) += deferredVotes[band][j] * deferredWeights[band][j];
+    }
+    
     // Compute the "gradient energy" of each cell, i.e. ||C(i,j)||^2
     feat.channel(31).setZero();
     for (int i = 0; i < 9; ++i)
@@ -281,7 +585,9 @@ void HOGFeatureExtractor::HOG(const JPEGImage & image, FeatureMatrix & feat, con
     
     // Compute the four normalization factors then normalize and clamp everything
     const FeatureScalar EPS = numeric_limits<FeatureScalar>::epsilon();
-    for (int y = padding.height; y < feat.rows() - padding.height; ++y)
+    int y;
+    #pragma omp parallel for private(y) if(bands > 1)
+    for (y = padding.height; y < feat.rows() - padding.height; ++y)
         for (int x = padding.width; x < feat.cols() - padding.width; ++x)
         {
             // Normalization factors
@@ -337,7 +643,7 @@ void HOGFeatureExtractor::HOG(const JPEGImage & image, FeatureMatrix & feat, con
         }
     
     // Truncation features
-    for (int y = 0; y < feat.rows(); ++y)
+    for (y = 0; y < feat.rows(); ++y)
         for (int x = 0; x < feat.cols(); ++x)
         {
             if (y < padding.height || y >= feat.rows() - padding.height || x < padding.width || x >= feat.cols() - padding.width)
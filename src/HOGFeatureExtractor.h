@@ -17,6 +17,10 @@ namespace ARTOS
 * **Parameters of this feature extractor:**
 *     - *cellSizeX* (`int`) - size of pooling cells in x direction in pixels.
 *     - *cellSizeY* (`int`) - size of pooling cells in y direction in pixels.
+*     - *approxPyramid* (`int`) - if set to 1, feature pyramids will be approximated (see approximatePyramid()).
+*     - *scalingExponents* (`string`) - comma-separated list with the exponent of the power law for each of the
+*       32 feature channels used for approximating feature pyramids (see scalingExponents()), as printed by the
+*       `learn_pyramid_scaling` tool. If empty, the approximated levels will not be corrected.
 *
 * To use another feature extractor by default, re-define `DefaultFeatureExtractor` in
 * FeatureExtractor.h.
@@ -74,6 +78,17 @@ public:
     */
     virtual bool supportsVariableCellSize() const override;
     
+    /**
+    * Specifies if extract() distributes the computation for a single image among multiple threads itself
+    * when it is not called from within a parallel region, which is the case for images large enough to be
+    * split into multiple bands if ARTOS has been built with OpenMP.
+    *
+    * @param[in] imageSize The size of the image.
+    *
+    * @return Returns true if the features of an image of the given size are extracted using multiple threads.
+    */
+    virtual bool supportsParallelExtraction(const Size & imageSize) const override;
+    
     /**
     * Converts a width and height given in pixels to cells.
     *
@@ -83,6 +98,18 @@ public:
     */
     virtual Size pixelsToCells(const Size & pixels) const override;
     
+    /**
+    * @return Returns true if feature pyramids should extract features only at one scale per octave and approximate
+    * the levels in between, which is the case if the parameter `approxPyramid` is set to 1.
+    */
+    virtual bool approximatePyramid() const override { return this->m_approxPyramid; };
+    
+    /**
+    * @return Returns the exponents of the power law used for approximating features of downscaled images
+    * for each feature channel, as given by the parameter `scalingExponents`.
+    */
+    virtual std::vector<FeatureScalar> scalingExponents() const override { return this->m_scalingExponents; };
+    
     /**
     * Computes HOG features for a given image.
     *
@@ -110,6 +137,19 @@ public:
     */
     virtual void extract(const JPEGImage & img, FeatureMatrix & feat, const Size & cellSize) const override;
     
+    /**
+    * Computes HOG features for a given image using several cell sizes.
+    *
+    * The gradients of the image are computed only once and then binned for each of the cell sizes.
+    *
+    * @param[in] img The image to compute HOG features for.
+    *
+    * @param[in] cellSizes The sizes of the feature cells.
+    *
+    * @param[out] feats Receives the features extracted using each of the given cell sizes.
+    */
+    virtual void extract(const JPEGImage & img, const std::vector<Size> & cellSizes, std::vector<FeatureMatrix> & feats) const override;
+    
     /**
     * Transforms a feature matrix into a feature representation of the horizontally flipped image.
     *
@@ -137,6 +177,19 @@ public:
     */
     virtual void setParam(const std::string & paramName, int32_t val) override;
     
+    /**
+    * Changes the value of a string parameter specific to this algorithm.
+    *
+    * @param[in] paramName The name of the parameter to be set.
+    *
+    * @param[in] val The new value for the parameter.
+    *
+    * @throws UnknownParameterException There is no string parameter with the given name.
+    *
+    * @throws std::invalid_argument The given value is not allowed for the given parameter.
+    */
+    virtual void setParam(const std::string & paramName, const std::string & val) override;
+    
     /**
     * Proposes an optimal size of a model for images with given sizes.
     * This information will be used by the ModelLearner.
@@ -155,6 +208,33 @@ public:
 
 public:
 
+    /**
+    * Gradient magnitude and orientation of each pixel of an image, stored in row-major order.
+    */
+    struct Gradients
+    {
+        int width; /**< The width of the image. */
+        int height; /**< The height of the image. */
+        std::vector<FeatureScalar> magnitude; /**< The magnitude of the gradient of each pixel. */
+        std::vector<FeatureScalar> orientation; /**< The orientation of the gradient of each pixel in the range [0, 18). */
+        
+        Gradients() : width(0), height(0) {};
+    };
+    
+    /**
+    * Computes the gradients of an image used for HOG features. For images with multiple channels,
+    * the gradient of the channel with the largest magnitude is used for each pixel.
+    *
+    * If ARTOS has been built with `ARTOS_PATCHWORK_SIMD` and the CPU supports AVX2, the gradients of 8 pixels
+    * of a row are computed at once and their orientations are approximated by a polynomial, which deviates
+    * from the exact orientation by less than 1e-5 bins.
+    *
+    * @param[in] image The image.
+    *
+    * @param[out] gradients Receives the gradients of the image.
+    */
+    static void computeGradients(const JPEGImage & image, Gradients & gradients);
+    
     /**
     * Extracts HOG features from a given image and stores them in a FeatureMatrix.
     *
@@ -172,11 +252,48 @@ public:
     * Each dimension must be a multiple of 2.
     */
     static void HOG(const JPEGImage & image, FeatureMatrix & feat, const Size & padding, const Size & cellSize);
+    
+    /**
+    * Extracts HOG features from the gradients of an image computed by computeGradients() and stores them in a FeatureMatrix.
+    *
+    * Large images are split into bands of rows of cells, which are processed in parallel if this method is not
+    * called from within a parallel region. The votes of each band for the first row of cells, which it shares
+    * with the previous band, are added after all bands have been processed in the same order as they would be
+    * by a single thread, so that the result does not depend on the number of threads. The same applies to
+    * computeGradients().
+    *
+    * @param[in] gradients The gradients of the image.
+    *
+    * @param[out] feat The FeatureMatrix where the HOG features will be stored. The matrix will
+    * be resized to `(ceil(gradients.width / cellSize) + 2 * padding.width, ceil(gradients.height / cellSize) + 2 * padding.height)`.
+    *
+    * @param[in] padding Number of empty cells to pad the feature matrix with around the borders in
+    * each direction before interpolation of gradient orientations among neighbouring cells. Must be at least (1, 1).
+    *
+    * @param[in] cellSize The number of pixels in each direction per histogram cell.
+    * Each dimension must be a multiple of 2.
+    */
+    static void HOG(const Gradients & gradients, FeatureMatrix & feat, const Size & padding, const Size & cellSize);
+
+
+protected:
+
+    /**
+    * Omits the parameters `approxPyramid` and `scalingExponents` from serialized models as long as pyramid
+    * approximation is disabled and no exponents are given, so that older versions of ARTOS can read them.
+    *
+    * @param[in] paramName The name of the parameter.
+    *
+    * @return Returns true if the parameter is to be serialized.
+    */
+    virtual bool serializesParam(const std::string & paramName) const override;
 
 
 private:
 
     Size m_cellSize;
+    bool m_approxPyramid;
+    std::vector<FeatureScalar> m_scalingExponents;
 
 };
 
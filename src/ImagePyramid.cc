@@ -0,0 +1,48 @@
+#include "ImagePyramid.h"
+using namespace ARTOS;
+using namespace std;
+
+
+ImagePyramid::ImagePyramid(const JPEGImage & image) : m_image(image)
+{
+    if (image.empty())
+        return;
+
+    // The sizes of the octaves are computed like in JPEGImage::resize()
+    float scale = 0.5f;
+    int halfWidth = image.width() * scale + 0.5f;
+    int halfHeight = image.height() * scale + 0.5f;
+    while (halfWidth >= 1 && halfHeight >= 1)
+    {
+        const JPEGImage & src = (this->m_octaves.empty()) ? image : this->m_octaves.back();
+        JPEGImage octave(halfWidth, halfHeight, image.depth());
+        JPEGImage::Resize(src.bits(), src.width(), src.height(), octave.bits(), halfWidth, halfHeight, image.depth());
+        this->m_octaves.push_back(move(octave));
+
+        scale *= 0.5f;
+        halfWidth = image.width() * scale + 0.5f;
+        halfHeight = image.height() * scale + 0.5f;
+    }
+}
+
+
+JPEGImage ImagePyramid::resize(int width, int height) const
+{
+    if (width <= 0 || height <= 0)
+        return JPEGImage();
+
+    if (width == this->m_image.width() && height == this->m_image.height())
+        return this->m_image;
+
+    // Find the smallest octave which is not smaller than the requested size
+    const JPEGImage * src = &(this->m_image);
+    for (const JPEGImage & octave : this->m_octaves)
+        if (width <= octave.width() && height <= octave.height())
+            src = &octave;
+        else
+            break;
+
+    JPEGImage result(width, height, src->depth());
+    JPEGImage::Resize(src->bits(), src->width(), src->height(), result.bits(), width, height, src->depth());
+    return result;
+}
@@ -0,0 +1,59 @@
+#ifndef ARTOS_IMAGEPYRAMID_H
+#define ARTOS_IMAGEPYRAMID_H
+
+#include <vector>
+#include "JPEGImage.h"
+
+namespace ARTOS
+{
+
+/**
+* Provides scaled versions of an image for building pyramids with many scales of the same image.
+*
+* JPEGImage::resize() halves the image repeatedly until the next halving would be smaller than the requested
+* size and interpolates the requested size from the last one. Those octaves are the same for all scales of the
+* image, so this class computes them only once on construction and derives each scale requested by resize()
+* from the nearest larger octave. The results are identical to those of JPEGImage::resize().
+*
+* Since all octaves are computed on construction, resize() may be called concurrently from multiple threads.
+*/
+class ImagePyramid
+{
+
+public:
+
+    /**
+    * Computes the octaves of an image.
+    *
+    * @param[in] image The image. It must not be destroyed or modified before this object.
+    */
+    ImagePyramid(const JPEGImage & image);
+
+    /**
+    * @return Returns a reference to the original image.
+    */
+    const JPEGImage & image() const { return this->m_image; };
+
+    /**
+    * @return Returns the number of octaves computed from the original image, which is not counted.
+    */
+    int numOctaves() const { return this->m_octaves.size(); };
+
+    /**
+    * Returns a copy of the image scaled to the given @p width and @p height, which is the same
+    * as `image().resize(width, height)`.
+    * If either the width or the height is zero or negative, the method returns an empty image.
+    */
+    JPEGImage resize(int width, int height) const;
+
+
+protected:
+
+    const JPEGImage & m_image;
+    std::vector<JPEGImage> m_octaves; /**< Octave `i` has half the size of octave `i - 1` and octave -1 is `m_image`. */
+
+};
+
+}
+
+#endif
@@ -176,6 +176,8 @@ public:
     
 private:
 
+    friend class ImagePyramid;
+    
     /**
     * Blur and downscale an image by a factor 2
     */
@@ -25,22 +25,26 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <atomic>
+#include "ScoreKernels.h"
 #include "strutils.h"
 
 using namespace ARTOS;
 using namespace std;
 
-Mixture::Mixture() : featureExtractor_(FeatureExtractor::defaultFeatureExtractor()), cached_(0)
+static atomic<unsigned long> nextMixtureId(1);
+
+Mixture::Mixture() : featureExtractor_(FeatureExtractor::defaultFeatureExtractor()), id_(nextMixtureId++)
 {
 }
 
 Mixture::Mixture(const shared_ptr<FeatureExtractor> & featureExtractor)
-: featureExtractor_((featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor()), cached_(0)
+: featureExtractor_((featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor()), id_(nextMixtureId++)
 {
 }
 
 Mixture::Mixture(const vector<Model> & models, const shared_ptr<FeatureExtractor> & featureExtractor)
-: models_(models), featureExtractor_((featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor()), cached_(0)
+: models_(models), featureExtractor_((featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor()), id_(nextMixtureId++)
 {
     for (const auto & m : models_)
         if (!m.empty() && m.nbFeatures() != featureExtractor_->numFeatures())
@@ -48,29 +52,28 @@ Mixture::Mixture(const vector<Model> & models, const shared_ptr<FeatureExtractor
 }
 
 Mixture::Mixture(vector<Model> && models, const shared_ptr<FeatureExtractor> & featureExtractor)
-: models_(std::move(models)), featureExtractor_((featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor()), cached_(0)
+: models_(std::move(models)), featureExtractor_((featureExtractor) ? featureExtractor : FeatureExtractor::defaultFeatureExtractor()), id_(nextMixtureId++)
 {
     for (const auto & m : models_)
         if (!m.empty() && m.nbFeatures() != featureExtractor_->numFeatures())
             throw IncompatibleException("Number of features of models to be added to a mixture does not match the one reported by the given FeatureExtractor.");
 }
 
-Mixture::Mixture(const Mixture & other) : models_(other.models_), featureExtractor_(other.featureExtractor_), cached_(0)
+Mixture::Mixture(const Mixture & other) : models_(other.models_), featureExtractor_(other.featureExtractor_), id_(other.id_)
 {
 }
 
-Mixture::Mixture(Mixture && other) : models_(std::move(other.models_)), featureExtractor_(other.featureExtractor_), cached_(0)
+Mixture::Mixture(Mixture && other) : models_(std::move(other.models_)), featureExtractor_(other.featureExtractor_), id_(other.id_)
 {
+    other.id_ = nextMixtureId++;
 }
 
 Mixture & Mixture::operator=(Mixture && other)
 {
     models_ = std::move(other.models_);
     featureExtractor_ = other.featureExtractor_;
-    filterCache_.clear();
-    cached_ = 0;
-    other.filterCache_.clear();
-    other.cached_ = 0;
+    id_ = other.id_;
+    other.id_ = nextMixtureId++;
     return *this;
 }
 
@@ -89,7 +92,7 @@ void Mixture::addModel(const Model & model)
     if (!model.empty() && model.nbFeatures() != featureExtractor_->numFeatures())
         throw IncompatibleException("Tried to mix models with a different number of features.");
     models_.push_back(model);
-    cached_ = 0;
+    id_ = nextMixtureId++;
 }
 
 void Mixture::addModel(Model && model)
@@ -97,7 +100,7 @@ void Mixture::addModel(Model && model)
     if (!model.empty() && model.nbFeatures() != featureExtractor_->numFeatures())
         throw IncompatibleException("Tried to mix models with a different number of features.");
     models_.push_back(std::move(model));
-    cached_ = 0;
+    id_ = nextMixtureId++;
 }
 
 Size Mixture::minSize() const
@@ -133,8 +136,8 @@ shared_ptr<FeatureExtractor> Mixture::featureExtractor() const
     return this->featureExtractor_;
 }
 
-void Mixture::convolve(const FeaturePyramid & pyramid, vector<ScalarMatrix> & scores,
-                       vector<Indices> & argmaxes,
+void Mixture::convolve(PatchworkContext & context, const FeaturePyramid & pyramid,
+                       vector<ScalarMatrix> & scores, vector<Indices> & argmaxes,
                        vector< vector< vector< Model::Positions> > > * positions) const
 {
     if (empty() || pyramid.empty()) {
@@ -147,13 +150,65 @@ void Mixture::convolve(const FeaturePyramid & pyramid, vector<ScalarMatrix> & sc
         return;
     }
     
+    // Convolve with all the models
+    vector< vector< ScalarMatrix> > tmp(models_.size());
+    convolve(context, pyramid, tmp, positions);
+    
+    // Take the best model at each position
+    maxComponents(pyramid, tmp, scores, argmaxes, positions);
+}
+
+void Mixture::computeScores(const FeaturePyramid & pyramid,
+                            vector< vector<ScalarMatrix> > & convolutions,
+                            vector<ScalarMatrix> & scores, vector<Indices> & argmaxes,
+                            vector< vector< vector<Model::Positions> > > * positions) const
+{
+    if (empty() || pyramid.empty() || convolutions.size() != static_cast<size_t>(nbFilters())) {
+        scores.clear();
+        argmaxes.clear();
+        
+        if (positions)
+            positions->clear();
+        
+        return;
+    }
+    
+    // Apply the distance transforms of all the models
+    vector< vector< ScalarMatrix> > tmp(models_.size());
+    computeScores(pyramid, convolutions, tmp, positions);
+    
+    // Take the best model at each position
+    maxComponents(pyramid, tmp, scores, argmaxes, positions);
+}
+
+void Mixture::computeComponentScores(const FeaturePyramid & pyramid, int model,
+                                     vector< vector<ScalarMatrix> > & convolutions,
+                                     vector<ScalarMatrix> & scores) const
+{
+    if (model < 0 || model >= static_cast<int>(models_.size()) || convolutions.size() != models_[model].parts_.size())
+    {
+        scores.clear();
+        return;
+    }
+    
+    models_[model].convolve(pyramid, convolutions, scores);
+}
+
+int Mixture::nbFilters() const
+{
+    int nbFilters = 0;
+    for (size_t i = 0; i < models_.size(); ++i)
+        nbFilters += models_[i].parts_.size();
+    return nbFilters;
+}
+
+void Mixture::maxComponents(const FeaturePyramid & pyramid, vector< vector<ScalarMatrix> > & tmp,
+                            vector<ScalarMatrix> & scores, vector<Indices> & argmaxes,
+                            vector< vector< vector<Model::Positions> > > * positions) const
+{
     const int nbModels = models_.size();
     const int nbLevels = pyramid.levels().size();
     
-    // Convolve with all the models
-    vector< vector< ScalarMatrix> > tmp(nbModels);
-    convolve(pyramid, tmp, positions);
-    
     // In case of error
     if (tmp.empty()) {
         scores.clear();
@@ -175,26 +230,15 @@ void Mixture::convolve(const FeaturePyramid & pyramid, vector<ScalarMatrix> & sc
         // The FFLD version extracted only the valid area of the convolution here,
         // i.e. (rows() - maxSize().height + 1, cols() - maxSize().width + 1), but in
         // ARTOS we've got better results on the image borders using the full size.
-        scores[i].resize(pyramid.levels()[i].rows(), pyramid.levels()[i].cols());
+        vector<const ScalarMatrix *> components(nbModels);
+        for (int j = 0; j < nbModels; ++j)
+            components[j] = &tmp[j][i];
         
-        argmaxes[i].resize(scores[i].rows(), scores[i].cols());
-        
-        for (int y = 0; y < scores[i].rows(); ++y) {
-            for (int x = 0; x < scores[i].cols(); ++x) {
-                int argmax = 0;
-                
-                for (int j = 1; j < nbModels; ++j)
-                    if (tmp[j][i](y, x) > tmp[argmax][i](y, x))
-                        argmax = j;
-                
-                scores[i](y, x) = tmp[argmax][i](y, x);
-                argmaxes[i](y, x) = argmax;
-            }
-        }
+        MaxComponents(components, scores[i], &argmaxes[i]);
     }
 }
 
-void Mixture::convolve(const FeaturePyramid & pyramid,
+void Mixture::convolve(PatchworkContext & context, const FeaturePyramid & pyramid,
                        vector< vector<ScalarMatrix> > & scores,
                        vector< vector< vector<Model::Positions> > > * positions) const
 {
@@ -203,32 +247,28 @@ void Mixture::convolve(const FeaturePyramid & pyramid,
         
         if (positions)
             positions->clear();
+        
+        return;
     }
     
-    const int nbModels = models_.size();
-    
-    scores.resize(nbModels);
-    
-    if (positions)
-        positions->resize(nbModels);
-    
     // Transform the filters if needed
-#pragma omp critical
-    if (cached_ != Patchwork::NumInits() || filterCache_.empty())
-    {
-        cached_ = 0;
-        cacheFilters();
-    }
-    
-    while (!cached_);
+    const shared_ptr<const PatchworkContext::FilterList> filters = context.filters(*this);
     
     // Create a patchwork
-    const Patchwork patchwork(pyramid, this->maxSize() / 2 + 1);
+    const Patchwork patchwork(context, pyramid, this->maxSize() / 2 + 1);
     
     // Convolve the patchwork with the filters
-    vector< vector<ScalarMatrix> > convolutions(filterCache_.size());
-    patchwork.convolve(filterCache_, convolutions);
+    vector< vector<ScalarMatrix> > convolutions(filters->size());
+    patchwork.convolve(*filters, convolutions);
     
+    computeScores(pyramid, convolutions, scores, positions);
+}
+
+void Mixture::computeScores(const FeaturePyramid & pyramid,
+                            vector< vector<ScalarMatrix> > & convolutions,
+                            vector< vector<ScalarMatrix> > & scores,
+                            vector< vector< vector<Model::Positions> > > * positions) const
+{
     // In case of error
     if (convolutions.empty()) {
         scores.clear();
@@ -239,6 +279,13 @@ void Mixture::convolve(const FeaturePyramid & pyramid,
         return;
     }
     
+    const int nbModels = models_.size();
+    
+    scores.resize(nbModels);
+    
+    if (positions)
+        positions->resize(nbModels);
+    
     // Save the offsets of each model in the filter list
     vector<int> offsets(nbModels);
     
@@ -260,27 +307,10 @@ void Mixture::convolve(const FeaturePyramid & pyramid,
     }
 }
 
-void Mixture::cacheFilters() const
+void Mixture::cacheFilters(PatchworkContext & context) const
 {
-    // Count the number of filters
-    int nbFilters = 0;
-    
-    for (size_t i = 0; i < models_.size(); ++i)
-        nbFilters += models_[i].parts_.size();
-    
-    // Transform all the filters
-    filterCache_.resize(nbFilters);
-    
-    for (size_t i = 0, j = 0; i < models_.size(); ++i) {
-        int k;
-#pragma omp parallel for private(k)
-        for (k = 0; k < models_[i].parts_.size(); ++k)
-            Patchwork::TransformFilter(models_[i].parts_[k].filter, filterCache_[j + k]);
-        
-        j += models_[i].parts_.size();
-    }
-    
-    cached_ = Patchwork::NumInits();
+    if (context.filterCachePolicy() != FilterCachePolicy::ON_THE_FLY)
+        context.filters(*this);
 }
 
 ostream & ARTOS::operator<<(ostream & os, const Mixture & mixture)
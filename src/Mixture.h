@@ -23,6 +23,7 @@
 
 #include "Model.h"
 #include "Patchwork.h"
+#include "PatchworkContext.h"
 
 namespace ARTOS
 {
@@ -152,10 +153,22 @@ public:
     */
     std::shared_ptr<FeatureExtractor> featureExtractor() const;
     
+    /**
+    * Returns an identifier of the current set of models in this mixture, which is used as key
+    * for caching the transformed filters in a PatchworkContext.
+    *
+    * Copies of a mixture share the same identifier, while modifying the mixture by adding a
+    * model assigns a new one.
+    */
+    unsigned long id() const { return this->id_; };
+    
     /**
     * Returns the scores of the convolutions + distance transforms of the models with a
     * pyramid of features (useful to compute the SVM margins).
     *
+    * @param[in] context The patchwork context used for the convolutions. It must have been
+    * initialized for the size of the largest level of the given pyramid.
+    *
     * @param[in] pyramid Pyramid of features.
     *
     * @param[out] scores Scores for each pyramid level.
@@ -166,15 +179,67 @@ public:
     * @param[out] positions Positions of each part of each model for each pyramid level
     * (`models x parts x levels`).
     */
-    void convolve(const FeaturePyramid & pyramid, std::vector<ScalarMatrix> & scores,
-                  std::vector<Indices> & argmaxes,
+    void convolve(PatchworkContext & context, const FeaturePyramid & pyramid,
+                  std::vector<ScalarMatrix> & scores, std::vector<Indices> & argmaxes,
                   std::vector< std::vector< std::vector<Model::Positions> > > * positions = 0)
                  const;
     
     /**
-    * Cache the transformed version of the models' filters.
+    * Computes the scores of the models from the responses of their filters, which have been
+    * computed in advance, e.g. by a single Patchwork shared among several mixtures.
+    *
+    * @param[in] pyramid Pyramid of features.
+    *
+    * @param[in,out] convolutions The convolutions of the filters of this mixture with the pyramid
+    * (`filters x levels`), in the order given by PatchworkContext::filters(). The contents of
+    * this vector will be consumed.
+    *
+    * @param[out] scores Scores for each pyramid level.
+    *
+    * @param[out] argmaxes Indices of the best model (mixture component) for each pyramid
+    * level.
+    *
+    * @param[out] positions Positions of each part of each model for each pyramid level
+    * (`models x parts x levels`).
+    */
+    void computeScores(const FeaturePyramid & pyramid,
+                       std::vector< std::vector<ScalarMatrix> > & convolutions,
+                       std::vector<ScalarMatrix> & scores, std::vector<Indices> & argmaxes,
+                       std::vector< std::vector< std::vector<Model::Positions> > > * positions = 0)
+                      const;
+    
+    /**
+    * Computes the scores of a single model (mixture component) from the responses of its filters.
+    *
+    * This allows computing the scores of a mixture component by component, so that only the
+    * convolutions of a few filters have to be kept in memory at the same time. The best component
+    * at each position can be determined afterwards using MaxComponents() or, if only local maxima
+    * of the scores are of interest, FindPeaks().
+    *
+    * @param[in] pyramid Pyramid of features.
+    *
+    * @param[in] model Index of the model.
+    *
+    * @param[in,out] convolutions The convolutions of the root and the parts of the model with the
+    * pyramid (`filters x levels`). The contents of this vector will be consumed.
+    *
+    * @param[out] scores Scores of the model for each pyramid level.
+    */
+    void computeComponentScores(const FeaturePyramid & pyramid, int model,
+                                std::vector< std::vector<ScalarMatrix> > & convolutions,
+                                std::vector<ScalarMatrix> & scores) const;
+    
+    /**
+    * Returns the total number of filters (roots and parts) of all models in this mixture.
     */
-    void cacheFilters() const;
+    int nbFilters() const;
+    
+    /**
+    * Cache the transformed version of the models' filters in a given patchwork context.
+    *
+    * @param[in] context The patchwork context to store the transformed filters in.
+    */
+    void cacheFilters(PatchworkContext & context) const;
     
 private:
 
@@ -182,6 +247,8 @@ private:
     * Returns the scores of the convolutions + distance transforms of the models with a
     * pyramid of features (useful to compute the SVM margins).
     *
+    * @param[in] context The patchwork context used for the convolutions.
+    *
     * @param[in] pyramid Pyramid of features.
     *
     * @param[out] scores Scores of each model for each pyramid level
@@ -190,18 +257,54 @@ private:
     * @param[out] positions Positions of each part of each model for each pyramid level
     * (`models x parts x levels`).
     */
-    void convolve(const FeaturePyramid & pyramid,
+    void convolve(PatchworkContext & context, const FeaturePyramid & pyramid,
                   std::vector< std::vector<ScalarMatrix> > & scores,
                   std::vector< std::vector< std::vector<Model::Positions> > > * positions = 0)
                  const;
     
+    /**
+    * Applies the distance transforms of all models to the responses of their filters.
+    *
+    * @param[in] pyramid Pyramid of features.
+    *
+    * @param[in,out] convolutions The convolutions of the filters with the pyramid
+    * (`filters x levels`). The contents of this vector will be consumed.
+    *
+    * @param[out] scores Scores of each model for each pyramid level
+    * (`models x levels`).
+    *
+    * @param[out] positions Positions of each part of each model for each pyramid level
+    * (`models x parts x levels`).
+    */
+    void computeScores(const FeaturePyramid & pyramid,
+                       std::vector< std::vector<ScalarMatrix> > & convolutions,
+                       std::vector< std::vector<ScalarMatrix> > & scores,
+                       std::vector< std::vector< std::vector<Model::Positions> > > * positions)
+                      const;
+    
+    /**
+    * Selects the best model at each position.
+    *
+    * @param[in] pyramid Pyramid of features.
+    *
+    * @param[in] tmp Scores of each model for each pyramid level (`models x levels`).
+    *
+    * @param[out] scores Scores for each pyramid level.
+    *
+    * @param[out] argmaxes Indices of the best model for each pyramid level.
+    *
+    * @param[out] positions Will be cleared in the case of error.
+    */
+    void maxComponents(const FeaturePyramid & pyramid, std::vector< std::vector<ScalarMatrix> > & tmp,
+                       std::vector<ScalarMatrix> & scores, std::vector<Indices> & argmaxes,
+                       std::vector< std::vector< std::vector<Model::Positions> > > * positions)
+                      const;
+    
     std::vector<Model> models_; /**< The mixture components. */
     
     std::shared_ptr<FeatureExtractor> featureExtractor_; /**< The feature extractor which has been used to create the models in the mixture. */
     
-    // Used to speed up the convolutions
-    mutable std::vector<Patchwork::Filter> filterCache_; /**< Cache of transformed filters. */
-    volatile mutable int cached_; /**< Value of Patchwork::NumInits() as when the filters have been cached the last time. */
+    unsigned long id_; /**< Identifier of the current set of models, used as key for caching transformed filters. */
 
 };
 
@@ -151,6 +151,11 @@ public:
     */
     friend class Mixture;
     
+    /**
+    * Make the StarCascade class a friend so that it can evaluate the parts of the model individually.
+    */
+    friend class StarCascade;
+    
 private:
 
     /**
@@ -287,8 +287,13 @@ vector<unsigned int> ModelEvaluator::runDetector(SampleDetectionsVector & detect
         return numPositive;
     
     // Set detection thresholds to a minimal value
-    for (map<string, double>::iterator it = this->thresholds.begin(); it != this->thresholds.end(); it++)
-        it->second = numeric_limits<double>::lowest();
+    {
+        lock_guard<mutex> lock(this->modelMutex);
+        shared_ptr<ModelSet> modelSet = make_shared<ModelSet>(*(this->getModelSet()));
+        for (map<string, double>::iterator it = modelSet->thresholds.begin(); it != modelSet->thresholds.end(); it++)
+            it->second = numeric_limits<double>::lowest();
+        this->setModelSet(modelSet);
+    }
     
     // Set up parameters for progress callback
     unsigned int totalNumSamples, numSamplesProcessed = 0;
@@ -299,17 +304,15 @@ vector<unsigned int> ModelEvaluator::runDetector(SampleDetectionsVector & detect
     if (negative != NULL)
         totalNumSamples += negative->size();
     
-    // Save pointers to original models for the case that LOO-Cross-Validation is performed
-    map<string, Mixture*> originalMixtures;
+    // Save the original models for the case that LOO-Cross-Validation is performed
+    shared_ptr<const ModelSet> originalModels;
+    shared_ptr<ModelSet> looModels;
     Mixture * replacement = NULL;
-    vector<Mixture*> replacementModels;
-    vector<Mixture*>::iterator mixtureIt;
     vector<unsigned int> numLeftOut;
     vector<std::string> classnames;
     if (looFunc != NULL)
     {
-        originalMixtures = this->mixtures;
-        replacementModels.reserve(numModels);
+        originalModels = this->getModelSet();
         numLeftOut.assign(numModels, 0);
         for (size_t i = 0; i < numModels; i++)
             classnames.push_back(this->getClassnameFromIndex(i));
@@ -338,15 +341,22 @@ vector<unsigned int> ModelEvaluator::runDetector(SampleDetectionsVector & detect
                     numPositive[modelIndex] += 1;
                     if (looFunc != NULL) // Check for leave-one-out replacement
                     {
-                        replacement = looFunc(this->mixtures[classnames[modelIndex]], positive[i], modelAssocIndex, numLeftOut[modelIndex], looData);
-                        if (replacement != NULL && replacement != this->mixtures[classnames[modelIndex]])
+                        const Mixture * mixture = ((looModels) ? looModels : originalModels)->mixtures.at(classnames[modelIndex]).get();
+                        replacement = looFunc(mixture, positive[i], modelAssocIndex, numLeftOut[modelIndex], looData);
+                        if (replacement != NULL && replacement != mixture)
                         {
-                            replacementModels.push_back(replacement);
+                            if (!looModels)
+                                looModels = make_shared<ModelSet>(*originalModels);
+                            looModels->mixtures[classnames[modelIndex]] = this->manageMixture(replacement);
                             numLeftOut[modelIndex]++;
-                            this->mixtures[classnames[modelIndex]] = replacement;
                         }
                     }
                 }
+        if (looModels)
+        {
+            lock_guard<mutex> lock(this->modelMutex);
+            this->setModelSet(looModels);
+        }
         // Run detector and store detections
         try
         {
@@ -364,13 +374,12 @@ vector<unsigned int> ModelEvaluator::runDetector(SampleDetectionsVector & detect
             detections.push_back(pair<int, Detection>(i, *detection));
         sampleDetections.clear();
         // Restore original models in the case of leave-one-out validation
-        if (!replacementModels.empty())
+        if (looModels)
         {
-            for (mixtureIt = replacementModels.begin(); mixtureIt != replacementModels.end(); mixtureIt++)
-                delete *mixtureIt;
-            replacementModels.clear();
+            lock_guard<mutex> lock(this->modelMutex);
+            this->setModelSet(originalModels);
+            looModels.reset();
             numLeftOut.assign(numModels, 0);
-            this->mixtures = originalMixtures;
         }
         // Update progress
         numSamplesProcessed++;
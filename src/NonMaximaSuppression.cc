@@ -0,0 +1,193 @@
+#include "NonMaximaSuppression.h"
+#include "PatchworkKernels.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#if defined(ARTOS_PATCHWORK_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ARTOS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace ARTOS;
+using namespace std;
+
+
+/**
+* Rectangles which have survived so far and overlap a grid cell, stored as structure of arrays
+* so that a candidate can be tested against all of them with SIMD instructions.
+*/
+struct GridCell
+{
+    vector<int> left, top, right, bottom, area;
+};
+
+
+//// Portable tests (may be auto-vectorized by the compiler) ////
+
+/**
+* Tests if a rectangle is suppressed by any rectangle of a cell according to Felzenszwalb's criterion,
+* i.e. if the area of the intersection is at least `minIntersection`.
+*/
+static bool suppressedFelzenszwalbGeneric(const GridCell & cell, int left, int top, int right, int bottom, int minIntersection)
+{
+    const int n = cell.left.size();
+    int hit = 0;
+    for (int k = 0; k < n; ++k)
+    {
+        const int w = min(cell.right[k], right) - max(cell.left[k], left) + 1;
+        const int h = min(cell.bottom[k], bottom) - max(cell.top[k], top) + 1;
+        hit |= (w > 0) & (h > 0) & (w * h >= minIntersection);
+    }
+    return (hit != 0);
+}
+
+/**
+* Tests if a rectangle is suppressed by any rectangle of a cell according to the intersection over union.
+*/
+static bool suppressedIoU(const GridCell & cell, int left, int top, int right, int bottom, int area, double threshold)
+{
+    const int n = cell.left.size();
+    for (int k = 0; k < n; ++k)
+    {
+        const int w = min(cell.right[k], right) - max(cell.left[k], left) + 1;
+        const int h = min(cell.bottom[k], bottom) - max(cell.top[k], top) + 1;
+        if (w > 0 && h > 0)
+        {
+            const int intersectionArea = w * h;
+            const int unionArea = cell.area[k] + area - intersectionArea;
+            if (intersectionArea >= unionArea * threshold)
+                return true;
+        }
+    }
+    return false;
+}
+
+
+#ifdef ARTOS_X86_KERNELS
+
+//// AVX2 test ////
+
+__attribute__((target("avx2")))
+static bool suppressedFelzenszwalbAVX2(const GridCell & cell, int left, int top, int right, int bottom, int minIntersection)
+{
+    const int n = cell.left.size();
+    const __m256i l = _mm256_set1_epi32(left), t = _mm256_set1_epi32(top);
+    const __m256i r = _mm256_set1_epi32(right), b = _mm256_set1_epi32(bottom);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i minArea = _mm256_set1_epi32(minIntersection - 1); // w * h > minIntersection - 1
+    const __m256i one = _mm256_set1_epi32(1);
+    int k = 0;
+    for (; k + 8 <= n; k += 8)
+    {
+        const __m256i w = _mm256_add_epi32(_mm256_sub_epi32(
+                _mm256_min_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cell.right[k])), r),
+                _mm256_max_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cell.left[k])), l)), one);
+        const __m256i h = _mm256_add_epi32(_mm256_sub_epi32(
+                _mm256_min_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cell.bottom[k])), b),
+                _mm256_max_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&cell.top[k])), t)), one);
+        const __m256i hit = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(w, zero), _mm256_cmpgt_epi32(h, zero)),
+                                             _mm256_cmpgt_epi32(_mm256_mullo_epi32(w, h), minArea));
+        if (!_mm256_testz_si256(hit, hit))
+            return true;
+    }
+    for (; k < n; ++k)
+    {
+        const int w = min(cell.right[k], right) - max(cell.left[k], left) + 1;
+        const int h = min(cell.bottom[k], bottom) - max(cell.top[k], top) + 1;
+        if (w > 0 && h > 0 && w * h >= minIntersection)
+            return true;
+    }
+    return false;
+}
+
+#endif
+
+
+vector<bool> ARTOS::NonMaximaMask(const vector<Rectangle> & rectangles, double threshold, bool felzenszwalb)
+{
+    const size_t n = rectangles.size();
+    vector<bool> keep(n, true);
+
+    // Rectangles without area neither suppress nor are suppressed by Intersector
+    long long sumWidth = 0, sumHeight = 0, numNonEmpty = 0;
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+    for (const Rectangle & rect : rectangles)
+        if (rect.width() > 0 && rect.height() > 0)
+        {
+            minX = min(minX, rect.left());
+            minY = min(minY, rect.top());
+            maxX = max(maxX, rect.right());
+            maxY = max(maxY, rect.bottom());
+            sumWidth += rect.width();
+            sumHeight += rect.height();
+            numNonEmpty++;
+        }
+    if (numNonEmpty < 2)
+        return keep;
+
+    // Choose the cell size according to the average size of the rectangles, but limit the number of cells
+    long long cellWidth = max(1LL, sumWidth / numNonEmpty), cellHeight = max(1LL, sumHeight / numNonEmpty);
+    const long long maxCells = max(64LL, 4 * numNonEmpty);
+    long long gridWidth, gridHeight;
+    while (true)
+    {
+        gridWidth = (static_cast<long long>(maxX) - minX) / cellWidth + 1;
+        gridHeight = (static_cast<long long>(maxY) - minY) / cellHeight + 1;
+        if (gridWidth * gridHeight <= maxCells)
+            break;
+        cellWidth *= 2;
+        cellHeight *= 2;
+    }
+    vector<GridCell> grid(gridWidth * gridHeight);
+
+#ifdef ARTOS_X86_KERNELS
+    static const bool avx2 = (detectSIMDLevel() != SIMDLevel::NONE);
+    const auto suppressedFelzenszwalb = (avx2) ? suppressedFelzenszwalbAVX2 : suppressedFelzenszwalbGeneric;
+#else
+    const auto suppressedFelzenszwalb = suppressedFelzenszwalbGeneric;
+#endif
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Rectangle & rect = rectangles[i];
+        if (rect.width() <= 0 || rect.height() <= 0)
+            continue;
+
+        const int left = rect.left(), top = rect.top(), right = rect.right(), bottom = rect.bottom(), area = rect.area();
+        const int cx0 = (static_cast<long long>(left) - minX) / cellWidth, cx1 = (static_cast<long long>(right) - minX) / cellWidth;
+        const int cy0 = (static_cast<long long>(top) - minY) / cellHeight, cy1 = (static_cast<long long>(bottom) - minY) / cellHeight;
+
+        // Any rectangle suppressing this one must overlap it and, thus, share at least one cell with it.
+        // The area of the intersection is an integer, so `intersection >= area * threshold` is equivalent
+        // to `intersection >= ceil(area * threshold)`.
+        const double minIntersection = ceil(area * threshold);
+        bool suppressed = false;
+        if (!felzenszwalb || minIntersection <= INT_MAX)
+        {
+            const int minInt = static_cast<int>(max(minIntersection, static_cast<double>(INT_MIN)));
+            for (int cy = cy0; cy <= cy1 && !suppressed; ++cy)
+                for (int cx = cx0; cx <= cx1 && !suppressed; ++cx)
+                {
+                    const GridCell & cell = grid[cy * gridWidth + cx];
+                    suppressed = (felzenszwalb) ? suppressedFelzenszwalb(cell, left, top, right, bottom, minInt)
+                                                : suppressedIoU(cell, left, top, right, bottom, area, threshold);
+                }
+        }
+
+        if (suppressed)
+            keep[i] = false;
+        else
+            for (int cy = cy0; cy <= cy1; ++cy)
+                for (int cx = cx0; cx <= cx1; ++cx)
+                {
+                    GridCell & cell = grid[cy * gridWidth + cx];
+                    cell.left.push_back(left);
+                    cell.top.push_back(top);
+                    cell.right.push_back(right);
+                    cell.bottom.push_back(bottom);
+                    cell.area.push_back(area);
+                }
+    }
+    return keep;
+}
@@ -0,0 +1,61 @@
+#ifndef ARTOS_NONMAXIMASUPPRESSION_H
+#define ARTOS_NONMAXIMASUPPRESSION_H
+
+#include <utility>
+#include <vector>
+#include "Rectangle.h"
+
+namespace ARTOS
+{
+
+/**
+* Determines which of a list of rectangles, ordered by decreasing priority (e.g. detection score), survive
+* greedy non-maximum suppression: A rectangle is suppressed if it intersects a preceding rectangle which
+* has not been suppressed itself according to the criterion of Intersector.
+*
+* The result is identical to testing each rectangle against all preceding surviving ones with Intersector,
+* but only rectangles sharing a cell of a uniform grid over the bounding boxes are compared, which brings
+* the number of tests down from quadratic to roughly linear in the number of rectangles for typical detections.
+*
+* @param[in] rectangles The rectangles, ordered by decreasing priority.
+*
+* @param[in] threshold The overlap threshold of the criterion.
+*
+* @param[in] felzenszwalb Use Felzenszwalb's criterion (area of intersection over area of the suppressed
+* rectangle) instead of intersection over union.
+*
+* @return Returns a vector which is true for each rectangle that survives.
+*/
+std::vector<bool> NonMaximaMask(const std::vector<Rectangle> & rectangles, double threshold, bool felzenszwalb = false);
+
+/**
+* Removes all rectangles from a list, ordered by decreasing priority, which are suppressed by greedy
+* non-maximum suppression (see NonMaximaMask()). The order of the remaining rectangles is preserved.
+*
+* @param[in,out] rectangles The rectangles (or objects derived from Rectangle, such as detections),
+* ordered by decreasing priority.
+*
+* @param[in] threshold The overlap threshold of the criterion.
+*
+* @param[in] felzenszwalb Use Felzenszwalb's criterion (area of intersection over area of the suppressed
+* rectangle) instead of intersection over union.
+*/
+template<class T>
+void SuppressNonMaxima(std::vector<T> & rectangles, double threshold, bool felzenszwalb = false)
+{
+    const std::vector<bool> keep = NonMaximaMask(std::vector<Rectangle>(rectangles.begin(), rectangles.end()),
+                                                 threshold, felzenszwalb);
+    std::size_t numKept = 0;
+    for (std::size_t i = 0; i < rectangles.size(); ++i)
+        if (keep[i])
+        {
+            if (numKept != i)
+                rectangles[numKept] = std::move(rectangles[i]);
+            ++numKept;
+        }
+    rectangles.erase(rectangles.begin() + numKept, rectangles.end());
+}
+
+}
+
+#endif
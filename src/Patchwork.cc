@@ -19,30 +19,30 @@
 //--------------------------------------------------------------------------------------------------
 
 #include "Patchwork.h"
+#include "PatchworkContext.h"
+#include "PatchworkKernels.h"
 
 #include <algorithm>
 #include <cstdio>
 #include <numeric>
+#include <memory>
 
 using namespace ARTOS;
 using namespace std;
 
-int Patchwork::MaxRows_(0);
-int Patchwork::MaxCols_(0);
-int Patchwork::HalfCols_(0);
-int Patchwork::NumFeat_(0);
-int Patchwork::NumInits_(0);
-
-fftwf_plan Patchwork::Forwards_(0);
-fftwf_plan Patchwork::Inverse_(0);
-
-Patchwork::Patchwork() : padding_(0), interval_(0)
+Patchwork::Patchwork() : padding_(0), interval_(0), context_(0)
 {
 }
 
-Patchwork::Patchwork(const FeaturePyramid & pyramid, const Size & padding) : padding_(padding), interval_(pyramid.interval())
+Patchwork::Patchwork(const PatchworkContext & context, const FeaturePyramid & pyramid, const Size & padding)
+: padding_(padding), interval_(pyramid.interval()), context_(&context)
 {
-    if (pyramid.featureExtractor()->numFeatures() != NumFeat_)
+    const int maxRows = context_->maxRows();
+    const int maxCols = context_->maxCols();
+    const int halfCols = context_->halfCols();
+    const int numFeat = context_->numFeatures();
+    
+    if (!context_->initialized() || pyramid.featureExtractor()->numFeatures() != numFeat)
         return;
     
     const int nbLevels = pyramid.levels().size();
@@ -56,7 +56,7 @@ Patchwork::Patchwork(const FeaturePyramid & pyramid, const Size & padding) : pad
     }
     
     // Build the patchwork planes
-    const int nbPlanes = BLF(rectangles_, MaxCols_, MaxRows_);
+    const int nbPlanes = PackRectangles(rectangles_, maxCols, maxRows);
     
     // Constructs an empty patchwork in case of error
     if (nbPlanes <= 0)
@@ -64,26 +64,38 @@ Patchwork::Patchwork(const FeaturePyramid & pyramid, const Size & padding) : pad
     
     planes_.resize(nbPlanes);
     for (int i = 0; i < nbPlanes; ++i)
-        planes_[i] = Plane(MaxRows_, HalfCols_, Plane::Cell::Zero(NumFeat_));
+        planes_[i] = Plane(maxRows, halfCols, Plane::Cell::Zero(numFeat));
     
     // Fill the planes with the levels from the pyramid
     for (int i = 0; i < nbLevels; ++i)
     {
         Eigen::Map<ScalarMatrix>
             plane(reinterpret_cast<FeatureScalar*>(planes_[rectangles_[i].plane()].raw()),
-                  MaxRows_, HalfCols_ * 2 * NumFeat_);
+                  maxRows, halfCols * 2 * numFeat);
         
-        plane.block(rectangles_[i].y(), rectangles_[i].x() * NumFeat_,
-                    rectangles_[i].height() - padding_.height, (rectangles_[i].width() - padding_.width) * NumFeat_) =
+        plane.block(rectangles_[i].y(), rectangles_[i].x() * numFeat,
+                    rectangles_[i].height() - padding_.height, (rectangles_[i].width() - padding_.width) * numFeat) =
             pyramid.levels()[i].data();
     }
     
-    // Transform the planes
+    // Transform the planes, either one after another with all threads working on each plane
+    // or in parallel with one thread per plane
+    const bool threaded = context_->useThreadedFFT(nbPlanes, false);
     int i;
+    if (threaded)
+        for (i = 0; i < nbPlanes; ++i)
+            fftwf_execute_dft_r2c(context_->m_forwardsThreaded, reinterpret_cast<float *>(planes_[i].raw()),
+                                  reinterpret_cast<fftwf_complex *>(planes_[i].raw()));
+    
 #pragma omp parallel for private(i)
     for (i = 0; i < nbPlanes; ++i)
-        fftwf_execute_dft_r2c(Forwards_, reinterpret_cast<float *>(planes_[i].raw()),
-                              reinterpret_cast<fftwf_complex *>(planes_[i].raw()));
+    {
+        if (!threaded)
+            fftwf_execute_dft_r2c(context_->m_forwards, reinterpret_cast<float *>(planes_[i].raw()),
+                                  reinterpret_cast<fftwf_complex *>(planes_[i].raw()));
+        if (context_->splitLayout())
+            splitComplexCells(planes_[i].raw(), maxRows * halfCols, numFeat);
+    }
 }
 
 const Size & Patchwork::padding() const
@@ -103,8 +115,20 @@ bool Patchwork::empty() const
 
 void Patchwork::convolve(const vector<Filter> & filters,
                          vector<vector<ScalarMatrix> > & convolutions) const
+{
+    vector<const Filter *> filterPointers(filters.size());
+    for (size_t i = 0; i < filters.size(); ++i)
+        filterPointers[i] = &filters[i];
+    convolve(filterPointers, convolutions);
+}
+
+void Patchwork::convolve(const vector<const Filter *> & filters,
+                         vector<vector<ScalarMatrix> > & convolutions) const
 {
     int i, j, k, l;
+    const int maxRows = (context_) ? context_->maxRows() : 0;
+    const int halfCols = (context_) ? context_->halfCols() : 0;
+    const int numFeat = (context_) ? context_->numFeatures() : 0;
     const int nbFilters = filters.size();
     const int nbPlanes = planes_.size();
     const int nbLevels = rectangles_.size();
@@ -120,56 +144,75 @@ void Patchwork::convolve(const vector<Filter> & filters,
     // The performace measurements reported in the paper were done without reallocating the sums
     // each time by making them static
     // Even though it was faster (~10%) I removed it as it was not clean/thread safe
-    vector<vector<Plane::ScalarMatrix> > sums(nbFilters);
-    for (i = 0; i < nbFilters; ++i)
+    // All products are stored in a single buffer, so that they can be transformed back in batches
+    const int planeDist = context_->planeDist();
+    unique_ptr<Scalar, void(*)(void*)> sumsBuffer(static_cast<Scalar*>(fftwf_malloc(
+            static_cast<size_t>(nbFilters) * nbPlanes * planeDist * sizeof(Scalar))), fftwf_free);
+    if (!sumsBuffer)
     {
-        sums[i].resize(nbPlanes);
-        for (j = 0; j < nbPlanes; ++j)
-            sums[i][j].resize(MaxRows_, HalfCols_);
+        convolutions.clear();
+        return;
     }
+    Scalar * const sums = sumsBuffer.get();
     
     // The following assumptions are not dangerous in the sense that the program will only work
     // slower if they do not hold
     const int cacheSize = 32768; // Assume L1 cache of 32K
-    const int fragmentsSize = (nbPlanes + 1) * NumFeat_ * sizeof(Scalar); // Assume nbPlanes < nbFilters
+    const int fragmentsSize = (nbPlanes + 1) * numFeat * sizeof(Scalar); // Assume nbPlanes < nbFilters
     const int step = max(1, min(cacheSize / fragmentsSize,
 #ifdef _OPENMP
-                         MaxRows_ * HalfCols_ / omp_get_max_threads()));
+                         maxRows * halfCols / omp_get_max_threads()));
 #else
-                         MaxRows_ * HalfCols_));
+                         maxRows * halfCols));
 #endif
     
+    if (context_->splitLayout())
+    {
+        // Use the vectorized kernel operating on planes with separate real and imaginary parts
+        const ComplexMACKernel kernel = context_->m_kernel;
+        const int numCells = maxRows * halfCols;
+#pragma omp parallel for private(i,j,k)
+        for (i = 0; i < numCells; i += step)
+        {
+            const int n = min(step, numCells - i);
+            for (j = 0; j < nbFilters; ++j)
+                for (k = 0; k < nbPlanes; ++k)
+                    kernel(reinterpret_cast<const float*>(filters[j]->first.raw() + i * numFeat),
+                           reinterpret_cast<const float*>(planes_[k].raw() + i * numFeat),
+                           numFeat, n, sums + (j * nbPlanes + k) * planeDist + i);
+        }
+    }
+    else
+    {
 #pragma omp parallel for private(i,j,k,l)
-    for (i = 0; i <= MaxRows_ * HalfCols_ - step; i += step)
-        for (j = 0; j < nbFilters; ++j)
-            for (k = 0; k < nbPlanes; ++k)
-                for (l = 0; l < step; ++l)
-                    sums[j][k](i + l) =
-                        filters[j].first.cell(i + l).cwiseProduct(planes_[k].cell(i + l)).sum();
-    
-    for (i = MaxRows_ * HalfCols_ - ((MaxRows_ * HalfCols_) % step); i < MaxRows_ * HalfCols_; ++i)
-        for (j = 0; j < nbFilters; ++j)
-            for (k = 0; k < nbPlanes; ++k)
-                sums[j][k](i) = filters[j].first.cell(i).cwiseProduct(planes_[k].cell(i)).sum();
+        for (i = 0; i <= maxRows * halfCols - step; i += step)
+            for (j = 0; j < nbFilters; ++j)
+                for (k = 0; k < nbPlanes; ++k)
+                    for (l = 0; l < step; ++l)
+                        sums[(j * nbPlanes + k) * planeDist + i + l] =
+                            filters[j]->first.cell(i + l).cwiseProduct(planes_[k].cell(i + l)).sum();
+        
+        for (i = maxRows * halfCols - ((maxRows * halfCols) % step); i < maxRows * halfCols; ++i)
+            for (j = 0; j < nbFilters; ++j)
+                for (k = 0; k < nbPlanes; ++k)
+                    sums[(j * nbPlanes + k) * planeDist + i] = filters[j]->first.cell(i).cwiseProduct(planes_[k].cell(i)).sum();
+    }
     
     // Transform back the results and store them in convolutions
     convolutions.resize(nbFilters);
     for (i = 0; i < nbFilters; ++i)
         convolutions[i].resize(nbLevels);
     
-#pragma omp parallel for private(i,j)
-    for (i = 0; i < nbFilters * nbPlanes; ++i)
+    // Crops the levels from a transformed product
+    auto extractLevels = [&](int t)
     {
-        const int f = i / nbPlanes; // Filter index
-        const int p = i % nbPlanes; // Plane index
+        const int f = t / nbPlanes; // Filter index
+        const int p = t % nbPlanes; // Plane index
         
-        Eigen::Map<ScalarMatrix> output(reinterpret_cast<FeatureScalar*>(sums[f][p].data()),
-                                 MaxRows_, HalfCols_ * 2);
+        Eigen::Map<ScalarMatrix> output(reinterpret_cast<FeatureScalar*>(sums + t * planeDist),
+                                        maxRows, halfCols * 2);
         
-        fftwf_execute_dft_c2r(Inverse_, reinterpret_cast<fftwf_complex *>(sums[f][p].data()),
-                              output.data());
-        
-        for (j = 0; j < nbLevels; ++j)
+        for (int j = 0; j < nbLevels; ++j)
             if (rectangles_[j].plane() == p)
             {
                 const int rows = rectangles_[j].height() - padding_.height;
@@ -181,107 +224,46 @@ void Patchwork::convolve(const vector<Filter> & filters,
                     convolutions[f][j] = output.block(y, x, rows, cols);
                 }
             }
-    }
-}
-
-bool Patchwork::Init(int maxRows, int maxCols, int numFeatures)
-{
-    // It is an error if maxRows or maxCols are too small
-    if ((maxRows < 2) || (maxCols < 2))
-        return false;
-    
-    // Temporary matrices
-    FeatureMatrix tmp(maxRows, maxCols + 2, numFeatures); // +2 columns required by fftw as padding
-    
-    int dims[2] = {maxRows, maxCols};
-    
-    // Use fftwf_import_wisdom_from_file and not fftwf_import_wisdom_from_filename as old versions
-    // of fftw seem to not include it
-    FILE * file = fopen("wisdom.fftw", "r");
-    
-    if (file) {
-        fftwf_import_wisdom_from_file(file);
-        fclose(file);
-    }
+    };
     
-    const fftwf_plan forwards =
-        fftwf_plan_many_dft_r2c(2, dims, numFeatures, tmp.raw(), 0,
-                                numFeatures, 1,
-                                reinterpret_cast<fftwf_complex *>(tmp.raw()), 0,
-                                numFeatures, 1, FFTW_PATIENT);
-    
-    const fftwf_plan inverse =
-        fftwf_plan_dft_c2r_2d(dims[0], dims[1], reinterpret_cast<fftwf_complex *>(tmp.raw()),
-                              tmp.raw(), FFTW_PATIENT);
-    
-    file = fopen("wisdom.fftw", "w");
-    
-    if (file) {
-        fftwf_export_wisdom_to_file(file);
-        fclose(file);
-    }
-    
-    // If successful, set static variables
-    if (forwards && inverse) {
-        MaxRows_ = maxRows;
-        MaxCols_ = maxCols;
-        HalfCols_ = maxCols / 2 + 1;
-        NumFeat_ = numFeatures;
-        NumInits_++;
-        if (Forwards_ != 0)
-            fftwf_destroy_plan(Forwards_);
-        Forwards_ = forwards;
-        if (Inverse_ != 0)
-            fftwf_destroy_plan(Inverse_);
-        Inverse_ = inverse;
-        return true;
-    }
-    
-    return false;
-}
-
-int Patchwork::MaxRows()
-{
-    return MaxRows_;
-}
-
-int Patchwork::MaxCols()
-{
-    return MaxCols_;
-}
-
-int Patchwork::NumFeatures()
-{
-    return NumFeat_;
-}
-
-int Patchwork::NumInits()
-{
-    return NumInits_;
-}
-
-void Patchwork::TransformFilter(const FeatureMatrix & filter, Filter & result)
-{
-    // Early return if no filter given or if Init was not called or if the filter is too large
-    if (filter.empty() || !MaxRows_ || filter.rows() > MaxRows_ || filter.cols() > MaxCols_ || filter.channels() != NumFeat_)
+    const int nbProducts = nbFilters * nbPlanes;
+    if (context_->useThreadedFFT(nbProducts, true))
     {
-        result = Filter();
+        // Only a few products: Transform them one after another with all threads working on each one
+        for (i = 0; i < nbProducts; ++i)
+        {
+            fftwf_execute_dft_c2r(context_->m_inverseThreaded, reinterpret_cast<fftwf_complex *>(sums + i * planeDist),
+                                  reinterpret_cast<float *>(sums + i * planeDist));
+            extractLevels(i);
+        }
         return;
     }
     
-    // Copy the filter to a plane
-    result.first = Plane(MaxRows_, HalfCols_, Plane::Cell::Zero(NumFeat_));
-    result.second = pair<int, int>(filter.rows(), filter.cols());
-    
-    FeatureMatrix plane(reinterpret_cast<FeatureScalar*>(result.first.raw()),
-                        MaxRows_, HalfCols_ * 2, NumFeat_);
+    // Transform full batches of products with the batched plan and the remaining ones one by one
+    const int batchSize = (context_->m_inverseBatch) ? context_->batchSize() : 1;
+    const int nbBatches = (batchSize > 1) ? nbProducts / batchSize : 0;
+    const int nbItems = nbBatches + (nbProducts - nbBatches * batchSize);
     
-    for (int y = 0; y < filter.rows(); ++y)
-        for (int x = 0; x < filter.cols(); ++x)
-            plane((MaxRows_ - y) % MaxRows_, (MaxCols_ - x) % MaxCols_)
-                    = filter(y, x) / static_cast<FeatureScalar>(MaxRows_ * MaxCols_);
-    
-    // Transform that plane 
-    fftwf_execute_dft_r2c(Forwards_, reinterpret_cast<float *>(plane.raw()),
-                          reinterpret_cast<fftwf_complex *>(result.first.raw()));
+#pragma omp parallel for private(i)
+    for (i = 0; i < nbItems; ++i)
+    {
+        int first, count;
+        if (i < nbBatches)
+        {
+            first = i * batchSize;
+            count = batchSize;
+            fftwf_execute_dft_c2r(context_->m_inverseBatch, reinterpret_cast<fftwf_complex *>(sums + first * planeDist),
+                                  reinterpret_cast<float *>(sums + first * planeDist));
+        }
+        else
+        {
+            first = nbBatches * batchSize + (i - nbBatches);
+            count = 1;
+            fftwf_execute_dft_c2r(context_->m_inverse, reinterpret_cast<fftwf_complex *>(sums + first * planeDist),
+                                  reinterpret_cast<float *>(sums + first * planeDist));
+        }
+        
+        for (int t = first; t < first + count; ++t)
+            extractLevels(t);
+    }
 }
@@ -31,6 +31,8 @@ extern "C" {
 namespace ARTOS
 {
 
+class PatchworkContext;
+
 /**
 * The Patchwork class computes full convolutions much faster than the HOGPyramid class.
 */
@@ -46,6 +48,9 @@ public:
     
     /**
     * Type of a patchwork plane (matrix of complex cells).
+    *
+    * Depending on PatchworkContext::splitLayout(), the complex features of each cell are either
+    * interleaved or all real parts are followed by all imaginary parts.
     */
     typedef FeatureMatrix_<Scalar> Plane;
     
@@ -62,15 +67,18 @@ public:
     /**
     * Constructs a patchwork from a pyramid.
     *
+    * @param[in] context The context providing the FFTW plans and the size of the patchwork planes.
+    * It must outlive this patchwork.
+    *
     * @param[in] pyramid The pyramid of features.
     *
     * @param[in] padding Padding to add between levels from the pyramid in each direction.
     * The padding should be at least half as large as the largest filter.
     *
-    * @note If the pyramid (including padding) is larger than the last maxRows and maxCols passed to the Init method
-    * or it has more features than specified there, the Patchwork will be empty.
+    * @note If the pyramid (including padding) is larger than the maxRows and maxCols the context has been
+    * initialized with or it has more features than specified there, the Patchwork will be empty.
     */
-    Patchwork(const FeaturePyramid & pyramid, const Size & padding);
+    Patchwork(const PatchworkContext & context, const FeaturePyramid & pyramid, const Size & padding);
     
     /**
     * @return Returns the amount of zero padding added between levels from the pyramid
@@ -88,6 +96,11 @@ public:
     */
     bool empty() const;
     
+    /**
+    * @return Returns the number of planes of this patchwork.
+    */
+    int nbPlanes() const { return planes_.size(); };
+    
     /**
     * Computes the convolutions of the patchwork with filters (useful to compute the SVM margins).
     *
@@ -99,52 +112,15 @@ public:
                   std::vector< std::vector<ScalarMatrix> > & convolutions) const;
     
     /**
-    * Initializes the FFTW library.
-    *
-    * @param[in] maxRows Maximum number of rows of a pyramid level (including padding).
-    *
-    * @param[in] maxCols Maximum number of columns of a pyramid level (including padding).
+    * Computes the convolutions of the patchwork with filters given by pointers, so that the
+    * filters of several mixtures can be convolved in a single pass without copying them.
     *
-    * @param[in] numFeatures Number of features per cell.
+    * @param[in] filters Pointers to the filters.
     *
-    * @returns Returns true if the initialization was successful.
-    *
-    * @note Must be called before any other method (including constructors).
-    */
-    static bool Init(int maxRows, int maxCols, int numFeatures);
-    
-    /**
-    * @return Returns the current maximum number of rows of a pyramid level (including padding).
-    */
-    static int MaxRows();
-    
-    /**
-    * @return Returns the current maximum number of columns of a pyramid level (including padding).
-    */
-    static int MaxCols();
-    
-    /**
-    * @return Returns the current number of features per cell.
-    */
-    static int NumFeatures();
-    
-    /**
-    * @return Returns the current number of calls to Init() made so far. This can be used to check
-    * if any cached filters are still up to date.
-    */
-    static int NumInits();
-    
-    /**
-    * Returns a transformed version of a filter to be used by the @c convolve method.
-    *
-    * @param[in] filter Filter to transform.
-    *
-    * @param[out] result Transformed filter.
-    *
-    * @note If Init has not been called yet or if the filter is larger than the last maxRows and
-    * maxCols passed to the Init method, the result will be empty.
+    * @param[out] convolutions The convolutions (filters x levels).
     */
-    static void TransformFilter(const FeatureMatrix & filter, Filter & result);
+    void convolve(const std::vector<const Filter *> & filters,
+                  std::vector< std::vector<ScalarMatrix> > & convolutions) const;
 
 
 private:
@@ -153,15 +129,7 @@ private:
     int interval_;
     std::vector<PatchworkRectangle> rectangles_;
     std::vector<Plane> planes_;
-    
-    static int MaxRows_;
-    static int MaxCols_;
-    static int HalfCols_;
-    static int NumFeat_;
-    static int NumInits_;
-    
-    static fftwf_plan Forwards_;
-    static fftwf_plan Inverse_;
+    const PatchworkContext * context_;
 };
 
 }
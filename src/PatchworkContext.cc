@@ -0,0 +1,897 @@
+#include "PatchworkContext.h"
+#include "Mixture.h"
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+using namespace ARTOS;
+using namespace std;
+
+
+// The FFTW planner is not thread-safe, so plan creation and destruction must be serialized
+// among all contexts.
+static mutex fftwPlannerMutex;
+
+// The in-memory wisdom of FFTW is global and thus shared by all contexts. These variables keep track
+// of the file it is persisted in and are protected by fftwPlannerMutex as well.
+static string wisdomFilename = (getenv("ARTOS_FFTW_WISDOM")) ? getenv("ARTOS_FFTW_WISDOM") : "wisdom.fftw";
+static bool wisdomLoaded = false;
+
+// Number of threads used by multi-threaded plans or 0 if FFTW has not been initialized yet.
+// Protected by fftwPlannerMutex.
+static int fftwThreads = 0;
+
+// Background planners give way to planning in the foreground between two plans, so that contexts
+// do not have to wait for the completion of a background upgrade before they can be used.
+static atomic<int> foregroundPlanners(0);
+
+
+/**
+* Counts a foreground planner as long as an instance of this class exists.
+*/
+class ForegroundPlanning
+{
+public:
+    ForegroundPlanning(bool active) : active(active) { if (active) ++foregroundPlanners; };
+    ~ForegroundPlanning() { if (active) --foregroundPlanners; };
+private:
+    bool active;
+};
+
+
+/**
+* Initializes multi-threaded FFTW, unless this has already been done. FFTW requires this to happen
+* before any other FFTW function is called. fftwPlannerMutex must be held by the caller.
+*/
+static void initFFTW()
+{
+    if (fftwThreads > 0)
+        return;
+#if defined(ARTOS_FFTW_THREADS) && defined(_OPENMP)
+    fftwThreads = (omp_get_max_threads() > 1 && fftwf_init_threads()) ? omp_get_max_threads() : 1;
+#else
+    fftwThreads = 1;
+#endif
+}
+
+
+/**
+* Imports the wisdom file into the in-memory wisdom, unless this has already been done.
+* fftwPlannerMutex must be held by the caller.
+*/
+static void loadWisdom()
+{
+    if (wisdomLoaded)
+        return;
+    wisdomLoaded = true;
+    if (wisdomFilename.empty())
+        return;
+
+    // Use fftwf_import_wisdom_from_file and not fftwf_import_wisdom_from_filename as old versions
+    // of fftw seem to not include it
+    FILE * file = fopen(wisdomFilename.c_str(), "r");
+
+    if (file) {
+        fftwf_import_wisdom_from_file(file);
+        fclose(file);
+    }
+}
+
+
+/**
+* Writes the in-memory wisdom to the wisdom file. fftwPlannerMutex must be held by the caller.
+*
+* @return Returns true if the file has been written.
+*/
+static bool storeWisdom()
+{
+    if (wisdomFilename.empty())
+        return false;
+    initFFTW();
+
+    FILE * file = fopen(wisdomFilename.c_str(), "w");
+
+    if (file) {
+        fftwf_export_wisdom_to_file(file);
+        fclose(file);
+        return true;
+    }
+    return false;
+}
+
+
+/**
+* Determines the number of threads to be used by multi-threaded plans. initFFTW() must have been called
+* before and fftwPlannerMutex must be held by the caller.
+*
+* @return Returns the number of threads for multi-threaded plans or 1 if they are not available.
+*/
+static int initFFTWThreads()
+{
+    return max(fftwThreads, 1);
+}
+
+
+#ifdef ARTOS_FFTW_THREADS
+/**
+* Measures the average time of executing an FFTW plan on the array it has been created for.
+*/
+static double timePlan(const fftwf_plan plan, int repetitions = 3)
+{
+    fftwf_execute(plan); // warm up
+    const chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+    for (int i = 0; i < repetitions; ++i)
+        fftwf_execute(plan);
+    return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / repetitions;
+}
+#endif
+
+
+PatchworkContext::FFTPlans::FFTPlans()
+: forwards(0), inverse(0), forwardsBatch(0), inverseBatch(0), forwardsThreaded(0), inverseThreaded(0),
+  fftThreads(1), forwardsSpeedup(1.0), inverseSpeedup(1.0), rigor(PlanningRigor::ESTIMATE)
+{}
+
+
+void PatchworkContext::FFTPlans::destroy()
+{
+    fftwf_plan plans[] = { forwards, inverse, forwardsBatch, inverseBatch, forwardsThreaded, inverseThreaded };
+    for (fftwf_plan plan : plans)
+        if (plan != 0)
+            fftwf_destroy_plan(plan);
+    *this = FFTPlans();
+}
+
+
+PatchworkContext::PatchworkContext()
+: m_maxRows(0), m_maxCols(0), m_halfCols(0), m_numFeat(0), m_numInits(0),
+  m_batchSize(1), m_planeDist(0), m_filterDist(0),
+  m_forwards(0), m_inverse(0), m_forwardsBatch(0), m_inverseBatch(0), m_forwardsThreaded(0), m_inverseThreaded(0),
+  m_fftThreads(1), m_forwardsSpeedup(1.0), m_inverseSpeedup(1.0),
+  m_rigor(PlanningRigor::PATIENT), m_backgroundUpgrade(false), m_currentRigor(PlanningRigor::PATIENT),
+  m_upgradeGeneration(0), m_upgradeRunning(false), m_upgradeReady(false),
+  m_simdLevel(SIMDLevel::NONE), m_kernel(0),
+  m_cachePolicy(FilterCachePolicy::FULL), m_cacheBudget(0), m_cacheMemory(0), m_cacheClock(0)
+{
+    this->setSIMDLevel(detectSIMDLevel());
+}
+
+
+PatchworkContext::~PatchworkContext()
+{
+    this->cancelUpgrade();
+    for (thread & upgradeThread : this->m_upgradeThreads)
+        upgradeThread.join();
+    lock_guard<mutex> lock(fftwPlannerMutex);
+    fftwf_plan plans[] = { this->m_forwards, this->m_inverse, this->m_forwardsBatch, this->m_inverseBatch,
+                           this->m_forwardsThreaded, this->m_inverseThreaded };
+    for (fftwf_plan plan : plans)
+        if (plan != 0)
+            fftwf_destroy_plan(plan);
+}
+
+
+bool PatchworkContext::init(int maxRows, int maxCols, int numFeatures, int batchSize)
+{
+    // It is an error if maxRows or maxCols are too small
+    if ((maxRows < 2) || (maxCols < 2) || (numFeatures < 1))
+        return false;
+    batchSize = max(batchSize, 1);
+
+    // Plans of a pending upgrade are useless for the new geometry
+    this->cancelUpgrade();
+
+    // Create plans with the requested rigor right now or, if a background upgrade is desired,
+    // only if they can be obtained from wisdom quickly
+    FFTPlans plans;
+    bool upgrade = false;
+    if (this->m_backgroundUpgrade && this->m_rigor != PlanningRigor::ESTIMATE)
+    {
+        if (!createPlans(maxRows, maxCols, numFeatures, batchSize, this->m_rigor, true, false, plans))
+        {
+            if (!createPlans(maxRows, maxCols, numFeatures, batchSize, PlanningRigor::ESTIMATE, false, false, plans))
+                return false;
+            upgrade = true;
+        }
+    }
+    else if (!createPlans(maxRows, maxCols, numFeatures, batchSize, this->m_rigor, false, false, plans))
+        return false;
+
+    // Replace the plans of this context
+    {
+        lock_guard<mutex> lock(fftwPlannerMutex);
+        this->adoptPlans(plans);
+    }
+    const int halfCols = maxCols / 2 + 1;
+    this->m_maxRows = maxRows;
+    this->m_maxCols = maxCols;
+    this->m_halfCols = halfCols;
+    this->m_numFeat = numFeatures;
+    this->m_numInits++;
+    this->m_batchSize = batchSize;
+    // Pad distances between batched planes to multiples of 8 complex numbers to keep them aligned
+    this->m_planeDist = (maxRows * halfCols + 7) & ~7;
+    this->m_filterDist = (maxRows * halfCols * numFeatures + 7) & ~7;
+    this->clearFilters();
+
+    // Plan with the requested rigor in the background. The transforms computed by the upgraded plans
+    // are the same, so filters transformed in the meantime remain valid.
+    if (upgrade)
+    {
+        const PlanningRigor rigor = this->m_rigor;
+        int generation;
+        vector<thread::id> finished;
+        {
+            lock_guard<mutex> lock(this->m_upgradeMutex);
+            generation = this->m_upgradeGeneration;
+            this->m_upgradeRunning = true;
+            finished.swap(this->m_finishedUpgrades);
+        }
+        
+        // Join the planners of previous initializations which have finished, so that they don't pile up
+        for (const thread::id & id : finished)
+            for (vector<thread>::iterator it = this->m_upgradeThreads.begin(); it != this->m_upgradeThreads.end(); ++it)
+                if (it->get_id() == id)
+                {
+                    it->join();
+                    this->m_upgradeThreads.erase(it);
+                    break;
+                }
+        
+        this->m_upgradeThreads.push_back(thread([this, maxRows, maxCols, numFeatures, batchSize, rigor, generation]()
+        {
+            FFTPlans upgradedPlans;
+            const bool success = createPlans(maxRows, maxCols, numFeatures, batchSize, rigor, false, true, upgradedPlans);
+            lock_guard<mutex> lock(this->m_upgradeMutex);
+            if (generation == this->m_upgradeGeneration)
+            {
+                this->m_upgradeRunning = false;
+                if (success)
+                {
+                    this->m_upgradedPlans = upgradedPlans;
+                    this->m_upgradeReady = true;
+                }
+            }
+            else
+            {
+                // The geometry has changed in the meantime, but the wisdom gained is not lost
+                lock_guard<mutex> plannerLock(fftwPlannerMutex);
+                upgradedPlans.destroy();
+            }
+            this->m_finishedUpgrades.push_back(this_thread::get_id());
+        }));
+    }
+    return true;
+}
+
+
+bool PatchworkContext::createPlans(int maxRows, int maxCols, int numFeatures, int batchSize,
+                                   PlanningRigor rigor, bool wisdomOnly, bool background, FFTPlans & plans)
+{
+    plans = FFTPlans();
+    plans.rigor = rigor;
+    unsigned int flags;
+    switch (rigor)
+    {
+        case PlanningRigor::ESTIMATE: flags = FFTW_ESTIMATE; break;
+        case PlanningRigor::MEASURE: flags = FFTW_MEASURE; break;
+        default: flags = FFTW_PATIENT; break;
+    }
+    if (wisdomOnly)
+        flags |= FFTW_WISDOM_ONLY;
+
+    // Temporary matrices
+    FeatureMatrix tmp(maxRows, maxCols + 2, numFeatures); // +2 columns required by fftw as padding
+
+    int dims[2] = {maxRows, maxCols};
+    const int halfCols = maxCols / 2 + 1;
+    const int planeDist = (maxRows * halfCols + 7) & ~7;
+    const int filterDist = (maxRows * halfCols * numFeatures + 7) & ~7;
+
+    ForegroundPlanning foreground(!background);
+    unique_lock<mutex> lock(fftwPlannerMutex);
+    initFFTW();
+    loadWisdom();
+
+    // Lets waiting foreground planners go first when planning in the background
+    auto giveWay = [&lock, background]()
+    {
+        if (background)
+        {
+            lock.unlock();
+            do
+                this_thread::yield();
+            while (foregroundPlanners > 0);
+            lock.lock();
+        }
+    };
+
+    plans.forwards = fftwf_plan_many_dft_r2c(2, dims, numFeatures, tmp.raw(), 0,
+                                             numFeatures, 1,
+                                             reinterpret_cast<fftwf_complex *>(tmp.raw()), 0,
+                                             numFeatures, 1, flags);
+    giveWay();
+
+    plans.inverse = fftwf_plan_dft_c2r_2d(dims[0], dims[1], reinterpret_cast<fftwf_complex *>(tmp.raw()),
+                                          tmp.raw(), flags);
+
+    // Batched plans
+    if (batchSize > 1 && plans.forwards && plans.inverse)
+    {
+        giveWay();
+        fftwf_complex * batchBuffer = static_cast<fftwf_complex*>(fftwf_malloc(
+                static_cast<size_t>(batchSize) * max(filterDist, planeDist) * sizeof(fftwf_complex)));
+        if (batchBuffer)
+        {
+            // Filters: transform all features of batchSize filters at once (in-place, interleaved features)
+            const fftwf_iodim filterDims[2] = {
+                { maxRows, 2 * halfCols * numFeatures, halfCols * numFeatures },
+                { maxCols, numFeatures, numFeatures }
+            };
+            const fftwf_iodim filterBatchDims[2] = {
+                { batchSize, 2 * filterDist, filterDist },
+                { numFeatures, 1, 1 }
+            };
+            plans.forwardsBatch = fftwf_plan_guru_dft_r2c(2, filterDims, 2, filterBatchDims,
+                                                          reinterpret_cast<float*>(batchBuffer), batchBuffer, flags);
+            giveWay();
+            
+            // Products of filters and planes: transform batchSize single-channel planes back at once (in-place)
+            plans.inverseBatch = fftwf_plan_many_dft_c2r(2, dims, batchSize, batchBuffer, 0, 1, planeDist,
+                                                         reinterpret_cast<float*>(batchBuffer), 0, 1, 2 * planeDist,
+                                                         flags);
+            
+            fftwf_free(batchBuffer);
+        }
+    }
+
+    // Multi-threaded plans for transforming single planes with all threads
+    const int fftThreads = initFFTWThreads();
+#ifdef ARTOS_FFTW_THREADS
+    if (fftThreads > 1 && plans.forwards && plans.inverse)
+    {
+        giveWay();
+        fftwf_plan_with_nthreads(fftThreads);
+        plans.forwardsThreaded = fftwf_plan_many_dft_r2c(2, dims, numFeatures, tmp.raw(), 0,
+                                                         numFeatures, 1,
+                                                         reinterpret_cast<fftwf_complex *>(tmp.raw()), 0,
+                                                         numFeatures, 1, flags);
+        plans.inverseThreaded = fftwf_plan_dft_c2r_2d(dims[0], dims[1], reinterpret_cast<fftwf_complex *>(tmp.raw()),
+                                                      tmp.raw(), flags);
+        fftwf_plan_with_nthreads(1);
+        
+        // Measure the speed-up for the cost model
+        if (plans.forwardsThreaded && plans.inverseThreaded)
+        {
+            plans.fftThreads = fftThreads;
+            tmp.setZero();
+            plans.forwardsSpeedup = timePlan(plans.forwards) / max(timePlan(plans.forwardsThreaded), 1e-9);
+            tmp.setZero();
+            plans.inverseSpeedup = timePlan(plans.inverse) / max(timePlan(plans.inverseThreaded), 1e-9);
+        }
+        else
+        {
+            // Without wisdom for the threaded plans, simply do without them
+            if (plans.forwardsThreaded)
+                fftwf_destroy_plan(plans.forwardsThreaded);
+            if (plans.inverseThreaded)
+                fftwf_destroy_plan(plans.inverseThreaded);
+            plans.forwardsThreaded = plans.inverseThreaded = 0;
+        }
+    }
+#endif
+
+    if (!plans.forwards || !plans.inverse || (batchSize > 1 && (!plans.forwardsBatch || !plans.inverseBatch)))
+    {
+        plans.destroy();
+        return false;
+    }
+
+    // Persist what the planner has learned
+    if (rigor != PlanningRigor::ESTIMATE && !wisdomOnly)
+        storeWisdom();
+    return true;
+}
+
+
+void PatchworkContext::adoptPlans(const FFTPlans & plans)
+{
+    FFTPlans oldPlans;
+    oldPlans.forwards = this->m_forwards;
+    oldPlans.inverse = this->m_inverse;
+    oldPlans.forwardsBatch = this->m_forwardsBatch;
+    oldPlans.inverseBatch = this->m_inverseBatch;
+    oldPlans.forwardsThreaded = this->m_forwardsThreaded;
+    oldPlans.inverseThreaded = this->m_inverseThreaded;
+    oldPlans.destroy();
+    this->m_forwards = plans.forwards;
+    this->m_inverse = plans.inverse;
+    this->m_forwardsBatch = plans.forwardsBatch;
+    this->m_inverseBatch = plans.inverseBatch;
+    this->m_forwardsThreaded = plans.forwardsThreaded;
+    this->m_inverseThreaded = plans.inverseThreaded;
+    this->m_fftThreads = plans.fftThreads;
+    this->m_forwardsSpeedup = plans.forwardsSpeedup;
+    this->m_inverseSpeedup = plans.inverseSpeedup;
+    this->m_currentRigor = plans.rigor;
+}
+
+
+void PatchworkContext::cancelUpgrade()
+{
+    lock_guard<mutex> lock(this->m_upgradeMutex);
+    this->m_upgradeGeneration++;
+    this->m_upgradeRunning = false;
+    if (this->m_upgradeReady)
+    {
+        lock_guard<mutex> plannerLock(fftwPlannerMutex);
+        this->m_upgradedPlans.destroy();
+        this->m_upgradeReady = false;
+    }
+}
+
+
+void PatchworkContext::setPlanningRigor(PlanningRigor rigor, bool backgroundUpgrade)
+{
+    this->m_rigor = rigor;
+    this->m_backgroundUpgrade = backgroundUpgrade;
+}
+
+
+bool PatchworkContext::upgradePlans()
+{
+    lock_guard<mutex> lock(this->m_upgradeMutex);
+    if (!this->m_upgradeReady)
+        return false;
+    lock_guard<mutex> plannerLock(fftwPlannerMutex);
+    this->adoptPlans(this->m_upgradedPlans);
+    this->m_upgradedPlans = FFTPlans();
+    this->m_upgradeReady = false;
+    return true;
+}
+
+
+bool PatchworkContext::upgradePending() const
+{
+    lock_guard<mutex> lock(this->m_upgradeMutex);
+    return (this->m_upgradeReady || this->m_upgradeRunning);
+}
+
+
+void PatchworkContext::setWisdomFile(const string & filename)
+{
+    lock_guard<mutex> lock(fftwPlannerMutex);
+    if (filename != wisdomFilename)
+    {
+        wisdomFilename = filename;
+        wisdomLoaded = false;
+    }
+}
+
+
+string PatchworkContext::wisdomFile()
+{
+    lock_guard<mutex> lock(fftwPlannerMutex);
+    return wisdomFilename;
+}
+
+
+bool PatchworkContext::importWisdom(const string & wisdom)
+{
+    lock_guard<mutex> lock(fftwPlannerMutex);
+    initFFTW();
+    return (fftwf_import_wisdom_from_string(wisdom.c_str()) != 0);
+}
+
+
+string PatchworkContext::exportWisdom()
+{
+    lock_guard<mutex> lock(fftwPlannerMutex);
+    initFFTW();
+    char * wisdom = fftwf_export_wisdom_to_string();
+    if (!wisdom)
+        return "";
+    string result(wisdom);
+    free(wisdom);
+    return result;
+}
+
+
+bool PatchworkContext::saveWisdom()
+{
+    lock_guard<mutex> lock(fftwPlannerMutex);
+    return storeWisdom();
+}
+
+
+unique_lock<mutex> PatchworkContext::plannerLock()
+{
+    unique_lock<mutex> lock(fftwPlannerMutex);
+    initFFTW();
+    return lock;
+}
+
+
+bool PatchworkContext::useThreadedFFT(int nbTransforms, bool inverse) const
+{
+    // The multi-threaded plans always use m_fftThreads threads, which would oversubscribe the CPU if the
+    // calling thread has been restricted to fewer threads, e.g. by a worker of DPMDetection::detectBatch()
+    if (this->m_fftThreads <= 1 || nbTransforms <= 0 || nbTransforms >= this->m_fftThreads)
+        return false;
+#ifdef _OPENMP
+    if (omp_get_max_threads() < this->m_fftThreads)
+        return false;
+#endif
+    const double interPlaneCost = ceil(static_cast<double>(nbTransforms) / this->m_fftThreads);
+    const double intraPlaneCost = nbTransforms / ((inverse) ? this->m_inverseSpeedup : this->m_forwardsSpeedup);
+    return (intraPlaneCost < interPlaneCost);
+}
+
+
+void PatchworkContext::setSIMDLevel(SIMDLevel level)
+{
+    level = min(level, detectSIMDLevel());
+    if (level != this->m_simdLevel)
+        this->clearFilters();
+    this->m_simdLevel = level;
+    this->m_kernel = complexMACKernel(level);
+}
+
+
+void PatchworkContext::transformFilter(const FeatureMatrix & filter, Patchwork::Filter & result) const
+{
+    // Early return if no filter given or if init was not called or if the filter is too large
+    if (filter.empty() || !this->m_maxRows || filter.rows() > this->m_maxRows || filter.cols() > this->m_maxCols
+            || filter.channels() != this->m_numFeat)
+    {
+        result = Patchwork::Filter();
+        return;
+    }
+
+    // Copy the filter to a plane
+    result.first = Patchwork::Plane(this->m_maxRows, this->m_halfCols, Patchwork::Plane::Cell::Zero(this->m_numFeat));
+    result.second = pair<int, int>(filter.rows(), filter.cols());
+
+    FeatureMatrix plane(reinterpret_cast<FeatureScalar*>(result.first.raw()),
+                        this->m_maxRows, this->m_halfCols * 2, this->m_numFeat);
+
+    for (int y = 0; y < filter.rows(); ++y)
+        for (int x = 0; x < filter.cols(); ++x)
+            plane((this->m_maxRows - y) % this->m_maxRows, (this->m_maxCols - x) % this->m_maxCols)
+                    = filter(y, x) / static_cast<FeatureScalar>(this->m_maxRows * this->m_maxCols);
+
+    // Transform that plane
+    fftwf_execute_dft_r2c(this->m_forwards, reinterpret_cast<float *>(plane.raw()),
+                          reinterpret_cast<fftwf_complex *>(result.first.raw()));
+    if (this->splitLayout())
+        splitComplexCells(result.first.raw(), this->m_maxRows * this->m_halfCols, this->m_numFeat);
+}
+
+
+void PatchworkContext::transformFilters(const vector<const FeatureMatrix *> & filters, FilterList & results) const
+{
+    const int nbFilters = filters.size();
+    results.resize(nbFilters);
+    if (!this->m_maxRows)
+        return;
+    
+    // Transform full batches with the batched plan and the remaining filters one by one
+    const int batchSize = (this->m_forwardsBatch) ? this->m_batchSize : 1;
+    const int nbBatches = nbFilters / batchSize;
+    const int nbItems = nbBatches + nbFilters % batchSize;
+    const int planeSize = this->m_maxRows * this->m_halfCols * this->m_numFeat;
+    int i;
+    #pragma omp parallel for private(i)
+    for (i = 0; i < nbItems; ++i)
+    {
+        if (batchSize == 1 || i >= nbBatches)
+        {
+            const int f = nbBatches * batchSize + (i - nbBatches);
+            this->transformFilter(*(filters[f]), results[f]);
+            continue;
+        }
+        
+        Patchwork::Scalar * buffer = static_cast<Patchwork::Scalar*>(fftwf_malloc(
+                static_cast<size_t>(batchSize) * this->m_filterDist * sizeof(Patchwork::Scalar)));
+        if (!buffer)
+        {
+            for (int f = i * batchSize; f < (i + 1) * batchSize; ++f)
+                this->transformFilter(*(filters[f]), results[f]);
+            continue;
+        }
+        fill(buffer, buffer + static_cast<size_t>(batchSize) * this->m_filterDist, Patchwork::Scalar(0));
+        
+        // Copy the filters to the planes of the batch
+        for (int b = 0; b < batchSize; ++b)
+        {
+            const FeatureMatrix & filter = *(filters[i * batchSize + b]);
+            if (filter.empty() || filter.rows() > this->m_maxRows || filter.cols() > this->m_maxCols
+                    || filter.channels() != this->m_numFeat)
+                continue;
+            
+            FeatureMatrix plane(reinterpret_cast<FeatureScalar*>(buffer + b * this->m_filterDist),
+                                this->m_maxRows, this->m_halfCols * 2, this->m_numFeat);
+            
+            for (int y = 0; y < filter.rows(); ++y)
+                for (int x = 0; x < filter.cols(); ++x)
+                    plane((this->m_maxRows - y) % this->m_maxRows, (this->m_maxCols - x) % this->m_maxCols)
+                            = filter(y, x) / static_cast<FeatureScalar>(this->m_maxRows * this->m_maxCols);
+        }
+        
+        // Transform the batch
+        fftwf_execute_dft_r2c(this->m_forwardsBatch, reinterpret_cast<float *>(buffer),
+                              reinterpret_cast<fftwf_complex *>(buffer));
+        
+        // Store the transformed filters
+        for (int b = 0; b < batchSize; ++b)
+        {
+            const FeatureMatrix & filter = *(filters[i * batchSize + b]);
+            Patchwork::Filter & result = results[i * batchSize + b];
+            if (filter.empty() || filter.rows() > this->m_maxRows || filter.cols() > this->m_maxCols
+                    || filter.channels() != this->m_numFeat)
+            {
+                result = Patchwork::Filter();
+                continue;
+            }
+            
+            result.first = Patchwork::Plane(this->m_maxRows, this->m_halfCols, this->m_numFeat);
+            result.second = pair<int, int>(filter.rows(), filter.cols());
+            copy(buffer + b * this->m_filterDist, buffer + b * this->m_filterDist + planeSize, result.first.raw());
+            if (this->splitLayout())
+                splitComplexCells(result.first.raw(), this->m_maxRows * this->m_halfCols, this->m_numFeat);
+        }
+        
+        fftwf_free(buffer);
+    }
+}
+
+
+shared_ptr<const PatchworkContext::FilterList> PatchworkContext::filters(const Mixture & mixture)
+{
+    lock_guard<mutex> lock(this->m_filterCacheMutex);
+    const size_t planeSize = static_cast<size_t>(this->m_maxRows) * this->m_halfCols * this->m_numFeat;
+
+    map<unsigned long, CacheEntry>::iterator cached = this->m_filterCache.find(mixture.id());
+    if (cached != this->m_filterCache.end())
+    {
+        CacheEntry & entry = cached->second;
+        entry.lastUse = ++this->m_cacheClock;
+        if (entry.filters)
+            return entry.filters;
+        
+        // Restore the filters from half precision
+        shared_ptr<FilterList> filters = make_shared<FilterList>(entry.halfFilters.size());
+        for (size_t i = 0; i < entry.halfFilters.size(); ++i)
+            if (!entry.halfFilters[i].empty())
+            {
+                Patchwork::Filter & filter = (*filters)[i];
+                filter.first = Patchwork::Plane(this->m_maxRows, this->m_halfCols, this->m_numFeat);
+                filter.second = entry.sizes[i];
+                halfToFloat(entry.halfFilters[i].data(), reinterpret_cast<float*>(filter.first.raw()),
+                            2 * planeSize, entry.halfScales[i]);
+            }
+        return filters;
+    }
+
+    // Collect the filters of all parts of all models
+    vector<const FeatureMatrix *> parts;
+    for (const Model & model : mixture.models())
+        for (int i = 0; i <= model.nbParts(); ++i)
+            parts.push_back(&model.filters(i));
+
+    // Transform all the filters
+    shared_ptr<FilterList> filters = make_shared<FilterList>();
+    this->transformFilters(parts, *filters);
+    if (this->m_cachePolicy == FilterCachePolicy::ON_THE_FLY)
+        return filters;
+
+    // Store them in the cache
+    CacheEntry & entry = this->m_filterCache[mixture.id()];
+    entry.lastUse = ++this->m_cacheClock;
+    if (this->m_cachePolicy == FilterCachePolicy::HALF_PRECISION)
+    {
+        entry.halfFilters.resize(filters->size());
+        entry.halfScales.assign(filters->size(), 0.0f);
+        entry.sizes.resize(filters->size());
+        entry.bytes = 0;
+        for (size_t i = 0; i < filters->size(); ++i)
+        {
+            const Patchwork::Filter & filter = (*filters)[i];
+            entry.sizes[i] = filter.second;
+            if (filter.first.empty())
+                continue;
+            
+            // Scale the filter so that its largest component is 2^15, leaving 30 binades below it
+            // for the normal numbers of half precision
+            const float * data = reinterpret_cast<const float*>(filter.first.raw());
+            float maxAbs = 0.0f;
+            for (size_t j = 0; j < 2 * planeSize; ++j)
+                maxAbs = max(maxAbs, fabs(data[j]));
+            const float scale = (maxAbs > 0.0f) ? 32768.0f / maxAbs : 1.0f;
+            entry.halfScales[i] = 1.0f / scale;
+            entry.halfFilters[i].resize(2 * planeSize);
+            floatToHalf(data, entry.halfFilters[i].data(), 2 * planeSize, scale);
+            entry.bytes += entry.halfFilters[i].size() * sizeof(uint16_t);
+        }
+    }
+    else
+    {
+        entry.filters = filters;
+        entry.bytes = 0;
+        for (const Patchwork::Filter & filter : *filters)
+            entry.bytes += static_cast<size_t>(filter.first.numEl()) * sizeof(Patchwork::Scalar);
+    }
+    this->m_cacheMemory += entry.bytes;
+    this->evictFilters(mixture.id());
+
+    return filters;
+}
+
+
+bool PatchworkContext::hasFilters(const Mixture & mixture) const
+{
+    lock_guard<mutex> lock(this->m_filterCacheMutex);
+    return (this->m_filterCache.find(mixture.id()) != this->m_filterCache.end());
+}
+
+
+void PatchworkContext::releaseFilters(const Mixture & mixture)
+{
+    lock_guard<mutex> lock(this->m_filterCacheMutex);
+    map<unsigned long, CacheEntry>::iterator cached = this->m_filterCache.find(mixture.id());
+    if (cached != this->m_filterCache.end())
+    {
+        this->m_cacheMemory -= cached->second.bytes;
+        this->m_filterCache.erase(cached);
+    }
+}
+
+
+void PatchworkContext::clearFilters()
+{
+    lock_guard<mutex> lock(this->m_filterCacheMutex);
+    this->m_filterCache.clear();
+    this->m_cacheMemory = 0;
+}
+
+
+void PatchworkContext::setFilterCachePolicy(FilterCachePolicy policy, size_t budget)
+{
+    if (policy != this->m_cachePolicy)
+        this->clearFilters();
+    
+    lock_guard<mutex> lock(this->m_filterCacheMutex);
+    this->m_cachePolicy = policy;
+    this->m_cacheBudget = budget;
+    this->evictFilters(0);
+}
+
+
+size_t PatchworkContext::filterCacheMemory() const
+{
+    lock_guard<mutex> lock(this->m_filterCacheMutex);
+    return this->m_cacheMemory;
+}
+
+
+void PatchworkContext::evictFilters(unsigned long keep)
+{
+    while (this->m_cacheBudget > 0 && this->m_cacheMemory > this->m_cacheBudget)
+    {
+        map<unsigned long, CacheEntry>::iterator lru = this->m_filterCache.end();
+        for (map<unsigned long, CacheEntry>::iterator entry = this->m_filterCache.begin(); entry != this->m_filterCache.end(); ++entry)
+            if (entry->first != keep && (lru == this->m_filterCache.end() || entry->second.lastUse < lru->second.lastUse))
+                lru = entry;
+        if (lru == this->m_filterCache.end())
+            break;
+        this->m_cacheMemory -= lru->second.bytes;
+        this->m_filterCache.erase(lru);
+    }
+}
+
+
+bool PatchworkContext::isFFTFriendly(int n)
+{
+    if (n < 1)
+        return false;
+    const int primes[] = { 2, 3, 5, 7 };
+    for (int p : primes)
+        while (n % p == 0)
+            n /= p;
+    return (n == 1);
+}
+
+
+/**
+* Estimates the number of operations of an FFT of a given length relative to `N * log2(N)`.
+* Each prime factor contributes `log2(p)`, weighted by the relative inefficiency of its codelets.
+*/
+static double fftLogFactor(int n)
+{
+    const int primes[] = { 2, 3, 5, 7 };
+    const double weights[] = { 1.0, 1.1, 1.2, 1.35 };
+    double factor = 0.0;
+    for (int i = 0; i < 4; ++i)
+        for (; n % primes[i] == 0; n /= primes[i])
+            factor += weights[i] * log2(static_cast<double>(primes[i]));
+    if (n > 1)
+        factor += 2.0 * log2(static_cast<double>(n)); // bad sizes are handled by FFTW with generic algorithms
+    return factor;
+}
+
+
+double PatchworkContext::estimateCost(const Size & planeSize, int numPlanes, int numFeatures, int numFilters)
+{
+    const double numCells = static_cast<double>(planeSize.height) * planeSize.width;
+    const double halfCells = static_cast<double>(planeSize.height) * (planeSize.width / 2 + 1);
+    // Real-to-complex and complex-to-real transforms need about half the work of complex ones
+    const double fftCost = 2.5 * numCells * (fftLogFactor(planeSize.height) + fftLogFactor(planeSize.width));
+    const double forwardsCost = numFeatures * fftCost;
+    const double productsCost = 8.0 * numFilters * numFeatures * halfCells; // complex multiply-accumulate
+    const double inverseCost = numFilters * fftCost;
+    return numPlanes * (forwardsCost + productsCost + inverseCost);
+}
+
+
+Size PatchworkContext::choosePlaneSize(const vector<Size> & levels, const Size & padding, int numFeatures,
+                                       int numFilters, const Size & minSize, int * numPlanes)
+{
+    if (levels.empty())
+    {
+        if (numPlanes != NULL)
+            *numPlanes = 0;
+        return Size();
+    }
+
+    // Determine the sizes of the rectangles to be packed and the minimum plane size
+    vector<PatchworkRectangle> rectangles(levels.size());
+    Size minPlaneSize = max(minSize, Size(2));
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        rectangles[i].setWidth(levels[i].width + padding.width);
+        rectangles[i].setHeight(levels[i].height + padding.height);
+        minPlaneSize = max(minPlaneSize, Size(rectangles[i].width(), rectangles[i].height()));
+    }
+
+    // Enumerate FFT-friendly candidates for both dimensions
+    vector<int> candidateRows, candidateCols;
+    for (int n = minPlaneSize.height; n <= 2 * minPlaneSize.height; ++n)
+        if (isFFTFriendly(n))
+            candidateRows.push_back(n);
+    for (int n = minPlaneSize.width + (minPlaneSize.width & 1); n <= 2 * minPlaneSize.width; n += 2)
+        if (isFFTFriendly(n))
+            candidateCols.push_back(n);
+
+    // Pack the levels into planes of each candidate size and pick the cheapest one
+    Size bestSize;
+    int bestPlanes = 0;
+    double bestCost = 0.0;
+    for (int rows : candidateRows)
+        for (int cols : candidateCols)
+        {
+            // Skip the packing if even the least possible number of planes would not pay off
+            if (bestPlanes > 0 && estimateCost(Size(cols, rows), PackingLowerBound(rectangles, cols, rows),
+                                               numFeatures, numFilters) >= bestCost)
+                continue;
+            const int planes = PackRectangles(rectangles, cols, rows);
+            if (planes <= 0)
+                continue;
+            const double cost = estimateCost(Size(cols, rows), planes, numFeatures, numFilters);
+            if (bestPlanes == 0 || cost < bestCost)
+            {
+                bestSize = Size(cols, rows);
+                bestPlanes = planes;
+                bestCost = cost;
+            }
+        }
+
+    if (numPlanes != NULL)
+        *numPlanes = bestPlanes;
+    return bestSize;
+}
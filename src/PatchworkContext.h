@@ -0,0 +1,543 @@
+#ifndef ARTOS_PATCHWORKCONTEXT_H
+#define ARTOS_PATCHWORKCONTEXT_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Patchwork.h"
+#include "PatchworkKernels.h"
+
+namespace ARTOS
+{
+
+class Mixture;
+
+/**
+* Policies for keeping the transformed filters of mixtures in a PatchworkContext.
+*/
+enum class FilterCachePolicy
+{
+    FULL,           /**< Keep the transformed filters in single precision (fastest, but needs the most memory). */
+    HALF_PRECISION, /**< Keep the transformed filters in half precision and convert them back whenever they are used. */
+    ON_THE_FLY      /**< Do not keep any transformed filters, but transform them in batches whenever they are used. */
+};
+
+/**
+* Rigor of the FFTW planner, i.e. how much time is spent on finding the fastest way to compute a transform.
+*/
+enum class PlanningRigor
+{
+    ESTIMATE, /**< Choose a plan heuristically without measuring (fast to plan, slower to execute). */
+    MEASURE,  /**< Measure a moderate number of candidate plans. */
+    PATIENT   /**< Measure a large number of candidate plans (slow to plan, fastest to execute). */
+};
+
+/**
+* Holds the state needed by the Patchwork class to compute convolutions in the Fourier domain:
+* the FFTW plans, the size of the patchwork planes and the transformed filters of the mixtures
+* which have been convolved with patchworks of this context.
+*
+* Multiple contexts may coexist (e.g. one per DPMDetection instance), so that detectors processing
+* images of different size or using different feature extractors do not invalidate each other's
+* plans and cached filters.
+*/
+class PatchworkContext
+{
+
+public:
+
+    /**
+    * Type of a list of transformed filters.
+    */
+    typedef std::vector<Patchwork::Filter> FilterList;
+    
+    /**
+    * Constructs an uninitialized context. init() has to be called before the context can be used.
+    */
+    PatchworkContext();
+    
+    /**
+    * Destroys the FFTW plans owned by this context.
+    */
+    ~PatchworkContext();
+    
+    PatchworkContext(const PatchworkContext &) = delete;
+    PatchworkContext & operator=(const PatchworkContext &) = delete;
+    
+    /**
+    * Initializes the FFTW plans of this context. Any filters cached before will be discarded.
+    *
+    * The plans are created with the rigor set by setPlanningRigor(). If a background upgrade has been
+    * requested and the FFTW wisdom does not already contain plans of that rigor for the given geometry,
+    * plans will be created with PlanningRigor::ESTIMATE instead and a background thread will start
+    * planning with the requested rigor. Its plans are put into use by upgradePlans().
+    * The plans of a pending upgrade for a previous geometry will be discarded without waiting for them.
+    *
+    * @param[in] maxRows Maximum number of rows of a pyramid level (including padding).
+    *
+    * @param[in] maxCols Maximum number of columns of a pyramid level (including padding).
+    *
+    * @param[in] numFeatures Number of features per cell.
+    *
+    * @param[in] batchSize Number of planes transformed by a single call to FFTW when transforming filters or
+    * transforming the products of filters and planes back. Batches allow FFTW to amortize the cost of loading
+    * twiddle factors and to vectorize across transforms. A value of 1 disables batching.
+    *
+    * @returns Returns true if the initialization was successful.
+    */
+    bool init(int maxRows, int maxCols, int numFeatures, int batchSize = 8);
+    
+    /**
+    * @return Returns true if init() has been called successfully for this context.
+    */
+    bool initialized() const { return (this->m_numInits > 0); };
+    
+    /**
+    * @return Returns the current maximum number of rows of a pyramid level (including padding).
+    */
+    int maxRows() const { return this->m_maxRows; };
+    
+    /**
+    * @return Returns the current maximum number of columns of a pyramid level (including padding).
+    */
+    int maxCols() const { return this->m_maxCols; };
+    
+    /**
+    * @return Returns the number of complex columns of a transformed plane.
+    */
+    int halfCols() const { return this->m_halfCols; };
+    
+    /**
+    * @return Returns the current number of features per cell.
+    */
+    int numFeatures() const { return this->m_numFeat; };
+    
+    /**
+    * @return Returns the number of calls to init() made so far on this context.
+    */
+    int numInits() const { return this->m_numInits; };
+    
+    /**
+    * @return Returns the number of planes transformed at once by the batched FFTW plans.
+    */
+    int batchSize() const { return this->m_batchSize; };
+    
+    /**
+    * @return Returns the number of complex elements between the beginnings of two consecutive single-channel
+    * planes in a buffer used with the batched inverse plan. The distance is padded to preserve alignment.
+    */
+    int planeDist() const { return this->m_planeDist; };
+    
+    /**
+    * Sets how much effort is spent on planning the FFTs when init() is called next.
+    *
+    * @param[in] rigor The rigor of the FFTW planner. The default is PlanningRigor::PATIENT.
+    *
+    * @param[in] backgroundUpgrade If set to true and plans of the given rigor cannot be created from the
+    * FFTW wisdom, init() will create plans using PlanningRigor::ESTIMATE, so that the context can be used
+    * immediately, and create the plans of the requested rigor in a background thread.
+    */
+    void setPlanningRigor(PlanningRigor rigor, bool backgroundUpgrade = false);
+    
+    /**
+    * @return Returns the planning rigor requested by setPlanningRigor().
+    */
+    PlanningRigor planningRigor() const { return this->m_rigor; };
+    
+    /**
+    * @return Returns the rigor of the plans currently in use, which may be lower than planningRigor()
+    * until a background upgrade has been completed and put into use by upgradePlans().
+    */
+    PlanningRigor currentPlanningRigor() const { return this->m_currentRigor; };
+    
+    /**
+    * Replaces the plans currently in use by those created by a background upgrade if it has finished.
+    *
+    * Since plans are not synchronized with their users, this must only be called at a point where
+    * the context is not used by any other thread, e.g. before convolving a new patchwork.
+    *
+    * @return Returns true if the plans have been replaced.
+    */
+    bool upgradePlans();
+    
+    /**
+    * @return Returns true if a background upgrade of the plans has been started by init() and its
+    * plans have not been put into use yet.
+    */
+    bool upgradePending() const;
+    
+    /**
+    * Sets the file FFTW wisdom is loaded from and saved to. The wisdom is shared by all contexts:
+    * the file is imported into the in-memory wisdom of FFTW once, before planning for the first time,
+    * and the wisdom is written back after plans have been created with a rigor other than
+    * PlanningRigor::ESTIMATE.
+    *
+    * The default is the value of the environment variable `ARTOS_FFTW_WISDOM` or "wisdom.fftw" in the
+    * current working directory if it is not set.
+    *
+    * @param[in] filename Path of the wisdom file. An empty string disables loading and saving wisdom.
+    */
+    static void setWisdomFile(const std::string & filename);
+    
+    /**
+    * @return Returns the path of the file FFTW wisdom is loaded from and saved to or an empty string
+    * if wisdom is not persisted.
+    */
+    static std::string wisdomFile();
+    
+    /**
+    * Adds wisdom to the in-memory wisdom shared by all contexts.
+    *
+    * @param[in] wisdom Wisdom as exported by exportWisdom().
+    *
+    * @return Returns true if the wisdom could be imported.
+    */
+    static bool importWisdom(const std::string & wisdom);
+    
+    /**
+    * @return Returns the in-memory wisdom shared by all contexts as string.
+    */
+    static std::string exportWisdom();
+    
+    /**
+    * Writes the in-memory wisdom to the file set by setWisdomFile().
+    *
+    * @return Returns true if the wisdom has been written successfully.
+    */
+    static bool saveWisdom();
+    
+    /**
+    * Acquires the lock that serializes calls to the FFTW planner among all threads. It must be held
+    * while FFTW plans are created or destroyed or the wisdom of FFTW is accessed outside of this class.
+    * FFTW is initialized for multi-threaded use before the lock is returned.
+    *
+    * @return Returns a lock on the FFTW planner, which is released when it is destroyed.
+    */
+    static std::unique_lock<std::mutex> plannerLock();
+    
+    /**
+    * @return Returns the number of threads used by the multi-threaded FFTW plans or 1 if multi-threaded
+    * FFTW is not available.
+    */
+    int fftThreads() const { return this->m_fftThreads; };
+    
+    /**
+    * Decides whether a number of independent transforms should be computed one after another using
+    * multi-threaded FFTW plans (intra-plane parallelism) instead of distributing them over threads
+    * which compute one transform each (inter-plane parallelism).
+    *
+    * Since inter-plane parallelism needs `ceil(n / fftThreads())` rounds of single-threaded transforms,
+    * while intra-plane parallelism needs `n` multi-threaded transforms, the latter is chosen if the
+    * speed-up of the multi-threaded plan over the single-threaded one, measured by init(), outweighs this.
+    *
+    * @param[in] nbTransforms Number of transforms to be computed.
+    *
+    * @param[in] inverse Whether the decision is about inverse transforms of products or forward transforms
+    * of patchwork planes.
+    *
+    * @return Returns true if the multi-threaded plans should be used. Always false if the number of threads
+    * available to OpenMP in the calling thread is less than fftThreads().
+    */
+    bool useThreadedFFT(int nbTransforms, bool inverse) const;
+    
+    /**
+    * Selects the instruction set extension used for multiplying transformed filters and planes.
+    *
+    * If a SIMD kernel is selected, transformed planes and filters will be stored in split layout
+    * (all real parts of a cell followed by all imaginary parts). With SIMDLevel::NONE, the
+    * interleaved layout and the original implementation based on Eigen will be used.
+    * Changing the layout discards all cached filters.
+    *
+    * By default, the best extension supported by the CPU will be used.
+    *
+    * @param[in] level The desired instruction set extension. If it is not supported by the CPU,
+    * the best one available will be used instead.
+    */
+    void setSIMDLevel(SIMDLevel level);
+    
+    /**
+    * @return Returns the instruction set extension used for multiplying transformed filters and planes.
+    */
+    SIMDLevel simdLevel() const { return this->m_simdLevel; };
+    
+    /**
+    * @return Returns true if transformed planes and filters are stored with real and imaginary parts
+    * of the features of a cell separated from each other.
+    */
+    bool splitLayout() const { return (this->m_simdLevel != SIMDLevel::NONE); };
+    
+    /**
+    * Returns a transformed version of a filter to be used by Patchwork::convolve().
+    *
+    * @param[in] filter Filter to transform.
+    *
+    * @param[out] result Transformed filter.
+    *
+    * @note If init() has not been called yet or if the filter is larger than the last maxRows and
+    * maxCols passed to init(), the result will be empty.
+    */
+    void transformFilter(const FeatureMatrix & filter, Patchwork::Filter & result) const;
+    
+    /**
+    * Transforms multiple filters using the batched FFTW plan.
+    *
+    * @param[in] filters Pointers to the filters to transform.
+    *
+    * @param[out] results Transformed filters, in the same order as the given filters.
+    * If a filter is larger than maxRows() and maxCols() or has a different number of features,
+    * the corresponding result will be empty.
+    */
+    void transformFilters(const std::vector<const FeatureMatrix *> & filters, FilterList & results) const;
+    
+    /**
+    * Returns the transformed filters of all parts of all models of a mixture. Depending on the
+    * filter cache policy (see setFilterCachePolicy()), they will be computed and cached on first use,
+    * restored from their cached half precision version or computed from scratch.
+    *
+    * The filters of the first model come first, starting with its root, followed by the filters
+    * of the second model and so on.
+    *
+    * @param[in] mixture The mixture whose filters are to be retrieved.
+    *
+    * @return Returns a pointer to the list of transformed filters, which remains valid as long as
+    * the caller holds it, even if the filters are removed from the cache in the meantime.
+    */
+    std::shared_ptr<const FilterList> filters(const Mixture & mixture);
+    
+    /**
+    * @param[in] mixture A mixture.
+    *
+    * @return Returns true if the transformed filters of the given mixture are in the cache.
+    */
+    bool hasFilters(const Mixture & mixture) const;
+    
+    /**
+    * Removes the transformed filters of a given mixture from the cache.
+    *
+    * @param[in] mixture The mixture whose filters are to be released.
+    */
+    void releaseFilters(const Mixture & mixture);
+    
+    /**
+    * Removes all transformed filters from the cache.
+    */
+    void clearFilters();
+    
+    /**
+    * Selects how transformed filters are kept in memory between calls to filters().
+    *
+    * The transformed filters of a mixture with `n` filters occupy `n * maxRows() * halfCols() * numFeatures()`
+    * complex numbers with FilterCachePolicy::FULL, i.e. about 8 MB per filter for planes of 256 x 256 cells
+    * with 32 features. Half precision storage reduces this by a factor of 2 at the cost of a conversion on
+    * each use and a relative error in the order of 1e-3. Transforming filters on the fly needs no memory
+    * between detections, but costs a forward FFT per filter and detection.
+    *
+    * Additionally, a memory budget may be given: If the cached filters exceed it, the filters of the
+    * mixtures used least recently will be evicted from the cache and transformed again on their next use.
+    *
+    * Changing the policy discards all cached filters.
+    *
+    * @param[in] policy The cache policy.
+    *
+    * @param[in] budget Maximum number of bytes to be occupied by cached filters. 0 means no limit.
+    * The filters of the mixture used last will always be kept, even if they exceed the budget on their own.
+    */
+    void setFilterCachePolicy(FilterCachePolicy policy, size_t budget = 0);
+    
+    /**
+    * @return Returns the policy used for keeping transformed filters in memory.
+    */
+    FilterCachePolicy filterCachePolicy() const { return this->m_cachePolicy; };
+    
+    /**
+    * @return Returns the maximum number of bytes occupied by cached filters, 0 meaning no limit.
+    */
+    size_t filterCacheBudget() const { return this->m_cacheBudget; };
+    
+    /**
+    * @return Returns the number of bytes currently occupied by cached filters.
+    */
+    size_t filterCacheMemory() const;
+
+    /**
+    * Checks if FFTW can transform sequences of a given length efficiently, i.e. if the length
+    * has no prime factors other than 2, 3, 5 and 7.
+    *
+    * @param[in] n The length to be checked.
+    *
+    * @return Returns true if `n` is of the form `2^a * 3^b * 5^c * 7^d`.
+    */
+    static bool isFFTFriendly(int n);
+
+    /**
+    * Estimates the number of floating point operations needed for convolving a number of filters with
+    * a patchwork: the forward transforms of the planes, the multiplication of each transformed filter
+    * with each plane and the inverse transforms of those products. The filters are assumed to be
+    * transformed already.
+    *
+    * Transforms are assumed to take `2.5 * N * log2(N)` operations, weighted slightly higher for
+    * each factor 3, 5 or 7 of the plane size, since the corresponding FFTW codelets are less efficient
+    * than the radix-2 ones.
+    *
+    * @param[in] planeSize The size of the patchwork planes.
+    *
+    * @param[in] numPlanes The number of patchwork planes.
+    *
+    * @param[in] numFeatures The number of features per cell.
+    *
+    * @param[in] numFilters The number of filters to be convolved with the patchwork.
+    *
+    * @return Returns the estimated cost.
+    */
+    static double estimateCost(const Size & planeSize, int numPlanes, int numFeatures, int numFilters);
+
+    /**
+    * Chooses the size of the patchwork planes for a feature pyramid, so that the estimated cost of
+    * convolving the pyramid with a given number of filters is minimal.
+    *
+    * Candidate sizes are those between the minimum size and twice the minimum size whose dimensions
+    * are FFT-friendly (see isFFTFriendly()), with an even number of columns. For each candidate, the
+    * number of planes is determined by packing the levels with PackRectangles() like Patchwork does and
+    * the cost is given by estimateCost().
+    *
+    * @param[in] levels The sizes of the pyramid levels (without padding).
+    *
+    * @param[in] padding The padding which will be passed to the Patchwork constructor.
+    *
+    * @param[in] numFeatures The number of features per cell.
+    *
+    * @param[in] numFilters The number of filters to be convolved with the patchwork.
+    *
+    * @param[in] minSize Optionally, a lower bound for the plane size. The size of the largest level
+    * plus padding will be used if it is larger.
+    *
+    * @param[out] numPlanes If not NULL, receives the number of planes needed with the chosen size.
+    *
+    * @return Returns the chosen plane size or a size of 0 x 0 if `levels` is empty.
+    */
+    static Size choosePlaneSize(const std::vector<Size> & levels, const Size & padding, int numFeatures,
+                                int numFilters, const Size & minSize = Size(), int * numPlanes = NULL);
+
+
+protected:
+
+    int m_maxRows;
+    int m_maxCols;
+    int m_halfCols;
+    int m_numFeat;
+    int m_numInits;
+    int m_batchSize;
+    int m_planeDist; /**< Distance between single-channel planes in a batch (in complex elements). */
+    int m_filterDist; /**< Distance between filters in a batch (in complex elements). */
+    
+    /**
+    * A complete set of FFTW plans for a given geometry.
+    */
+    struct FFTPlans
+    {
+        fftwf_plan forwards;
+        fftwf_plan inverse;
+        fftwf_plan forwardsBatch;
+        fftwf_plan inverseBatch;
+        fftwf_plan forwardsThreaded;
+        fftwf_plan inverseThreaded;
+        int fftThreads;
+        double forwardsSpeedup;
+        double inverseSpeedup;
+        PlanningRigor rigor;
+        
+        FFTPlans();
+        
+        /**
+        * Destroys all plans of this set. fftwPlannerMutex must be held by the caller.
+        */
+        void destroy();
+    };
+    
+    /**
+    * Creates a set of plans. fftwPlannerMutex must not be held by the caller.
+    *
+    * @param[in] wisdomOnly If set to true, plans will only be created if they can be derived from wisdom.
+    *
+    * @param[in] background If set to true, the FFTW planner will be released between two plans if
+    * another thread is waiting for it in the foreground.
+    *
+    * @return Returns true if all plans needed for the given geometry could be created. Otherwise,
+    * `plans` will be left empty.
+    */
+    static bool createPlans(int maxRows, int maxCols, int numFeatures, int batchSize,
+                            PlanningRigor rigor, bool wisdomOnly, bool background, FFTPlans & plans);
+    
+    /**
+    * Replaces the plans currently in use by the given ones. fftwPlannerMutex must be held by the caller.
+    */
+    void adoptPlans(const FFTPlans & plans);
+    
+    /**
+    * Discards the plans of a background upgrade, which may still be running.
+    */
+    void cancelUpgrade();
+    
+    fftwf_plan m_forwards;
+    fftwf_plan m_inverse;
+    fftwf_plan m_forwardsBatch; /**< Transforms m_batchSize filters at once. */
+    fftwf_plan m_inverseBatch; /**< Transforms m_batchSize single-channel planes back at once. */
+    fftwf_plan m_forwardsThreaded; /**< Like m_forwards, but using m_fftThreads threads. */
+    fftwf_plan m_inverseThreaded; /**< Like m_inverse, but using m_fftThreads threads. */
+    
+    int m_fftThreads;
+    double m_forwardsSpeedup; /**< Measured speed-up of m_forwardsThreaded over m_forwards. */
+    double m_inverseSpeedup; /**< Measured speed-up of m_inverseThreaded over m_inverse. */
+    
+    PlanningRigor m_rigor;
+    bool m_backgroundUpgrade;
+    PlanningRigor m_currentRigor;
+    std::vector<std::thread> m_upgradeThreads; /**< Background planners, joined when finished or on destruction. */
+    std::vector<std::thread::id> m_finishedUpgrades; /**< Background planners which have finished, but not been joined yet. */
+    int m_upgradeGeneration; /**< Incremented whenever a pending upgrade becomes obsolete. */
+    bool m_upgradeRunning; /**< Set while the background planner of the current generation is running. */
+    FFTPlans m_upgradedPlans; /**< Plans created by the background planner of the current generation. */
+    bool m_upgradeReady; /**< Set when m_upgradedPlans are complete. */
+    mutable std::mutex m_upgradeMutex;
+    
+    SIMDLevel m_simdLevel;
+    ComplexMACKernel m_kernel;
+    
+    /**
+    * Transformed filters of a mixture in the cache.
+    */
+    struct CacheEntry
+    {
+        std::shared_ptr<const FilterList> filters; /**< Filters in single precision (FilterCachePolicy::FULL). */
+        std::vector< std::vector<uint16_t> > halfFilters; /**< Filters in half precision (FilterCachePolicy::HALF_PRECISION). */
+        std::vector<float> halfScales; /**< Factors for restoring the half precision filters. */
+        std::vector< std::pair<int, int> > sizes; /**< Spatial sizes of the filters. */
+        size_t bytes; /**< Memory occupied by this entry. */
+        unsigned long lastUse; /**< Value of m_cacheClock when this entry was used last. */
+    };
+    
+    FilterCachePolicy m_cachePolicy;
+    size_t m_cacheBudget;
+    size_t m_cacheMemory;
+    unsigned long m_cacheClock;
+    std::map<unsigned long, CacheEntry> m_filterCache; /**< Transformed filters, indexed by Mixture::id(). */
+    mutable std::mutex m_filterCacheMutex;
+    
+    /**
+    * Evicts the least recently used entries from the cache until it fits into the budget.
+    * m_filterCacheMutex must be held by the caller.
+    *
+    * @param[in] keep ID of a mixture whose filters must not be evicted.
+    */
+    void evictFilters(unsigned long keep);
+    
+    friend class Patchwork;
+
+};
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+#include "PatchworkKernels.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#if defined(ARTOS_PATCHWORK_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ARTOS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace ARTOS;
+using namespace std;
+
+
+//// Portable kernel (may be auto-vectorized by the compiler) ////
+
+static void complexMACGeneric(const float * filter, const float * plane, int numFeat, int numCells, complex<float> * out)
+{
+    for (int c = 0; c < numCells; ++c, filter += 2 * numFeat, plane += 2 * numFeat)
+    {
+        const float * fr = filter, * fi = filter + numFeat;
+        const float * pr = plane, * pi = plane + numFeat;
+        float re = 0, im = 0;
+        for (int f = 0; f < numFeat; ++f)
+        {
+            re += fr[f] * pr[f] - fi[f] * pi[f];
+            im += fr[f] * pi[f] + fi[f] * pr[f];
+        }
+        out[c] = complex<float>(re, im);
+    }
+}
+
+
+#ifdef ARTOS_X86_KERNELS
+
+//// AVX2 + FMA kernel ////
+
+__attribute__((target("avx2,fma")))
+static void complexMACAVX2(const float * filter, const float * plane, int numFeat, int numCells, complex<float> * out)
+{
+    const int vecFeat = numFeat & ~7;
+    for (int c = 0; c < numCells; ++c, filter += 2 * numFeat, plane += 2 * numFeat)
+    {
+        const float * fr = filter, * fi = filter + numFeat;
+        const float * pr = plane, * pi = plane + numFeat;
+        __m256 accRe = _mm256_setzero_ps(), accIm = _mm256_setzero_ps();
+        int f;
+        for (f = 0; f < vecFeat; f += 8)
+        {
+            const __m256 a = _mm256_loadu_ps(fr + f), b = _mm256_loadu_ps(fi + f);
+            const __m256 x = _mm256_loadu_ps(pr + f), y = _mm256_loadu_ps(pi + f);
+            accRe = _mm256_fmadd_ps(a, x, accRe);
+            accRe = _mm256_fnmadd_ps(b, y, accRe);
+            accIm = _mm256_fmadd_ps(a, y, accIm);
+            accIm = _mm256_fmadd_ps(b, x, accIm);
+        }
+        // Horizontal sums of both accumulators at once: (re0+re1, re2+re3, im0+im1, im2+im3, ...)
+        __m256 sums = _mm256_hadd_ps(accRe, accIm);
+        __m128 halves = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+        halves = _mm_hadd_ps(halves, halves);
+        float re = _mm_cvtss_f32(halves);
+        float im = _mm_cvtss_f32(_mm_shuffle_ps(halves, halves, 1));
+        for (; f < numFeat; ++f)
+        {
+            re += fr[f] * pr[f] - fi[f] * pi[f];
+            im += fr[f] * pi[f] + fi[f] * pr[f];
+        }
+        out[c] = complex<float>(re, im);
+    }
+}
+
+
+//// AVX-512 kernel ////
+
+__attribute__((target("avx512f")))
+static void complexMACAVX512(const float * filter, const float * plane, int numFeat, int numCells, complex<float> * out)
+{
+    const int vecFeat = numFeat & ~15;
+    const __mmask16 tailMask = static_cast<__mmask16>((1u << (numFeat - vecFeat)) - 1);
+    for (int c = 0; c < numCells; ++c, filter += 2 * numFeat, plane += 2 * numFeat)
+    {
+        const float * fr = filter, * fi = filter + numFeat;
+        const float * pr = plane, * pi = plane + numFeat;
+        __m512 accRe = _mm512_setzero_ps(), accIm = _mm512_setzero_ps();
+        for (int f = 0; f < vecFeat; f += 16)
+        {
+            const __m512 a = _mm512_loadu_ps(fr + f), b = _mm512_loadu_ps(fi + f);
+            const __m512 x = _mm512_loadu_ps(pr + f), y = _mm512_loadu_ps(pi + f);
+            accRe = _mm512_fmadd_ps(a, x, accRe);
+            accRe = _mm512_fnmadd_ps(b, y, accRe);
+            accIm = _mm512_fmadd_ps(a, y, accIm);
+            accIm = _mm512_fmadd_ps(b, x, accIm);
+        }
+        if (tailMask)
+        {
+            const __m512 a = _mm512_maskz_loadu_ps(tailMask, fr + vecFeat), b = _mm512_maskz_loadu_ps(tailMask, fi + vecFeat);
+            const __m512 x = _mm512_maskz_loadu_ps(tailMask, pr + vecFeat), y = _mm512_maskz_loadu_ps(tailMask, pi + vecFeat);
+            accRe = _mm512_fmadd_ps(a, x, accRe);
+            accRe = _mm512_fnmadd_ps(b, y, accRe);
+            accIm = _mm512_fmadd_ps(a, y, accIm);
+            accIm = _mm512_fmadd_ps(b, x, accIm);
+        }
+        out[c] = complex<float>(_mm512_reduce_add_ps(accRe), _mm512_reduce_add_ps(accIm));
+    }
+}
+
+#endif
+
+
+//// Dispatching ////
+
+SIMDLevel ARTOS::detectSIMDLevel()
+{
+#ifdef ARTOS_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMDLevel::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SIMDLevel::AVX2;
+#endif
+    return SIMDLevel::NONE;
+}
+
+const char * ARTOS::simdLevelName(SIMDLevel level)
+{
+    switch (level)
+    {
+        case SIMDLevel::AVX2:
+            return "AVX2";
+        case SIMDLevel::AVX512:
+            return "AVX-512";
+        default:
+            return "none";
+    }
+}
+
+ComplexMACKernel ARTOS::complexMACKernel(SIMDLevel level)
+{
+    static const SIMDLevel available = detectSIMDLevel();
+    level = min(level, available);
+#ifdef ARTOS_X86_KERNELS
+    if (level == SIMDLevel::AVX512)
+        return complexMACAVX512;
+    if (level == SIMDLevel::AVX2)
+        return complexMACAVX2;
+#endif
+    return complexMACGeneric;
+}
+
+void ARTOS::splitComplexCells(complex<float> * data, int numCells, int numFeat)
+{
+    vector<float> tmp(2 * numFeat);
+    float * cell = reinterpret_cast<float*>(data);
+    for (int c = 0; c < numCells; ++c, cell += 2 * numFeat)
+    {
+        for (int f = 0; f < numFeat; ++f)
+        {
+            tmp[f] = cell[2 * f];
+            tmp[numFeat + f] = cell[2 * f + 1];
+        }
+        copy(tmp.begin(), tmp.end(), cell);
+    }
+}
+
+
+//// Half precision conversion ////
+
+static uint16_t floatToHalfScalar(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const int32_t exp = static_cast<int32_t>((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+    
+    if (((x >> 23) & 0xff) == 0xff) // infinity or NaN
+        return sign | 0x7c00 | ((mant) ? 0x200 : 0);
+    if (exp >= 31) // overflow
+        return sign | 0x7c00;
+    if (exp <= 0)
+    {
+        // Subnormal half or zero
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        const int shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1), mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1)))
+            ++half;
+        return sign | half;
+    }
+    
+    uint32_t half = sign | (static_cast<uint32_t>(exp) << 10) | (mant >> 13);
+    const uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+        ++half; // a carry into the exponent is the correct result
+    return half;
+}
+
+static float halfToFloatScalar(uint16_t h)
+{
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    const uint32_t exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+    float f;
+    if (exp == 0)
+    {
+        f = mant * (1.0f / 16777216.0f); // 2^-24
+        return (sign) ? -f : f;
+    }
+    const uint32_t x = (exp == 31) ? (sign | 0x7f800000 | (mant << 13)) : (sign | ((exp - 15 + 127) << 23) | (mant << 13));
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+#ifdef ARTOS_X86_KERNELS
+
+__attribute__((target("avx,f16c")))
+static void floatToHalfF16C(const float * in, uint16_t * out, size_t n, float scale)
+{
+    const __m256 s = _mm256_set1_ps(scale);
+    size_t i;
+    for (i = 0; i + 8 <= n; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm256_cvtps_ph(_mm256_mul_ps(_mm256_loadu_ps(in + i), s), _MM_FROUND_TO_NEAREST_INT));
+    for (; i < n; ++i)
+        out[i] = floatToHalfScalar(in[i] * scale);
+}
+
+__attribute__((target("avx,f16c")))
+static void halfToFloatF16C(const uint16_t * in, float * out, size_t n, float scale)
+{
+    const __m256 s = _mm256_set1_ps(scale);
+    size_t i;
+    for (i = 0; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))), s));
+    for (; i < n; ++i)
+        out[i] = halfToFloatScalar(in[i]) * scale;
+}
+
+#endif
+
+void ARTOS::floatToHalf(const float * in, uint16_t * out, size_t n, float scale)
+{
+#ifdef ARTOS_X86_KERNELS
+    static const bool f16c = (detectSIMDLevel() != SIMDLevel::NONE); // all CPUs with AVX2 support F16C
+    if (f16c)
+    {
+        floatToHalfF16C(in, out, n, scale);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i)
+        out[i] = floatToHalfScalar(in[i] * scale);
+}
+
+void ARTOS::halfToFloat(const uint16_t * in, float * out, size_t n, float scale)
+{
+#ifdef ARTOS_X86_KERNELS
+    static const bool f16c = (detectSIMDLevel() != SIMDLevel::NONE);
+    if (f16c)
+    {
+        halfToFloatF16C(in, out, n, scale);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < n; ++i)
+        out[i] = halfToFloatScalar(in[i]) * scale;
+}
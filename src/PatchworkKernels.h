@@ -0,0 +1,104 @@
+#ifndef ARTOS_PATCHWORKKERNELS_H
+#define ARTOS_PATCHWORKKERNELS_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+namespace ARTOS
+{
+
+/**
+* Instruction set extensions which may be used by the frequency-domain multiply-accumulate kernels
+* of the Patchwork class.
+*/
+enum class SIMDLevel { NONE, AVX2, AVX512 };
+
+/**
+* Function computing the complex dot products of the cells of a transformed filter with the
+* corresponding cells of a transformed patchwork plane, both stored in split layout
+* (see splitComplexCells()).
+*
+* @param[in] filter Pointer to the first cell of the filter.
+*
+* @param[in] plane Pointer to the first cell of the plane.
+*
+* @param[in] numFeat Number of complex features per cell.
+*
+* @param[in] numCells Number of consecutive cells to process.
+*
+* @param[out] out Array with `numCells` elements which will receive the dot products.
+*/
+typedef void (*ComplexMACKernel)(const float * filter, const float * plane, int numFeat, int numCells,
+                                 std::complex<float> * out);
+
+/**
+* Determines the most powerful instruction set extension supported by both the CPU and the build.
+*
+* @return Returns the best SIMDLevel available at run-time.
+*/
+SIMDLevel detectSIMDLevel();
+
+/**
+* @param[in] level An instruction set extension.
+*
+* @return Returns a human-readable name of the given SIMDLevel.
+*/
+const char * simdLevelName(SIMDLevel level);
+
+/**
+* Retrieves the multiply-accumulate kernel for a given instruction set extension.
+*
+* @param[in] level The desired instruction set extension. If it is not available at run-time,
+* the best available one will be used instead.
+*
+* @return Returns a pointer to the kernel function.
+*/
+ComplexMACKernel complexMACKernel(SIMDLevel level);
+
+/**
+* Converts cells of complex numbers from interleaved layout (`re0 im0 re1 im1 ...`) in-place to
+* split layout, where all real parts of a cell are followed by all imaginary parts
+* (`re0 re1 ... im0 im1 ...`).
+*
+* @param[in,out] data Pointer to the first cell.
+*
+* @param[in] numCells Number of cells to convert.
+*
+* @param[in] numFeat Number of complex features per cell.
+*/
+void splitComplexCells(std::complex<float> * data, int numCells, int numFeat);
+
+/**
+* Converts single precision numbers to IEEE 754 half precision after multiplying them with a scale factor.
+*
+* F16C instructions will be used if available, otherwise a portable conversion with the same
+* rounding (round to nearest, ties to even) will be performed.
+*
+* @param[in] in Array of `n` single precision numbers.
+*
+* @param[out] out Array which will receive the `n` half precision numbers.
+*
+* @param[in] n Number of elements to be converted.
+*
+* @param[in] scale Factor to multiply each element with before conversion. It should be chosen so that
+* the magnitudes of the scaled numbers lie well within the range of half precision numbers (up to 65504).
+*/
+void floatToHalf(const float * in, uint16_t * out, size_t n, float scale);
+
+/**
+* Converts IEEE 754 half precision numbers to single precision and multiplies them with a scale factor.
+*
+* @param[in] in Array of `n` half precision numbers.
+*
+* @param[out] out Array which will receive the `n` single precision numbers.
+*
+* @param[in] n Number of elements to be converted.
+*
+* @param[in] scale Factor to multiply each element with after conversion.
+*/
+void halfToFloat(const uint16_t * in, float * out, size_t n, float scale);
+
+}
+
+#endif
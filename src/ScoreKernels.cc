@@ -0,0 +1,259 @@
+#include "ScoreKernels.h"
+#include "PatchworkKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(ARTOS_PATCHWORK_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ARTOS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace ARTOS;
+using namespace std;
+
+typedef FeatureScalar Scalar;
+
+
+//// Portable kernels (may be auto-vectorized by the compiler) ////
+
+/**
+* Computes the maximum over all components of row `y` and, optionally, the index of the first best component.
+*/
+static void rowMaxGeneric(const vector<const ScalarMatrix *> & components, int y, int cols, Scalar * out, int * argmax)
+{
+    const Scalar * first = components[0]->data() + static_cast<ptrdiff_t>(y) * cols;
+    for (int x = 0; x < cols; ++x)
+        out[x] = first[x];
+    if (argmax)
+        for (int x = 0; x < cols; ++x)
+            argmax[x] = 0;
+    for (size_t k = 1; k < components.size(); ++k)
+    {
+        const Scalar * row = components[k]->data() + static_cast<ptrdiff_t>(y) * cols;
+        if (argmax)
+        {
+            for (int x = 0; x < cols; ++x)
+                if (row[x] > out[x])
+                {
+                    out[x] = row[x];
+                    argmax[x] = k;
+                }
+        }
+        else
+            for (int x = 0; x < cols; ++x)
+                out[x] = (row[x] > out[x]) ? row[x] : out[x];
+    }
+}
+
+/**
+* Appends the peaks of a row to a list, given the maximum scores of that row and the rows above and below,
+* each padded with minus infinity by one element on both sides.
+*/
+static void rowPeaksGeneric(const Scalar * prev, const Scalar * cur, const Scalar * next, int cols, Scalar threshold,
+                            int y, vector<ScorePeak> & peaks)
+{
+    for (int x = 1; x <= cols; ++x)
+    {
+        const Scalar score = cur[x];
+        if (score > threshold && score > prev[x - 1] && score > prev[x] && score > prev[x + 1]
+                && score > cur[x - 1] && score > cur[x + 1]
+                && score > next[x - 1] && score > next[x] && score > next[x + 1])
+            peaks.push_back(ScorePeak{ x - 1, y, 0, score });
+    }
+}
+
+
+#ifdef ARTOS_X86_KERNELS
+
+//// AVX2 kernels ////
+
+__attribute__((target("avx2")))
+static void rowMaxAVX2(const vector<const ScalarMatrix *> & components, int y, int cols, Scalar * out, int * argmax)
+{
+    const int vecCols = cols & ~7;
+    const Scalar * first = components[0]->data() + static_cast<ptrdiff_t>(y) * cols;
+    int x;
+    for (x = 0; x < vecCols; x += 8)
+    {
+        __m256 best = _mm256_loadu_ps(first + x);
+        __m256i bestIndex = _mm256_setzero_si256();
+        for (size_t k = 1; k < components.size(); ++k)
+        {
+            // Replace the maximum only where the component is strictly better, just like the scalar code,
+            // so that ties and NaNs are resolved identically (_mm256_max_ps would not)
+            const __m256 v = _mm256_loadu_ps(components[k]->data() + static_cast<ptrdiff_t>(y) * cols + x);
+            const __m256 better = _mm256_cmp_ps(v, best, _CMP_GT_OQ);
+            best = _mm256_blendv_ps(best, v, better);
+            if (argmax)
+                bestIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIndex),
+                                                                 _mm256_castsi256_ps(_mm256_set1_epi32(k)), better));
+        }
+        _mm256_storeu_ps(out + x, best);
+        if (argmax)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(argmax + x), bestIndex);
+    }
+    for (; x < cols; ++x)
+    {
+        out[x] = first[x];
+        if (argmax)
+            argmax[x] = 0;
+        for (size_t k = 1; k < components.size(); ++k)
+        {
+            const Scalar v = components[k]->data()[static_cast<ptrdiff_t>(y) * cols + x];
+            if (v > out[x])
+            {
+                out[x] = v;
+                if (argmax)
+                    argmax[x] = k;
+            }
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void rowPeaksAVX2(const Scalar * prev, const Scalar * cur, const Scalar * next, int cols, Scalar threshold,
+                         int y, vector<ScorePeak> & peaks)
+{
+    const int vecCols = cols & ~7;
+    const __m256 thresh = _mm256_set1_ps(threshold);
+    int x;
+    for (x = 1; x <= vecCols; x += 8)
+    {
+        const __m256 score = _mm256_loadu_ps(cur + x);
+        __m256 mask = _mm256_cmp_ps(score, thresh, _CMP_GT_OQ);
+        if (_mm256_testz_ps(mask, mask))
+            continue;
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(score, _mm256_loadu_ps(cur + x - 1), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(score, _mm256_loadu_ps(cur + x + 1), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(score, _mm256_loadu_ps(prev + x - 1), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(score, _mm256_loadu_ps(prev + x), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(score, _mm256_loadu_ps(prev + x + 1), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(score, _mm256_loadu_ps(next + x - 1), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(score, _mm256_loadu_ps(next + x), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(score, _mm256_loadu_ps(next + x + 1), _CMP_GT_OQ));
+        for (int bits = _mm256_movemask_ps(mask); bits != 0; bits &= bits - 1)
+        {
+            const int i = x + __builtin_ctz(bits);
+            peaks.push_back(ScorePeak{ i - 1, y, 0, cur[i] });
+        }
+    }
+    if (x <= cols)
+    {
+        vector<ScorePeak> tail;
+        rowPeaksGeneric(prev + x - 1, cur + x - 1, next + x - 1, cols - x + 1, threshold, y, tail);
+        for (ScorePeak & peak : tail)
+        {
+            peak.x += x - 1;
+            peaks.push_back(peak);
+        }
+    }
+}
+
+#endif
+
+
+//// Dispatch ////
+
+typedef void (*RowMaxKernel)(const vector<const ScalarMatrix *> &, int, int, Scalar *, int *);
+typedef void (*RowPeaksKernel)(const Scalar *, const Scalar *, const Scalar *, int, Scalar, int, vector<ScorePeak> &);
+
+static RowMaxKernel rowMaxKernel()
+{
+#ifdef ARTOS_X86_KERNELS
+    static const bool avx2 = (detectSIMDLevel() != SIMDLevel::NONE);
+    if (avx2)
+        return rowMaxAVX2;
+#endif
+    return rowMaxGeneric;
+}
+
+static RowPeaksKernel rowPeaksKernel()
+{
+#ifdef ARTOS_X86_KERNELS
+    static const bool avx2 = (detectSIMDLevel() != SIMDLevel::NONE);
+    if (avx2)
+        return rowPeaksAVX2;
+#endif
+    return rowPeaksGeneric;
+}
+
+
+void ARTOS::MaxComponents(const vector<const ScalarMatrix *> & components, ScalarMatrix & scores, Mixture::Indices * argmaxes)
+{
+    if (components.empty())
+    {
+        scores.resize(0, 0);
+        if (argmaxes)
+            argmaxes->resize(0, 0);
+        return;
+    }
+
+    const int rows = components[0]->rows(), cols = components[0]->cols();
+    scores.resize(rows, cols);
+    if (argmaxes)
+        argmaxes->resize(rows, cols);
+
+    const RowMaxKernel rowMax = rowMaxKernel();
+    for (int y = 0; y < rows; ++y)
+        rowMax(components, y, cols, scores.row(y).data(), (argmaxes) ? argmaxes->row(y).data() : 0);
+}
+
+void ARTOS::FindPeaks(const vector<const ScalarMatrix *> & components, double threshold, vector<ScorePeak> & peaks)
+{
+    peaks.clear();
+    if (components.empty() || components[0]->size() == 0)
+        return;
+
+    // The largest scalar not greater than the threshold, so that `score > thresh` iff `score > threshold`.
+    // Thresholds outside of the range of Scalar must not be converted directly.
+    Scalar thresh;
+    if (threshold < numeric_limits<Scalar>::lowest())
+        thresh = -numeric_limits<Scalar>::infinity();
+    else if (threshold > numeric_limits<Scalar>::max())
+        thresh = numeric_limits<Scalar>::max();
+    else
+        thresh = static_cast<Scalar>(threshold);
+    if (thresh > threshold)
+        thresh = nextafter(thresh, -numeric_limits<Scalar>::infinity());
+
+    const int rows = components[0]->rows(), cols = components[0]->cols();
+    const RowMaxKernel rowMax = rowMaxKernel();
+    const RowPeaksKernel rowPeaks = rowPeaksKernel();
+
+    // Maxima of three consecutive rows, padded with minus infinity, so that positions outside of
+    // the level never prevent a peak at the border
+    const Scalar minusInf = -numeric_limits<Scalar>::infinity();
+    vector<Scalar> buffer(3 * (cols + 2), minusInf);
+    Scalar * prev = &buffer[0], * cur = &buffer[cols + 2], * next = &buffer[2 * (cols + 2)];
+    rowMax(components, 0, cols, cur + 1, 0);
+
+    for (int y = 0; y < rows; ++y)
+    {
+        if (y + 1 < rows)
+            rowMax(components, y + 1, cols, next + 1, 0);
+        else
+            fill(next + 1, next + cols + 1, minusInf);
+
+        const size_t first = peaks.size();
+        rowPeaks(prev, cur, next, cols, thresh, y, peaks);
+
+        // Determine the best component at the peaks only
+        for (size_t p = first; p < peaks.size(); ++p)
+        {
+            const ptrdiff_t offset = static_cast<ptrdiff_t>(y) * cols + peaks[p].x;
+            Scalar best = components[0]->data()[offset];
+            for (size_t k = 1; k < components.size(); ++k)
+                if (components[k]->data()[offset] > best)
+                {
+                    best = components[k]->data()[offset];
+                    peaks[p].component = k;
+                }
+        }
+
+        Scalar * tmp = prev;
+        prev = cur;
+        cur = next;
+        next = tmp;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef ARTOS_SCOREKERNELS_H
+#define ARTOS_SCOREKERNELS_H
+
+#include <vector>
+#include "FeatureMatrix.h"
+#include "Mixture.h"
+
+namespace ARTOS
+{
+
+/**
+* A local maximum of the scores of a mixture on a pyramid level.
+*/
+struct ScorePeak
+{
+    int x; /**< Horizontal position of the peak on the pyramid level. */
+    int y; /**< Vertical position of the peak on the pyramid level. */
+    int component; /**< Index of the best model (mixture component) at the peak. */
+    FeatureScalar score; /**< Score of the best model at the peak. */
+};
+
+/**
+* Selects the best component at each position of a pyramid level. On ties, the component with the
+* lowest index wins. AVX2 instructions will be used if available.
+*
+* @param[in] components Scores of each component on the level. All matrices must have the same size.
+*
+* @param[out] scores Receives the maximum score at each position.
+*
+* @param[out] argmaxes If not NULL, receives the index of the best component at each position.
+*/
+void MaxComponents(const std::vector<const ScalarMatrix *> & components, ScalarMatrix & scores, Mixture::Indices * argmaxes = 0);
+
+/**
+* Finds all positions on a pyramid level where the maximum score over all components exceeds a threshold
+* and is strictly greater than the maximum scores at the (up to) 8 neighbouring positions.
+*
+* This is equivalent to taking the maximum over all components using MaxComponents() and scanning the
+* result for local maxima, but done in a single vectorized pass over the level without materializing
+* the scores and argmaxes of the whole level. The best component is only determined at the peaks.
+*
+* @param[in] components Scores of each component on the level. All matrices must have the same size.
+*
+* @param[in] threshold Only peaks with a score greater than this will be reported.
+*
+* @param[out] peaks Receives the peaks in row-major order. Existing contents will be replaced.
+*/
+void FindPeaks(const std::vector<const ScalarMatrix *> & components, double threshold, std::vector<ScorePeak> & peaks);
+
+}
+
+#endif
@@ -0,0 +1,353 @@
+#include "StarCascade.h"
+#include "ScoreKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <Eigen/Eigenvalues>
+using namespace ARTOS;
+using namespace std;
+
+
+/**
+* Computes the response of a filter at a given position of a feature matrix, treating features outside
+* of the matrix as zero.
+*/
+static StarCascade::Scalar correlate(const FeatureMatrix & features, const FeatureMatrix & filter, int x, int y)
+{
+    const int channels = filter.channels();
+    const int y0 = max(0, -y), y1 = min(static_cast<int>(filter.rows()), static_cast<int>(features.rows()) - y);
+    const int x0 = max(0, -x), x1 = min(static_cast<int>(filter.cols()), static_cast<int>(features.cols()) - x);
+    if (y0 >= y1 || x0 >= x1)
+        return 0;
+
+    const int n = (x1 - x0) * channels;
+    StarCascade::Scalar sum = 0;
+    for (int dy = y0; dy < y1; ++dy)
+    {
+        const FeatureScalar * f = filter.raw() + (static_cast<size_t>(dy) * filter.cols() + x0) * channels;
+        const FeatureScalar * p = features.raw() + (static_cast<size_t>(y + dy) * features.cols() + x + x0) * channels;
+        for (int i = 0; i < n; ++i)
+            sum += f[i] * p[i];
+    }
+    return sum;
+}
+
+
+StarCascade::StarCascade(const Mixture & mixture, int pcaDim, int maxDisplacement)
+: models_(mixture.models()), pcaDim_(0), maxDisplacement_(max(maxDisplacement, 0))
+{
+    const int nbModels = this->models_.size();
+    if (nbModels == 0)
+        return;
+
+    // Principal components of the filter cells
+    const int nbFeatures = this->models_[0].nbFeatures();
+    this->pcaDim_ = max(1, min(pcaDim, nbFeatures));
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> scatter
+            = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>::Zero(nbFeatures, nbFeatures);
+    for (const Model & model : this->models_)
+        for (const Model::Part & part : model.parts_)
+            if (part.filter.channels() == nbFeatures)
+                scatter.noalias() += part.filter.asCellMatrix().transpose() * part.filter.asCellMatrix();
+    Eigen::SelfAdjointEigenSolver< Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> > eigen(scatter);
+    this->basis_ = eigen.eigenvectors().rightCols(this->pcaDim_); // eigenvalues are sorted in increasing order
+
+    // Project the filters and initialize the thresholds
+    this->pcaFilters_.resize(nbModels);
+    this->thresholds_.resize(nbModels);
+    this->positives_.resize(nbModels);
+    for (int i = 0; i < nbModels; ++i)
+    {
+        for (const Model::Part & part : this->models_[i].parts_)
+            this->pcaFilters_[i].push_back(this->project(part.filter));
+        this->thresholds_[i].assign(this->nbStages(i), -numeric_limits<Scalar>::infinity());
+    }
+}
+
+
+int StarCascade::nbStages(int component) const
+{
+    return (component >= 0 && component < static_cast<int>(this->models_.size())) ? 2 * this->models_[component].parts_.size() : 0;
+}
+
+
+string StarCascade::stageName(int stage)
+{
+    stringstream name;
+    if (stage / 2 == 0)
+        name << "root";
+    else
+        name << "part " << (stage / 2);
+    if (stage % 2 == 0)
+        name << " (PCA)";
+    return name.str();
+}
+
+
+bool StarCascade::setThresholds(int component, const vector<Scalar> & thresholds)
+{
+    if (component < 0 || component >= static_cast<int>(this->models_.size())
+            || static_cast<int>(thresholds.size()) != this->nbStages(component))
+        return false;
+    this->thresholds_[component] = thresholds;
+    return true;
+}
+
+
+FeatureMatrix StarCascade::project(const FeatureMatrix & features) const
+{
+    if (features.empty() || features.channels() != this->basis_.rows())
+        return FeatureMatrix();
+    FeatureMatrix projected(features.rows(), features.cols(), this->pcaDim_);
+    projected.asCellMatrix().noalias() = features.asCellMatrix() * this->basis_;
+    return projected;
+}
+
+
+StarCascade::Scalar StarCascade::scoreLocation(const FeaturePyramid & pyramid, const vector<FeatureMatrix> & projected,
+                                               int component, int level, int x, int y, vector<ScalarMatrix> & responses,
+                                               const Scalar * thresholds, Scalar * partials,
+                                               unsigned long long * evaluated, unsigned long long * pruned) const
+{
+    const Model & model = this->models_[component];
+    const vector<FeatureMatrix> & pcaFilters = this->pcaFilters_[component];
+    const int nbStages = this->nbStages(component);
+    const int partLevel = level - pyramid.interval();
+    const int R = this->maxDisplacement_;
+
+    Scalar score = model.bias_, estimate = 0;
+    for (int s = 0; s < nbStages; ++s)
+    {
+        const int f = s / 2;
+        const bool pca = (s % 2 == 0);
+        if (evaluated)
+            evaluated[s]++;
+
+        // Parts are not used on the first octave of the pyramid (just like in Model::convolve())
+        if (f == 0 || partLevel >= 0)
+        {
+            Scalar response;
+            if (f == 0)
+                response = (pca) ? correlate(projected[level], pcaFilters[0], x, y)
+                                 : correlate(pyramid.levels()[level], model.parts_[0].filter, x, y);
+            else
+            {
+                // Search for the best displacement of the part around its anchor on the part level
+                const Model::Part & part = model.parts_[f];
+                const FeatureMatrix & features = (pca) ? projected[partLevel] : pyramid.levels()[partLevel];
+                const FeatureMatrix & filter = (pca) ? pcaFilters[f] : part.filter;
+                ScalarMatrix & cache = responses[2 * f + ((pca) ? 0 : 1)];
+                response = -numeric_limits<Scalar>::infinity();
+                if (2 * x < features.cols() && 2 * y < features.rows())
+                {
+                    const int ax = 2 * x + part.offset(0), ay = 2 * y + part.offset(1);
+                    const int py1 = min(ay + R, static_cast<int>(features.rows()) - 1);
+                    const int px1 = min(ax + R, static_cast<int>(features.cols()) - 1);
+                    for (int py = max(ay - R, 0); py <= py1; ++py)
+                        for (int px = max(ax - R, 0); px <= px1; ++px)
+                        {
+                            Scalar r = cache(py, px);
+                            if (std::isnan(r))
+                                r = cache(py, px) = correlate(features, filter, px, py);
+                            const Scalar dx = ax - px, dy = ay - py;
+                            r += (part.deformation(0) * dx + part.deformation(1)) * dx
+                                 + (part.deformation(2) * dy + part.deformation(3)) * dy;
+                            if (r > response)
+                                response = r;
+                        }
+                }
+            }
+
+            if (response == -numeric_limits<Scalar>::infinity())
+            {
+                if (partials)
+                    partials[s] = response;
+                if (pruned)
+                    pruned[s]++;
+                return response;
+            }
+
+            // The full response replaces the estimate obtained from the PCA stage
+            score += (pca) ? response : response - estimate;
+            estimate = response;
+        }
+
+        if (partials)
+            partials[s] = score;
+        if (thresholds && score < thresholds[s])
+        {
+            if (pruned)
+                pruned[s]++;
+            return -numeric_limits<Scalar>::infinity();
+        }
+    }
+    return score;
+}
+
+
+bool StarCascade::addPositive(const FeaturePyramid & pyramid, int level, int x, int y, int component)
+{
+    if (component < 0 || component >= static_cast<int>(this->models_.size()) || pyramid.empty()
+            || level < 0 || level >= static_cast<int>(pyramid.levels().size())
+            || x < 0 || y < 0 || x >= pyramid.levels()[level].cols() || y >= pyramid.levels()[level].rows()
+            || pyramid.levels()[level].channels() != this->basis_.rows())
+        return false;
+
+    // Project only the levels needed
+    const int partLevel = level - pyramid.interval();
+    vector<FeatureMatrix> projected(pyramid.levels().size());
+    projected[level] = this->project(pyramid.levels()[level]);
+    vector<ScalarMatrix> responses(2 * this->models_[component].parts_.size());
+    if (partLevel >= 0)
+    {
+        const FeatureMatrix & partFeatures = pyramid.levels()[partLevel];
+        projected[partLevel] = this->project(partFeatures);
+        for (size_t i = 2; i < responses.size(); ++i)
+            responses[i].setConstant(partFeatures.rows(), partFeatures.cols(), numeric_limits<Scalar>::quiet_NaN());
+    }
+
+    vector<Scalar> partials(this->nbStages(component));
+    if (this->scoreLocation(pyramid, projected, component, level, x, y, responses, NULL, partials.data(), NULL, NULL)
+            == -numeric_limits<Scalar>::infinity())
+        return false;
+    this->positives_[component].push_back(move(partials));
+    return true;
+}
+
+
+int StarCascade::nbPositives() const
+{
+    int nbPositives = 0;
+    for (const auto & positives : this->positives_)
+        nbPositives += positives.size();
+    return nbPositives;
+}
+
+
+void StarCascade::learnThresholds(double tolerance, Scalar minScore)
+{
+    tolerance = max(0.0, min(tolerance, 1.0));
+    for (size_t c = 0; c < this->positives_.size(); ++c)
+    {
+        vector< vector<Scalar> > & positives = this->positives_[c];
+        if (positives.empty())
+            continue;
+
+        // Only positives which would be detected matter
+        vector<size_t> detected;
+        for (size_t i = 0; i < positives.size(); ++i)
+            if (positives[i].back() >= minScore)
+                detected.push_back(i);
+        if (detected.empty())
+            for (size_t i = 0; i < positives.size(); ++i)
+                detected.push_back(i);
+
+        const size_t rank = min(static_cast<size_t>(tolerance * detected.size()), detected.size() - 1);
+        vector<Scalar> partials(detected.size());
+        for (int s = 0; s < this->nbStages(c); ++s)
+        {
+            for (size_t i = 0; i < detected.size(); ++i)
+                partials[i] = positives[detected[i]][s];
+            nth_element(partials.begin(), partials.begin() + rank, partials.end());
+            this->thresholds_[c][s] = partials[rank];
+        }
+        positives.clear();
+    }
+}
+
+
+void StarCascade::computeScores(const FeaturePyramid & pyramid, vector<ScalarMatrix> & scores,
+                                vector<Mixture::Indices> & argmaxes, Statistics * stats) const
+{
+    vector< vector<ScalarMatrix> > componentScores;
+    this->computeScores(pyramid, componentScores, stats);
+    if (componentScores.empty())
+    {
+        scores.clear();
+        argmaxes.clear();
+        return;
+    }
+
+    const int nbLevels = componentScores[0].size();
+    scores.resize(nbLevels);
+    argmaxes.resize(nbLevels);
+    int i;
+#pragma omp parallel for private(i)
+    for (i = 0; i < nbLevels; ++i)
+    {
+        vector<const ScalarMatrix *> components;
+        for (const vector<ScalarMatrix> & component : componentScores)
+            components.push_back(&component[i]);
+        MaxComponents(components, scores[i], &argmaxes[i]);
+    }
+}
+
+void StarCascade::computeScores(const FeaturePyramid & pyramid, vector< vector<ScalarMatrix> > & componentScores,
+                                Statistics * stats) const
+{
+    const int nbLevels = pyramid.levels().size();
+    const int nbModels = this->models_.size();
+    if (this->empty() || pyramid.empty() || pyramid.levels()[0].channels() != this->basis_.rows())
+    {
+        componentScores.clear();
+        if (stats)
+            *stats = Statistics();
+        return;
+    }
+
+    int maxStages = 0;
+    for (int c = 0; c < nbModels; ++c)
+        maxStages = max(maxStages, this->nbStages(c));
+
+    // Project all levels
+    vector<FeatureMatrix> projected(nbLevels);
+    int i;
+#pragma omp parallel for private(i)
+    for (i = 0; i < nbLevels; ++i)
+        projected[i] = this->project(pyramid.levels()[i]);
+
+    componentScores.assign(nbModels, vector<ScalarMatrix>(nbLevels));
+    vector< vector<unsigned long long> > evaluated(nbLevels, vector<unsigned long long>(maxStages, 0));
+    vector< vector<unsigned long long> > pruned(nbLevels, vector<unsigned long long>(maxStages, 0));
+
+#pragma omp parallel for private(i)
+    for (i = 0; i < nbLevels; ++i)
+    {
+        const int rows = pyramid.levels()[i].rows(), cols = pyramid.levels()[i].cols();
+        const int partLevel = i - pyramid.interval();
+        for (int c = 0; c < nbModels; ++c)
+        {
+            ScalarMatrix & scores = componentScores[c][i];
+            scores.resize(rows, cols);
+
+            // Part responses on the level one octave below, computed on demand
+            vector<ScalarMatrix> responses(this->nbStages(c));
+            if (partLevel >= 0)
+                for (size_t r = 2; r < responses.size(); ++r)
+                    responses[r].setConstant(pyramid.levels()[partLevel].rows(), pyramid.levels()[partLevel].cols(),
+                                             numeric_limits<Scalar>::quiet_NaN());
+
+            for (int y = 0; y < rows; ++y)
+                for (int x = 0; x < cols; ++x)
+                    scores(y, x) = this->scoreLocation(pyramid, projected, c, i, x, y, responses,
+                                                       this->thresholds_[c].data(), NULL,
+                                                       evaluated[i].data(), pruned[i].data());
+        }
+    }
+
+    if (stats)
+    {
+        stats->locations = 0;
+        stats->evaluated.assign(maxStages, 0);
+        stats->pruned.assign(maxStages, 0);
+        for (i = 0; i < nbLevels; ++i)
+        {
+            stats->locations += static_cast<unsigned long long>(nbModels) * pyramid.levels()[i].rows() * pyramid.levels()[i].cols();
+            for (int s = 0; s < maxStages; ++s)
+            {
+                stats->evaluated[s] += evaluated[i][s];
+                stats->pruned[s] += pruned[i][s];
+            }
+        }
+    }
+}
@@ -0,0 +1,238 @@
+#ifndef ARTOS_STARCASCADE_H
+#define ARTOS_STARCASCADE_H
+
+#include <string>
+#include <vector>
+#include <limits>
+#include "Mixture.h"
+
+namespace ARTOS
+{
+
+/**
+* Evaluates the models of a mixture as star-cascades (Felzenszwalb et al.: "Cascade Object Detection
+* with Deformable Part Models", CVPR 2010) instead of convolving all filters densely with the whole pyramid.
+*
+* The score of each root location is accumulated filter by filter, starting with the root. Each filter
+* is evaluated in two stages: first using a low-dimensional PCA projection of the filter and the features,
+* then using the full filter, which replaces the estimate of the first stage. After each stage, the location
+* is pruned if the partial score falls below a threshold learned from positive samples. Thus, parts are only
+* evaluated at root locations which survived the previous stages. Their responses are computed lazily and
+* shared among neighbouring root locations.
+*
+* The scores of locations which have not been pruned equal those of Mixture::convolve() up to rounding,
+* except that features outside of the pyramid levels are treated as zero and the displacement of parts
+* is limited to a window around their anchor.
+*/
+class StarCascade
+{
+
+public:
+
+    typedef FeatureScalar Scalar; /**< Type of a scalar value. */
+
+    /**
+    * Number of locations evaluated and pruned at each stage of the cascade during a call to computeScores().
+    * Stages are numbered as described for stageName().
+    */
+    struct Statistics
+    {
+        unsigned long long locations; /**< Number of root locations of all models on all levels. */
+        std::vector<unsigned long long> evaluated; /**< Number of locations which entered each stage. */
+        std::vector<unsigned long long> pruned; /**< Number of locations pruned after each stage. */
+
+        Statistics() : locations(0) {};
+    };
+
+    /**
+    * Constructs an empty cascade.
+    */
+    StarCascade() : pcaDim_(0), maxDisplacement_(0) {};
+
+    /**
+    * Constructs a cascade for the models of a given mixture. The PCA basis is given by the principal
+    * components of the cells of all filters of the mixture, so that it preserves as much of the filters
+    * as possible. All thresholds are initialized to minus infinity, i.e. nothing will be pruned until
+    * thresholds have been learned using addPositive() and learnThresholds() or set using setThresholds().
+    *
+    * @param[in] mixture The mixture. Its models will be copied.
+    *
+    * @param[in] pcaDim Number of dimensions of the PCA projection.
+    *
+    * @param[in] maxDisplacement Maximum distance (in cells) between a part and its anchor, in each direction.
+    */
+    StarCascade(const Mixture & mixture, int pcaDim = 5, int maxDisplacement = 4);
+
+    /**
+    * @return Returns true if this cascade has not been constructed from a mixture.
+    */
+    bool empty() const { return this->models_.empty(); };
+
+    /**
+    * @return Returns the number of dimensions of the PCA projection.
+    */
+    int pcaDim() const { return this->pcaDim_; };
+
+    /**
+    * @return Returns the maximum displacement of a part from its anchor.
+    */
+    int maxDisplacement() const { return this->maxDisplacement_; };
+
+    /**
+    * @return Returns the number of models (mixture components).
+    */
+    int nbComponents() const { return this->models_.size(); };
+
+    /**
+    * @param[in] component Index of a model.
+    *
+    * @return Returns the number of stages of the cascade of a given model (two per filter).
+    */
+    int nbStages(int component) const;
+
+    /**
+    * @param[in] stage Index of a stage.
+    *
+    * @return Returns a description of a stage: Stage `2 * i` is the PCA stage of filter `i` and stage `2 * i + 1`
+    * the full stage of that filter, where filter 0 is the root and filter `i > 0` part `i`.
+    */
+    static std::string stageName(int stage);
+
+    /**
+    * @param[in] component Index of a model.
+    *
+    * @return Returns the pruning thresholds of the stages of a given model.
+    */
+    const std::vector<Scalar> & thresholds(int component) const { return this->thresholds_[component]; };
+
+    /**
+    * Sets the pruning thresholds of the stages of a model explicitly.
+    *
+    * @param[in] component Index of a model.
+    *
+    * @param[in] thresholds One threshold per stage (see nbStages()).
+    *
+    * @return Returns false if the index of the model or the number of thresholds is invalid.
+    */
+    bool setThresholds(int component, const std::vector<Scalar> & thresholds);
+
+    /**
+    * Records the partial scores of a model at a positive sample for learning the thresholds.
+    *
+    * @param[in] pyramid The pyramid of the image containing the sample.
+    *
+    * @param[in] level The pyramid level of the sample.
+    *
+    * @param[in] x The horizontal position of the root on that level.
+    *
+    * @param[in] y The vertical position of the root on that level.
+    *
+    * @param[in] component The index of the model which detected the sample.
+    *
+    * @return Returns false if the sample is invalid or the model cannot be evaluated at that location.
+    */
+    bool addPositive(const FeaturePyramid & pyramid, int level, int x, int y, int component);
+
+    /**
+    * @return Returns the number of positive samples recorded by addPositive() since the last call to learnThresholds().
+    */
+    int nbPositives() const;
+
+    /**
+    * Sets the threshold of each stage to the lowest partial score of the positive samples recorded by
+    * addPositive(), so that none of them would be pruned, and discards the samples. The thresholds of
+    * models without samples will not be changed.
+    *
+    * @param[in] tolerance Fraction of the positive samples which may be pruned at each stage. Greater values
+    * lead to more aggressive pruning.
+    *
+    * @param[in] minScore Only samples with a final score of at least this value will be considered,
+    * unless there are none. This should be the detection threshold, since samples below it are
+    * not detected anyway.
+    */
+    void learnThresholds(double tolerance = 0.0, Scalar minScore = -std::numeric_limits<Scalar>::infinity());
+
+    /**
+    * Computes the scores of the mixture on a pyramid using the cascades of its models.
+    *
+    * @param[in] pyramid Pyramid of features.
+    *
+    * @param[out] scores Scores for each pyramid level. Pruned locations have a score of minus infinity.
+    *
+    * @param[out] argmaxes Indices of the best model for each pyramid level.
+    *
+    * @param[out] stats Optionally, receives the number of locations pruned at each stage.
+    */
+    void computeScores(const FeaturePyramid & pyramid, std::vector<ScalarMatrix> & scores,
+                       std::vector<Mixture::Indices> & argmaxes, Statistics * stats = 0) const;
+
+    /**
+    * Computes the scores of each model of the mixture on a pyramid using their cascades, without
+    * selecting the best model at each location.
+    *
+    * @param[in] pyramid Pyramid of features.
+    *
+    * @param[out] componentScores Scores of each model for each pyramid level (`models x levels`).
+    * Pruned locations have a score of minus infinity.
+    *
+    * @param[out] stats Optionally, receives the number of locations pruned at each stage.
+    */
+    void computeScores(const FeaturePyramid & pyramid, std::vector< std::vector<ScalarMatrix> > & componentScores,
+                       Statistics * stats = 0) const;
+
+
+private:
+
+    /**
+    * Projects the features of a pyramid level or a filter onto the PCA basis.
+    */
+    FeatureMatrix project(const FeatureMatrix & features) const;
+
+    /**
+    * Computes the score of a model at a single root location, stage by stage.
+    *
+    * @param[in] pyramid The feature pyramid.
+    *
+    * @param[in] projected The projections of the levels of the pyramid, where only the root level and the
+    * corresponding part level have to be set.
+    *
+    * @param[in] component Index of the model.
+    *
+    * @param[in] level Pyramid level of the root.
+    *
+    * @param[in] x Horizontal position of the root.
+    *
+    * @param[in] y Vertical position of the root.
+    *
+    * @param[in,out] responses Lazily computed responses of the PCA filter and the full filter of each part
+    * (`2 * filters`) on the part level. Unknown responses must be NaN.
+    *
+    * @param[in] thresholds If not NULL, the location will be pruned as soon as a partial score falls below the
+    * threshold of the respective stage.
+    *
+    * @param[out] partials If not NULL, receives the partial score after each stage.
+    *
+    * @param[in,out] evaluated If not NULL, the counter of each stage entered will be incremented.
+    *
+    * @param[in,out] pruned If not NULL, the counter of the stage at which the location is pruned will be incremented.
+    *
+    * @return Returns the score of the model at the given location or minus infinity if it has been pruned.
+    */
+    Scalar scoreLocation(const FeaturePyramid & pyramid, const std::vector<FeatureMatrix> & projected,
+                         int component, int level, int x, int y, std::vector<ScalarMatrix> & responses,
+                         const Scalar * thresholds, Scalar * partials,
+                         unsigned long long * evaluated, unsigned long long * pruned) const;
+
+    std::vector<Model> models_; /**< The models of the mixture. */
+    int pcaDim_; /**< Number of dimensions of the PCA projection. */
+    int maxDisplacement_; /**< Maximum displacement of a part from its anchor. */
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> basis_; /**< The PCA basis (`features x pcaDim`). */
+    std::vector< std::vector<FeatureMatrix> > pcaFilters_; /**< Projected filters of each model. */
+    std::vector< std::vector<Scalar> > thresholds_; /**< Pruning thresholds of each stage of each model. */
+    std::vector< std::vector< std::vector<Scalar> > > positives_; /**< Partial scores of positive samples of each model. */
+
+};
+
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include <fftw3.h>
 #include "portable_endian.h"
 #include "FeaturePyramid.h"
+#include "PatchworkContext.h"
 #include "JPEGImage.h"
 using namespace ARTOS;
 using namespace std;
@@ -296,6 +297,7 @@ void StationaryBackground::learnCovariance(ImageIterator & imgIt, const unsigned
     FILE * wisdom_file = fopen("wisdom.fftw", "r");
     if (wisdom_file)
     {
+        auto plannerLock = PatchworkContext::plannerLock();
         fftwf_import_wisdom_from_file(wisdom_file);
         fclose(wisdom_file);
     }
@@ -335,6 +337,7 @@ void StationaryBackground::learnCovariance(ImageIterator & imgIt, const unsigned
                 {
                     int size[2] = {static_cast<int>(levelIt->rows()), static_cast<int>(levelIt->cols())};
                     FeatureMatrix tmp(*levelIt); // backup data of the level
+                    auto plannerLock = PatchworkContext::plannerLock(); // the FFTW planner is not thread-safe
                     ft_forwards = fftwf_plan_many_dft_r2c(
                         2, size, numFeat,
                         levelIt->raw(), NULL, levelIt->channels(), 1,
@@ -376,8 +379,11 @@ void StationaryBackground::learnCovariance(ImageIterator & imgIt, const unsigned
                         }
                     }
                 }
-                fftwf_destroy_plan(ft_forwards);
-                fftwf_destroy_plan(ft_inverse);
+                {
+                    auto plannerLock = PatchworkContext::plannerLock();
+                    fftwf_destroy_plan(ft_forwards);
+                    fftwf_destroy_plan(ft_inverse);
+                }
             }
         }
     }
@@ -400,6 +406,7 @@ void StationaryBackground::learnCovariance(ImageIterator & imgIt, const unsigned
     wisdom_file = fopen("wisdom.fftw", "w");
     if (wisdom_file)
     {
+        auto plannerLock = PatchworkContext::plannerLock();
         fftwf_export_wisdom_to_file(wisdom_file);
         fclose(wisdom_file);
     }
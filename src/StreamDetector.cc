@@ -0,0 +1,186 @@
+#include "StreamDetector.h"
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace ARTOS;
+using namespace std;
+
+/**
+* Sets the number of threads used by parallel regions started by the calling stage.
+*/
+static void setStageThreads(int numThreads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(numThreads);
+#endif
+}
+
+
+StreamDetector::StreamDetector(DPMDetection & detector, unsigned int numThreads, unsigned int queueCapacity)
+: m_detector(detector),
+#ifdef _OPENMP
+  m_stageThreads(max(1, static_cast<int>((numThreads > 0) ? numThreads : omp_get_max_threads()) / 2)),
+#else
+  m_stageThreads(1),
+#endif
+  m_stopped(false), m_nextFrameId(1),
+  m_framesIn(queueCapacity, true), m_pyramidsOut(queueCapacity), m_candidatesOut(queueCapacity),
+  m_startTime(Clock::now()), m_framesProcessed(0), m_maxLatency(0),
+  m_totalLatency(0), m_totalPyramidTime(0), m_totalConvolutionTime(0), m_totalSuppressionTime(0)
+{
+    this->m_threads.push_back(thread(&StreamDetector::runPyramidStage, this));
+    this->m_threads.push_back(thread(&StreamDetector::runConvolutionStage, this));
+    this->m_threads.push_back(thread(&StreamDetector::runSuppressionStage, this));
+}
+
+StreamDetector::~StreamDetector()
+{
+    this->stop();
+}
+
+unsigned long long StreamDetector::pushFrame(const JPEGImage & frame)
+{
+    if (this->m_stopped)
+        return 0;
+
+    unique_ptr<Frame> item(new Frame());
+    item->pushed = Clock::now();
+    item->width = frame.width();
+    item->height = frame.height();
+    item->image = frame;
+    {
+        lock_guard<mutex> lock(this->m_resultMutex);
+        item->id = this->m_nextFrameId++;
+    }
+    const unsigned long long id = item->id;
+    return (this->m_framesIn.push(move(item))) ? id : 0;
+}
+
+int StreamDetector::getDetections(vector<Detection> & detections, unsigned long long * frameId, unsigned int timeout)
+{
+    unique_lock<mutex> lock(this->m_resultMutex);
+    if (!this->m_resultAvailable.wait_for(lock, chrono::milliseconds(timeout), [this]() { return this->m_result != nullptr; }))
+        return ARTOS_DETECT_RES_NO_RESULTS;
+
+    unique_ptr<Frame> result = move(this->m_result);
+    lock.unlock();
+
+    detections = move(result->detections);
+    if (frameId != NULL)
+        *frameId = result->id;
+    return result->result;
+}
+
+void StreamDetector::stop()
+{
+    if (this->m_stopped.exchange(true))
+        return;
+
+    this->m_framesIn.close(true);
+    this->m_pyramidsOut.close(true);
+    this->m_candidatesOut.close(true);
+    for (thread & t : this->m_threads)
+        if (t.joinable())
+            t.join();
+    this->m_threads.clear();
+}
+
+StreamStatistics StreamDetector::getStatistics() const
+{
+    lock_guard<mutex> lock(this->m_resultMutex);
+    StreamStatistics stats;
+    stats.framesPushed = this->m_nextFrameId - 1;
+    stats.framesDropped = this->m_framesIn.numDropped();
+    stats.framesProcessed = this->m_framesProcessed;
+    const double seconds = chrono::duration<double>(Clock::now() - this->m_startTime).count();
+    stats.framesPerSecond = (seconds > 0) ? this->m_framesProcessed / seconds : 0;
+    if (this->m_framesProcessed > 0)
+    {
+        stats.meanLatency = this->m_totalLatency / this->m_framesProcessed;
+        stats.maxLatency = this->m_maxLatency;
+        stats.meanPyramidTime = this->m_totalPyramidTime / this->m_framesProcessed;
+        stats.meanConvolutionTime = this->m_totalConvolutionTime / this->m_framesProcessed;
+        stats.meanSuppressionTime = this->m_totalSuppressionTime / this->m_framesProcessed;
+    }
+    return stats;
+}
+
+void StreamDetector::runPyramidStage()
+{
+    setStageThreads(this->m_stageThreads);
+    DPMDetection::DetectionState state;
+    unique_ptr<Frame> frame;
+    while (this->m_framesIn.pop(frame))
+    {
+        const Clock::time_point stageStart = Clock::now();
+        frame->models = state.models = this->m_detector.getModelSet();
+        if (frame->models->mixtures.empty())
+            frame->result = ARTOS_DETECT_RES_NO_MODELS;
+        else
+        {
+            frame->pyramids.resize(frame->models->featureExtractors.size());
+            for (unsigned int feIndex = 0; feIndex < frame->pyramids.size() && frame->result == ARTOS_RES_OK; ++feIndex)
+                frame->result = this->m_detector.computePyramid(state, frame->image, feIndex, frame->pyramids[feIndex]);
+        }
+        frame->image = JPEGImage();
+        state.models.reset();
+        frame->pyramidTime = chrono::duration<double, milli>(Clock::now() - stageStart).count();
+        if (!this->m_pyramidsOut.push(move(frame)))
+            break;
+    }
+}
+
+void StreamDetector::runConvolutionStage()
+{
+    setStageThreads(this->m_stageThreads);
+    DPMDetection::DetectionState state(NULL, false);
+    unique_ptr<Frame> frame;
+    while (this->m_pyramidsOut.pop(frame))
+    {
+        const Clock::time_point stageStart = Clock::now();
+        // The context is leased for a single frame only, so that it is back in its pool between two frames,
+        // where DPMDetection::setModelSet() caches the filters of new models in it
+        state.models = frame->models;
+        state.lease = this->m_detector.acquireContext(this->m_detector.batchContexts);
+        state.context = state.lease.get();
+        for (unsigned int feIndex = 0; feIndex < frame->pyramids.size() && frame->result == ARTOS_RES_OK; ++feIndex)
+            frame->result = this->m_detector.findCandidates(state, frame->width, frame->height, frame->pyramids[feIndex],
+                                                            frame->candidates, feIndex);
+        frame->pyramids.clear();
+        state.context = NULL;
+        state.lease.reset();
+        state.models.reset();
+        frame->convolutionTime = chrono::duration<double, milli>(Clock::now() - stageStart).count();
+        if (!this->m_candidatesOut.push(move(frame)))
+            break;
+    }
+}
+
+void StreamDetector::runSuppressionStage()
+{
+    const DPMDetection::DetectionState state;
+    unique_ptr<Frame> frame;
+    while (this->m_candidatesOut.pop(frame))
+    {
+        const Clock::time_point stageStart = Clock::now();
+        if (frame->result == ARTOS_RES_OK)
+            this->m_detector.suppressCandidates(state, frame->candidates, frame->detections);
+        frame->candidates.clear();
+        frame->models.reset();
+        const Clock::time_point stageEnd = Clock::now();
+
+        lock_guard<mutex> lock(this->m_resultMutex);
+        const double latency = chrono::duration<double, milli>(stageEnd - frame->pushed).count();
+        this->m_framesProcessed++;
+        this->m_totalLatency += latency;
+        this->m_maxLatency = max(this->m_maxLatency, latency);
+        this->m_totalPyramidTime += frame->pyramidTime;
+        this->m_totalConvolutionTime += frame->convolutionTime;
+        this->m_totalSuppressionTime += chrono::duration<double, milli>(stageEnd - stageStart).count();
+        this->m_result = move(frame); // results not retrieved yet are superseded by newer ones
+        this->m_resultAvailable.notify_all();
+    }
+}
@@ -0,0 +1,177 @@
+#ifndef ARTOS_STREAMDETECTOR_H
+#define ARTOS_STREAMDETECTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DPMDetection.h"
+#include "BoundedQueue.h"
+#include "FeaturePyramid.h"
+#include "JPEGImage.h"
+
+namespace ARTOS
+{
+
+/**
+* Throughput and latency of the frames processed by a StreamDetector.
+* All times are given in milliseconds.
+*/
+struct StreamStatistics
+{
+    unsigned long long framesPushed; /**< Number of frames pushed to the stream. */
+    unsigned long long framesDropped; /**< Number of frames discarded in favour of newer ones before being processed. */
+    unsigned long long framesProcessed; /**< Number of frames whose detections are available. */
+    double framesPerSecond; /**< Number of frames processed per second since the stream has been started. */
+    double meanLatency; /**< Mean time between pushing a frame and the availability of its detections. */
+    double maxLatency; /**< Maximum time between pushing a frame and the availability of its detections. */
+    double meanPyramidTime; /**< Mean time needed for computing the feature pyramids of a frame. */
+    double meanConvolutionTime; /**< Mean time needed for the convolutions and the search for local maxima. */
+    double meanSuppressionTime; /**< Mean time needed for non-maximum suppression. */
+    
+    StreamStatistics() : framesPushed(0), framesDropped(0), framesProcessed(0), framesPerSecond(0), meanLatency(0),
+                         maxLatency(0), meanPyramidTime(0), meanConvolutionTime(0), meanSuppressionTime(0) {};
+};
+
+
+/**
+* Detects objects in a stream of images, such as the frames of a video, using the models of a DPMDetection
+* instance. Instead of processing one frame after another, the stages of detection run concurrently in a
+* pipeline: While the feature pyramid of frame N+1 is being computed, frame N is convolved with the filters
+* and non-maximum suppression is applied to the detections of frame N-1.
+*
+* The stages are connected by bounded queues. If frames are pushed faster than they can be processed,
+* pending frames which have not been processed yet are discarded in favour of the newest one, so that the
+* throughput approaches that of the slowest stage and latency stays bounded.
+*
+* If the models of the detector are changed while the stream is running, frames pushed afterwards will be processed
+* with the new models, while the frames in the pipeline are completed with the old ones.
+*
+* The stream keeps a reference to the detector and leases patchwork contexts from it, so the detector must
+* outlive the stream and must not be moved while the stream is running.
+*/
+class StreamDetector
+{
+
+public:
+
+    /**
+    * Starts a stream. The threads of the pipeline are started immediately and wait for frames.
+    *
+    * @param[in] detector The detector whose models are to be used. It must not be destroyed or moved before
+    * the stream has been destroyed.
+    *
+    * @param[in] numThreads The number of threads available for the stages computing the feature pyramids and
+    * the convolutions, which are split among them. 0 means the number of threads available to OpenMP.
+    *
+    * @param[in] queueCapacity The maximum number of frames waiting in front of each stage.
+    */
+    StreamDetector(DPMDetection & detector, unsigned int numThreads = 0, unsigned int queueCapacity = 1);
+    
+    /**
+    * Stops the stream and waits for all threads to terminate.
+    */
+    virtual ~StreamDetector();
+    
+    StreamDetector(const StreamDetector &) = delete;
+    StreamDetector & operator=(const StreamDetector &) = delete;
+    
+    /**
+    * Pushes a new frame to the stream. This function does not block: If the queue of frames waiting to
+    * be processed is full, the oldest one will be discarded.
+    *
+    * @param[in] frame The frame.
+    *
+    * @return Returns the ID of the frame, which is 1 for the first frame and incremented for every
+    * subsequent one, or 0 if the stream has been stopped.
+    */
+    unsigned long long pushFrame(const JPEGImage & frame);
+    
+    /**
+    * Retrieves the detections of the most recent frame processed completely, if they have not been
+    * retrieved before.
+    *
+    * @param[out] detections Receives the detections of the frame.
+    *
+    * @param[out] frameId If not NULL, receives the ID of the frame as returned by pushFrame().
+    *
+    * @param[in] timeout The maximum number of milliseconds to wait for new results.
+    *
+    * @return Returns ARTOS_RES_OK on success, ARTOS_DETECT_RES_NO_RESULTS if no new results have become
+    * available within the timeout or the error code of DPMDetection::detect() if the frame could not be processed.
+    */
+    int getDetections(std::vector<Detection> & detections, unsigned long long * frameId = 0, unsigned int timeout = 0);
+    
+    /**
+    * Stops the stream. Frames still being processed are discarded and the threads of the pipeline are terminated.
+    * Subsequent calls to pushFrame() will be ignored.
+    */
+    void stop();
+    
+    /**
+    * @return Returns true if the stream has not been stopped yet.
+    */
+    bool running() const { return !this->m_stopped; };
+    
+    /**
+    * @return Returns throughput and latency of the frames processed so far.
+    */
+    StreamStatistics getStatistics() const;
+
+
+protected:
+
+    typedef std::chrono::steady_clock Clock;
+    
+    /**
+    * A frame on its way through the pipeline.
+    */
+    struct Frame
+    {
+        unsigned long long id; /**< The ID of the frame. */
+        Clock::time_point pushed; /**< The time when the frame has been pushed. */
+        int result; /**< ARTOS_RES_OK or the error code of the first stage which failed. */
+        int width; /**< The width of the frame. */
+        int height; /**< The height of the frame. */
+        JPEGImage image; /**< The frame itself, released after the feature pyramids have been computed. */
+        std::shared_ptr<const DPMDetection::ModelSet> models; /**< The models used for all stages of processing this frame. */
+        std::vector<FeaturePyramid> pyramids; /**< Feature pyramid for each feature extractor. */
+        std::vector< std::vector<Detection> > candidates; /**< Detections of each class before non-maximum suppression. */
+        std::vector<Detection> detections; /**< The final detections. */
+        double pyramidTime; /**< Time needed for computing the feature pyramids in milliseconds. */
+        double convolutionTime; /**< Time needed for finding the candidate detections in milliseconds. */
+    
+        Frame() : id(0), result(0), width(0), height(0), pyramidTime(0), convolutionTime(0) {};
+    };
+    
+    DPMDetection & m_detector;
+    int m_stageThreads; /**< Number of OpenMP threads available to each of the first two stages. */
+    std::atomic<bool> m_stopped;
+    unsigned long long m_nextFrameId;
+    
+    BoundedQueue< std::unique_ptr<Frame> > m_framesIn; /**< Frames waiting for the pyramid stage. */
+    BoundedQueue< std::unique_ptr<Frame> > m_pyramidsOut; /**< Frames waiting for the convolution stage. */
+    BoundedQueue< std::unique_ptr<Frame> > m_candidatesOut; /**< Frames waiting for the suppression stage. */
+    std::vector<std::thread> m_threads;
+    
+    mutable std::mutex m_resultMutex;
+    std::condition_variable m_resultAvailable;
+    std::unique_ptr<Frame> m_result; /**< The latest frame processed completely and not retrieved yet. */
+    Clock::time_point m_startTime;
+    unsigned long long m_framesProcessed;
+    double m_maxLatency;
+    double m_totalLatency, m_totalPyramidTime, m_totalConvolutionTime, m_totalSuppressionTime;
+    
+    void runPyramidStage();
+    void runConvolutionStage();
+    void runSuppressionStage();
+
+};
+
+}
+
+#endif
@@ -47,21 +47,12 @@ struct PositionComparator
 };
 }
 
-int BLF(vector<PatchworkRectangle> & rectangles, unsigned int maxWidth, unsigned int maxHeight)
+namespace detail
+{
+// Places the rectangles in the given order using the bottom-left fill heuristic and returns the number of planes.
+static int bottomLeftFill(vector<PatchworkRectangle> & rectangles, const vector<int> & ordering,
+                          unsigned int maxWidth, unsigned int maxHeight)
 {
-    // Order the rectangles by decreasing area. If a rectangle is bigger than MaxRows x MaxCols
-    // return -1
-    vector<int> ordering(rectangles.size());
-    
-    for (int i = 0; i < rectangles.size(); ++i) {
-        if ((rectangles[i].width() > maxWidth) || (rectangles[i].height() > maxHeight))
-            return -1;
-        
-        ordering[i] = i;
-    }
-    
-    sort(ordering.begin(), ordering.end(), detail::AreaComparator(rectangles));
-    
     // Index of the plane containing each rectangle
     for (int i = 0; i < rectangles.size(); ++i)
         rectangles[i].setPlane(-1);
@@ -136,4 +127,225 @@ int BLF(vector<PatchworkRectangle> & rectangles, unsigned int maxWidth, unsigned
     return gaps.size();
 }
 
-}
\ No newline at end of file
+// A horizontal segment of the skyline of a plane, i.e. the lowest free row for a range of columns
+struct SkylineSegment
+{
+    int x, y, width;
+};
+
+// Places the rectangles in the given order using a skyline heuristic and returns the number of planes.
+// Each rectangle is placed on the first plane where it fits, at the position with the smallest y and then x.
+static int skylineFill(vector<PatchworkRectangle> & rectangles, const vector<int> & ordering,
+                       unsigned int maxWidth, unsigned int maxHeight)
+{
+    vector< vector<SkylineSegment> > skylines;
+    
+    for (int i = 0; i < ordering.size(); ++i)
+    {
+        PatchworkRectangle & rect = rectangles[ordering[i]];
+        rect.setPlane(-1);
+        
+        int bestX = 0, bestY = 0;
+        for (int p = 0; (rect.plane() == -1) && (p <= skylines.size()); ++p)
+        {
+            if (p == skylines.size())
+            {
+                SkylineSegment empty = { 0, 0, static_cast<int>(maxWidth) };
+                skylines.push_back(vector<SkylineSegment>(1, empty));
+            }
+            
+            // Find the lowest (then leftmost) position at the beginning of a segment where the rectangle fits
+            const vector<SkylineSegment> & skyline = skylines[p];
+            for (int s = 0; s < skyline.size(); ++s)
+            {
+                const int x = skyline[s].x;
+                if (x + rect.width() > static_cast<int>(maxWidth))
+                    break;
+                int y = 0;
+                for (int t = s; (t < skyline.size()) && (skyline[t].x < x + rect.width()); ++t)
+                    y = max(y, skyline[t].y);
+                if ((y + rect.height() <= static_cast<int>(maxHeight))
+                        && ((rect.plane() == -1) || (y < bestY) || ((y == bestY) && (x < bestX))))
+                {
+                    rect.setPlane(p);
+                    bestX = x;
+                    bestY = y;
+                }
+            }
+        }
+        
+        if (rect.plane() == -1) // the rectangle does not even fit on an empty plane
+            return -1;
+        rect.setX(bestX);
+        rect.setY(bestY);
+        
+        // Raise the skyline below the new rectangle
+        vector<SkylineSegment> & skyline = skylines[rect.plane()];
+        vector<SkylineSegment> updated;
+        updated.reserve(skyline.size() + 2);
+        const int left = bestX, right = bestX + rect.width();
+        bool inserted = false;
+        for (const SkylineSegment & seg : skyline)
+        {
+            const int segRight = seg.x + seg.width;
+            if (segRight <= left || seg.x >= right)
+            {
+                if (seg.x >= right && !inserted)
+                {
+                    SkylineSegment top = { left, bestY + rect.height(), rect.width() };
+                    updated.push_back(top);
+                    inserted = true;
+                }
+                updated.push_back(seg);
+                continue;
+            }
+            if (seg.x < left)
+            {
+                SkylineSegment head = { seg.x, seg.y, left - seg.x };
+                updated.push_back(head);
+            }
+            if (!inserted)
+            {
+                SkylineSegment top = { left, bestY + rect.height(), rect.width() };
+                updated.push_back(top);
+                inserted = true;
+            }
+            if (segRight > right)
+            {
+                SkylineSegment tail = { right, seg.y, segRight - right };
+                updated.push_back(tail);
+            }
+        }
+        if (!inserted)
+        {
+            SkylineSegment top = { left, bestY + rect.height(), rect.width() };
+            updated.push_back(top);
+        }
+        
+        // Merge neighbouring segments of the same height
+        skyline.clear();
+        for (const SkylineSegment & seg : updated)
+            if (!skyline.empty() && skyline.back().y == seg.y)
+                skyline.back().width += seg.width;
+            else
+                skyline.push_back(seg);
+    }
+    
+    return skylines.size();
+}
+}
+
+int BLF(vector<PatchworkRectangle> & rectangles, unsigned int maxWidth, unsigned int maxHeight)
+{
+    // Order the rectangles by decreasing area. If a rectangle is bigger than MaxRows x MaxCols
+    // return -1
+    vector<int> ordering(rectangles.size());
+    
+    for (int i = 0; i < rectangles.size(); ++i) {
+        if ((rectangles[i].width() > maxWidth) || (rectangles[i].height() > maxHeight))
+            return -1;
+        
+        ordering[i] = i;
+    }
+    
+    sort(ordering.begin(), ordering.end(), detail::AreaComparator(rectangles));
+    
+    return detail::bottomLeftFill(rectangles, ordering, maxWidth, maxHeight);
+}
+
+int PackingLowerBound(const vector<PatchworkRectangle> & rectangles, unsigned int maxWidth, unsigned int maxHeight)
+{
+    long long totalArea = 0;
+    int numLarge = 0;
+    for (int i = 0; i < rectangles.size(); ++i)
+    {
+        totalArea += rectangles[i].area();
+        if ((2 * rectangles[i].width() > maxWidth) && (2 * rectangles[i].height() > maxHeight))
+            ++numLarge;
+    }
+    const long long planeArea = static_cast<long long>(maxWidth) * maxHeight;
+    return max(numLarge, static_cast<int>((totalArea + planeArea - 1) / planeArea));
+}
+
+int PackRectangles(vector<PatchworkRectangle> & rectangles, unsigned int maxWidth, unsigned int maxHeight)
+{
+    // Start with the original bottom-left fill, so that packings are only changed if planes can be saved
+    int bestPlanes = BLF(rectangles, maxWidth, maxHeight);
+    if (bestPlanes <= 1)
+        return bestPlanes;
+    
+    const int lowerBound = PackingLowerBound(rectangles, maxWidth, maxHeight);
+    if (bestPlanes <= lowerBound)
+        return bestPlanes;
+    
+    // The search prefers packings with fewer planes and, among those, packings leaving less area on
+    // their least filled plane, since they are closer to saving that plane
+    vector<PatchworkRectangle> candidate(rectangles);
+    vector<int> ordering(rectangles.size()), current;
+    int currentPlanes = 0;
+    long long currentRest = 0;
+    auto evaluate = [&]() -> bool
+    {
+        bool accepted = false;
+        for (int algo = 0; (algo < 2) && (bestPlanes > lowerBound); ++algo)
+        {
+            const int planes = (algo == 0)
+                               ? detail::bottomLeftFill(candidate, ordering, maxWidth, maxHeight)
+                               : detail::skylineFill(candidate, ordering, maxWidth, maxHeight);
+            if (planes <= 0)
+                continue;
+            vector<long long> planeAreas(planes, 0);
+            for (int i = 0; i < candidate.size(); ++i)
+                planeAreas[candidate[i].plane()] += candidate[i].area();
+            const long long rest = *min_element(planeAreas.begin(), planeAreas.end());
+            if (current.empty() || planes < currentPlanes || (planes == currentPlanes && rest < currentRest))
+            {
+                current = ordering;
+                currentPlanes = planes;
+                currentRest = rest;
+                accepted = true;
+            }
+            if (planes < bestPlanes)
+            {
+                bestPlanes = planes;
+                rectangles = candidate;
+            }
+        }
+        return accepted;
+    };
+    
+    // Try several orderings: by area, height, width, longer side and perimeter (all decreasing)
+    typedef int (*SortKey)(const PatchworkRectangle &);
+    const SortKey keys[] = {
+        [](const PatchworkRectangle & r) { return r.area(); },
+        [](const PatchworkRectangle & r) { return r.height(); },
+        [](const PatchworkRectangle & r) { return r.width(); },
+        [](const PatchworkRectangle & r) { return max(r.width(), r.height()); },
+        [](const PatchworkRectangle & r) { return r.width() + r.height(); }
+    };
+    for (int k = 0; (k < sizeof(keys) / sizeof(keys[0])) && (bestPlanes > lowerBound); ++k)
+    {
+        for (int i = 0; i < ordering.size(); ++i)
+            ordering[i] = i;
+        const SortKey key = keys[k];
+        stable_sort(ordering.begin(), ordering.end(), [&rectangles, key](int a, int b)
+        {
+            const int keyA = key(rectangles[a]), keyB = key(rectangles[b]);
+            return (keyA > keyB) || ((keyA == keyB) && (rectangles[a].area() > rectangles[b].area()));
+        });
+        evaluate();
+    }
+    
+    // Improve the best ordering found so far by swapping neighbouring rectangles
+    for (int pass = 0; (pass < 2) && (bestPlanes > lowerBound); ++pass)
+        for (int i = 0; (i + 1 < current.size()) && (bestPlanes > lowerBound); ++i)
+        {
+            ordering = current;
+            swap(ordering[i], ordering[i + 1]);
+            evaluate();
+        }
+    
+    return bestPlanes;
+}
+
+}
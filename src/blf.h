@@ -70,6 +70,47 @@ private:
 */
 int BLF(std::vector<PatchworkRectangle> & rectangles, unsigned int maxWidth, unsigned int maxHeight);
 
+/**
+* Packs rectangles into as few planes of a fixed size as possible.
+*
+* The result of BLF() is improved by trying several orderings of the rectangles (by area, height,
+* width, longer side and perimeter) with both the bottom-left fill and a skyline heuristic. The
+* search stops as soon as the number of planes reaches PackingLowerBound(). The packing found by
+* BLF() is kept unless another one needs fewer planes.
+*
+* Since every plane of a patchwork costs a forward FFT and an inverse FFT per filter, this should
+* be preferred over BLF().
+*
+* @param[in,out] rectangles A vector of rectangles with plane indices.
+* The width and height of the rectangles must be set and this function will change
+* their x and y coordinate as well as the plane index.
+*
+* @param[in] maxWidth Width of the planes.
+*
+* @param[in] maxHeight Height of the planes.
+*
+* @return Returns the number of planes needed for the rectangles. A negative number
+* will be returned on error.
+*/
+int PackRectangles(std::vector<PatchworkRectangle> & rectangles, unsigned int maxWidth, unsigned int maxHeight);
+
+/**
+* Computes a lower bound for the number of planes needed for packing a set of rectangles.
+*
+* The bound is the maximum of the number of planes needed for the total area of the rectangles
+* and the number of rectangles exceeding half of the plane size in both dimensions, since no
+* two of them fit on the same plane.
+*
+* @param[in] rectangles A vector of rectangles with width and height set.
+*
+* @param[in] maxWidth Width of the planes.
+*
+* @param[in] maxHeight Height of the planes.
+*
+* @return Returns the lower bound for the number of planes.
+*/
+int PackingLowerBound(const std::vector<PatchworkRectangle> & rectangles, unsigned int maxWidth, unsigned int maxHeight);
+
 }
 
 #endif
\ No newline at end of file
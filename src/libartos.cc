@@ -10,6 +10,7 @@
 #include "ImageNetModelLearner.h"
 #include "ImageRepository.h"
 #include "StationaryBackground.h"
+#include "StreamDetector.h"
 #include "Scene.h"
 #include "sysutils.h"
 using namespace std;
@@ -30,9 +31,11 @@ bool is_valid_learner_handle(const unsigned int learner);
 
 map< unsigned int, vector<Sample*> > eval_positive_samples;
 map< unsigned int, vector<JPEGImage> > eval_negative_samples;
+map< unsigned int, StreamDetector* > streams;
 
 int detect_jpeg(const unsigned int detector, const JPEGImage & img, FlatDetection * detection_buf, unsigned int * detection_buf_size);
 void write_results_to_buffer(const vector<Detection> & detections, FlatDetection * detection_buf, unsigned int * detection_buf_size);
+void release_stream(const unsigned int detector);
 
 
 unsigned int create_detector(const double overlap, const int interval, const bool debug)
@@ -57,6 +60,7 @@ void destroy_detector(const unsigned int detector)
     if (is_valid_detector_handle(detector))
         try
         {
+            release_stream(detector);
             delete detectors[detector - 1];
             detectors[detector - 1] = NULL;
             for (vector<Sample*>::iterator sample = eval_positive_samples[detector].begin(); sample != eval_positive_samples[detector].end(); sample++)
@@ -70,7 +74,10 @@ void destroy_detector(const unsigned int detector)
 int add_model(const unsigned int detector, const char * classname, const char * modelfile, const double threshold, const char * synset_id)
 {
     if (is_valid_detector_handle(detector))
+    {
+        release_stream(detector);
         return detectors[detector - 1]->addModel(classname, modelfile, threshold, (synset_id != NULL) ? synset_id : "");
+    }
     else
         return ARTOS_RES_INVALID_HANDLE;
 }
@@ -78,7 +85,10 @@ int add_model(const unsigned int detector, const char * classname, const char *
 int add_models(const unsigned int detector, const char * modellistfile)
 {
     if (is_valid_detector_handle(detector))
+    {
+        release_stream(detector);
         return detectors[detector - 1]->addModels(modellistfile);
+    }
     else
         return ARTOS_RES_INVALID_HANDLE;
 }
@@ -87,6 +97,7 @@ int add_model_from_learner(const unsigned int detector, const char * classname,
 {
     if (is_valid_detector_handle(detector) && is_valid_learner_handle(learner))
     {
+        release_stream(detector);
         ModelLearnerBase * learner_obj = learners[learner - 1];
         Mixture mix(learner_obj->getFeatureExtractor());
         for (size_t i = 0; i < learner_obj->getModels().size(); i++)
@@ -105,6 +116,80 @@ int num_feature_extractors_in_detector(const unsigned int detector)
         return -1;
 }
 
+int get_patchwork_geometry(const unsigned int detector, unsigned int * plane_width, unsigned int * plane_height, unsigned int * num_planes)
+{
+    if (!is_valid_detector_handle(detector))
+        return ARTOS_RES_INVALID_HANDLE;
+    
+    const Size planeSize = detectors[detector - 1]->getPlaneSize();
+    if (plane_width != NULL)
+        *plane_width = planeSize.width;
+    if (plane_height != NULL)
+        *plane_height = planeSize.height;
+    if (num_planes != NULL)
+        *num_planes = detectors[detector - 1]->getNumPlanes();
+    return ARTOS_RES_OK;
+}
+
+int set_filter_cache_policy(const unsigned int detector, const unsigned int policy, const unsigned long long budget)
+{
+    if (!is_valid_detector_handle(detector))
+        return ARTOS_RES_INVALID_HANDLE;
+    
+    switch (policy)
+    {
+        case ARTOS_FILTER_CACHE_FULL:
+            detectors[detector - 1]->setFilterCachePolicy(FilterCachePolicy::FULL, budget);
+            break;
+        case ARTOS_FILTER_CACHE_HALF_PRECISION:
+            detectors[detector - 1]->setFilterCachePolicy(FilterCachePolicy::HALF_PRECISION, budget);
+            break;
+        case ARTOS_FILTER_CACHE_ON_THE_FLY:
+            detectors[detector - 1]->setFilterCachePolicy(FilterCachePolicy::ON_THE_FLY, budget);
+            break;
+        default:
+            return ARTOS_SETTINGS_RES_INVALID_PARAMETER_VALUE;
+    }
+    return ARTOS_RES_OK;
+}
+
+int get_filter_cache_memory(const unsigned int detector, unsigned long long * bytes)
+{
+    if (!is_valid_detector_handle(detector))
+        return ARTOS_RES_INVALID_HANDLE;
+    
+    if (bytes != NULL)
+        *bytes = detectors[detector - 1]->getFilterCacheMemory();
+    return ARTOS_RES_OK;
+}
+
+int set_fft_planning_rigor(const unsigned int detector, const unsigned int rigor, const bool background_upgrade)
+{
+    if (!is_valid_detector_handle(detector))
+        return ARTOS_RES_INVALID_HANDLE;
+    
+    switch (rigor)
+    {
+        case ARTOS_FFT_PLANNING_ESTIMATE:
+            detectors[detector - 1]->setPlanningRigor(PlanningRigor::ESTIMATE, background_upgrade);
+            break;
+        case ARTOS_FFT_PLANNING_MEASURE:
+            detectors[detector - 1]->setPlanningRigor(PlanningRigor::MEASURE, background_upgrade);
+            break;
+        case ARTOS_FFT_PLANNING_PATIENT:
+            detectors[detector - 1]->setPlanningRigor(PlanningRigor::PATIENT, background_upgrade);
+            break;
+        default:
+            return ARTOS_SETTINGS_RES_INVALID_PARAMETER_VALUE;
+    }
+    return ARTOS_RES_OK;
+}
+
+void set_fftw_wisdom_file(const char * wisdom_file)
+{
+    PatchworkContext::setWisdomFile((wisdom_file != NULL) ? wisdom_file : "");
+}
+
 int detect_file_jpeg(const unsigned int detector,
                              const char * imagefile,
                              FlatDetection * detection_buf, unsigned int * detection_buf_size)
@@ -149,6 +234,82 @@ int detect_jpeg(const unsigned int detector, const JPEGImage & img, FlatDetectio
         return ARTOS_RES_INVALID_HANDLE;
 }
 
+int detect_batch_files_jpeg(const unsigned int detector,
+                            const char * const * imagefiles, const unsigned int num_images,
+                            FlatDetection * detection_buf, const unsigned int max_detections, unsigned int * num_detections,
+                            int * image_results, const unsigned int num_threads, FlatBatchStatistics * stats)
+{
+    if (!is_valid_detector_handle(detector))
+        return ARTOS_RES_INVALID_HANDLE;
+    
+    vector<JPEGImage> images(num_images);
+    int i;
+#pragma omp parallel for private(i)
+    for (i = 0; i < static_cast<int>(num_images); ++i)
+        images[i] = JPEGImage(imagefiles[i]);
+    
+    // Images which could not be read are not passed to the detector
+    vector<JPEGImage> validImages;
+    vector<unsigned int> validIndices;
+    for (unsigned int img = 0; img < num_images; ++img)
+        if (!images[img].empty())
+        {
+            validImages.push_back(move(images[img]));
+            validIndices.push_back(img);
+        }
+    
+    vector< vector<Detection> > detections;
+    vector<int> results;
+    BatchStatistics batchStats;
+    int result = detectors[detector - 1]->detectBatch(validImages, detections, &batchStats, &results, num_threads);
+    if (result == ARTOS_DETECT_RES_NO_MODELS)
+        return result;
+    
+    for (unsigned int img = 0; img < num_images; ++img)
+    {
+        num_detections[img] = 0;
+        if (image_results)
+            image_results[img] = ARTOS_DETECT_RES_INVALID_IMG_DATA;
+    }
+    for (size_t v = 0; v < validIndices.size(); ++v)
+    {
+        const unsigned int img = validIndices[v];
+        if (image_results)
+            image_results[img] = results[v];
+        if (results[v] == ARTOS_RES_OK)
+        {
+            num_detections[img] = max_detections;
+            sort(detections[v].begin(), detections[v].end());
+            write_results_to_buffer(detections[v], detection_buf + static_cast<size_t>(img) * max_detections, &num_detections[img]);
+        }
+    }
+    
+    if (stats)
+    {
+        stats->num_images = batchStats.numImages;
+        stats->num_threads = batchStats.numThreads;
+        stats->seconds = batchStats.seconds;
+        stats->images_per_second = batchStats.imagesPerSecond;
+        stats->mean_latency = batchStats.meanLatency;
+        stats->latency_p50 = batchStats.latencyP50;
+        stats->latency_p90 = batchStats.latencyP90;
+        stats->latency_p99 = batchStats.latencyP99;
+        stats->max_latency = batchStats.maxLatency;
+    }
+    
+    // Report the first failure in the order of the images given by the caller
+    for (unsigned int img = 0, v = 0; img < num_images; ++img)
+        if (v < validIndices.size() && validIndices[v] == img)
+        {
+            if (results[v] != ARTOS_RES_OK)
+                return results[v];
+            ++v;
+        }
+        else
+            return ARTOS_DETECT_RES_INVALID_IMG_DATA;
+    return ARTOS_RES_OK;
+}
+
 int detect_file_featuredump(const unsigned int detector,
                             const char * feature_dump_file, unsigned int img_width, unsigned int img_height,
                             FlatDetection * detection_buf, unsigned int * detection_buf_size)
@@ -175,6 +336,81 @@ int detect_file_featuredump(const unsigned int detector,
     return result;
 }
 
+int stream_push_raw(const unsigned int detector,
+                    const unsigned char * img_data, const unsigned int img_width, const unsigned int img_height, const bool grayscale,
+                    unsigned int * frame_id)
+{
+    if (!is_valid_detector_handle(detector))
+        return ARTOS_RES_INVALID_HANDLE;
+    if (detectors[detector - 1]->getNumModels() == 0)
+        return ARTOS_DETECT_RES_NO_MODELS;
+    JPEGImage img(img_width, img_height, (grayscale) ? 1 : 3, img_data);
+    if (img.empty())
+        return ARTOS_DETECT_RES_INVALID_IMG_DATA;
+    
+    try
+    {
+        // Start the stream with the first frame
+        StreamDetector *& stream = streams[detector];
+        if (stream == NULL)
+            stream = new StreamDetector(*(detectors[detector - 1]));
+        unsigned long long id = stream->pushFrame(img);
+        if (frame_id != NULL)
+            *frame_id = static_cast<unsigned int>(id);
+        return (id > 0) ? ARTOS_RES_OK : ARTOS_RES_INTERNAL_ERROR;
+    }
+    catch (exception e)
+    {
+        return ARTOS_RES_INTERNAL_ERROR;
+    }
+}
+
+int stream_get_detections(const unsigned int detector,
+                          FlatDetection * detection_buf, unsigned int * detection_buf_size,
+                          unsigned int * frame_id, const unsigned int timeout)
+{
+    if (!is_valid_detector_handle(detector))
+        return ARTOS_RES_INVALID_HANDLE;
+    map<unsigned int, StreamDetector*>::iterator stream = streams.find(detector);
+    if (stream == streams.end() || stream->second == NULL)
+    {
+        *detection_buf_size = 0;
+        return ARTOS_DETECT_RES_NO_RESULTS;
+    }
+    
+    vector<Detection> detections;
+    unsigned long long id = 0;
+    int result = stream->second->getDetections(detections, &id, timeout);
+    if (result == ARTOS_RES_OK)
+    {
+        sort(detections.begin(), detections.end());
+        write_results_to_buffer(detections, detection_buf, detection_buf_size);
+    }
+    else
+        *detection_buf_size = 0;
+    if (frame_id != NULL)
+        *frame_id = static_cast<unsigned int>(id);
+    return result;
+}
+
+int stream_stop(const unsigned int detector)
+{
+    if (!is_valid_detector_handle(detector))
+        return ARTOS_RES_INVALID_HANDLE;
+    release_stream(detector);
+    return ARTOS_RES_OK;
+}
+
+void release_stream(const unsigned int detector)
+{
+    map<unsigned int, StreamDetector*>::iterator stream = streams.find(detector);
+    if (stream != streams.end())
+    {
+        delete stream->second;
+        streams.erase(stream);
+    }
+}
+
 void write_results_to_buffer(const vector<Detection> & detections, FlatDetection * detection_buf, unsigned int * detection_buf_size)
 {
     vector<Detection>::const_iterator dit; // iterator over detection results
@@ -76,6 +76,22 @@ typedef struct {
     int bottom;
 } FlatDetection;
 
+/**
+* Throughput and latency of a batch of images processed by detect_batch_files_jpeg().
+* All latencies are given in milliseconds.
+*/
+typedef struct {
+    unsigned int num_images;
+    unsigned int num_threads;
+    float seconds;
+    float images_per_second;
+    float mean_latency;
+    float latency_p50;
+    float latency_p90;
+    float latency_p99;
+    float max_latency;
+} FlatBatchStatistics;
+
 /**
 * Creates a new detector instance.
 * @param[in] overlap Minimum overlap for non-maxima suppression.
@@ -148,6 +164,71 @@ int add_model_from_learner(const unsigned int detector, const char * classname,
 */
 int num_feature_extractors_in_detector(const unsigned int detector);
 
+/**
+* Retrieves the geometry of the patchwork planes used by a detector instance for computing convolutions in the Fourier domain.
+*
+* The plane size is chosen by a cost model when the first image is processed and whenever an image does not fit into the
+* current planes. The number of planes refers to the last image processed by the detector.
+* @param[in] detector The handle of the detector instance obtained by create_detector().
+* @param[out] plane_width Pointer to an integer which will receive the width of the planes (0 if no image has been processed yet).
+* @param[out] plane_height Pointer to an integer which will receive the height of the planes (0 if no image has been processed yet).
+* @param[out] num_planes Pointer to an integer which will receive the number of planes used for the last image.
+* @return Returns `ARTOS_RES_OK` on success or `ARTOS_RES_INVALID_HANDLE` if the given detector handle is invalid.
+*/
+int get_patchwork_geometry(const unsigned int detector, unsigned int * plane_width, unsigned int * plane_height, unsigned int * num_planes);
+
+/**
+* Selects how the transformed filters of the models added to a detector instance are kept in memory between detections.
+* @param[in] detector The handle of the detector instance obtained by create_detector().
+* @param[in] policy One of the following policies:
+*                   - `ARTOS_FILTER_CACHE_FULL`: Keep the transformed filters in single precision (default, fastest).
+*                   - `ARTOS_FILTER_CACHE_HALF_PRECISION`: Keep them in half precision, which halves the memory needed
+*                     at the cost of a conversion on each use and a slight loss of accuracy.
+*                   - `ARTOS_FILTER_CACHE_ON_THE_FLY`: Do not keep them, but transform the filters on each detection.
+* @param[in] budget Maximum number of bytes to be occupied by cached filters. If exceeded, the filters of the classes
+*                   used least recently will be evicted from the cache. 0 means no limit. The budget applies to each
+*                   thread processing images concurrently (e.g. the workers of detect_batch_files_jpeg()) separately,
+*                   since each of them keeps a cache of its own.
+* @return Returns `ARTOS_RES_OK` on success or one of the following error codes on failure:
+*           - `ARTOS_RES_INVALID_HANDLE`
+*           - `ARTOS_SETTINGS_RES_INVALID_PARAMETER_VALUE` (unknown policy)
+*/
+int set_filter_cache_policy(const unsigned int detector, const unsigned int policy, const unsigned long long budget = 0);
+
+/**
+* Retrieves the amount of memory occupied by the cached transformed filters of a detector instance.
+* @param[in] detector The handle of the detector instance obtained by create_detector().
+* @param[out] bytes Pointer to an integer which will receive the number of bytes occupied by the filter caches
+*                   of all threads used by the detector.
+* @return Returns `ARTOS_RES_OK` on success or `ARTOS_RES_INVALID_HANDLE` if the given detector handle is invalid.
+*/
+int get_filter_cache_memory(const unsigned int detector, unsigned long long * bytes);
+
+/**
+* Sets how much time FFTW spends on planning the transforms used by a detector instance whenever the size
+* of the images processed by it increases.
+* @param[in] detector The handle of the detector instance obtained by create_detector().
+* @param[in] rigor One of the following values:
+*                  - `ARTOS_FFT_PLANNING_ESTIMATE`: Plan heuristically (fast planning, slower transforms).
+*                  - `ARTOS_FFT_PLANNING_MEASURE`: Measure some candidate plans.
+*                  - `ARTOS_FFT_PLANNING_PATIENT`: Measure many candidate plans (default, slow planning, fastest transforms).
+* @param[in] background_upgrade If set to true and the requested plans cannot be obtained from FFTW wisdom, the detector
+*                               will start with estimated plans and switch to plans of the requested rigor as soon as
+*                               they have been created by a background thread.
+* @return Returns `ARTOS_RES_OK` on success or one of the following error codes on failure:
+*           - `ARTOS_RES_INVALID_HANDLE`
+*           - `ARTOS_SETTINGS_RES_INVALID_PARAMETER_VALUE` (unknown rigor)
+*/
+int set_fft_planning_rigor(const unsigned int detector, const unsigned int rigor, const bool background_upgrade = false);
+
+/**
+* Sets the file FFTW wisdom is loaded from and saved to by all detectors. The wisdom is kept in memory and shared by
+* all detectors, so the file is read only once and written after planning with a rigor other than `ARTOS_FFT_PLANNING_ESTIMATE`.
+* @param[in] wisdom_file Path of the wisdom file. An empty string disables loading and saving wisdom. The default is
+*                        the value of the environment variable `ARTOS_FFTW_WISDOM` or "wisdom.fftw" in the working directory.
+*/
+void set_fftw_wisdom_file(const char * wisdom_file);
+
 /**
 * Detects objects in a JPEG image file which match one of the models added before using add_model() or add_models().
 * @param[in] detector The handle of the detector instance obtained by create_detector().
@@ -213,6 +294,87 @@ int detect_raw(const unsigned int detector,
                        const unsigned char * img_data, const unsigned int img_width, const unsigned int img_height, const bool grayscale,
                        FlatDetection * detection_buf, unsigned int * detection_buf_size);
 
+/**
+* Detects objects in a batch of JPEG image files, which are processed concurrently by a pool of worker threads,
+* each processing whole images. This is faster than calling detect_file_jpeg() for each image, especially for small images.
+* @param[in] detector The handle of the detector instance obtained by create_detector().
+* @param[in] imagefiles Array with the filenames of `num_images` JPEG images.
+* @param[in] num_images The number of images.
+* @param[out] detection_buf A beforehand allocated buffer array of `num_images * max_detections` FlatDetection structs.
+*                           The detections of the i-th image, ordered descending by their score, will be stored
+*                           beginning at index `i * max_detections`.
+* @param[in] max_detections The maximum number of detections stored per image.
+* @param[out] num_detections A beforehand allocated array with `num_images` elements, which will receive the number of
+*                            detections actually stored for each image.
+* @param[out] image_results Optionally, a beforehand allocated array with `num_images` elements, which will receive the
+*                           result of each image (`ARTOS_RES_OK` or one of the error codes of detect_file_jpeg()).
+* @param[in] num_threads The number of worker threads. 0 means the number of available CPU threads.
+* @param[out] stats Optionally, a pointer to a FlatBatchStatistics struct which will receive the throughput and the
+*                   distribution of the time needed per image.
+* @return Returns `ARTOS_RES_OK` if all images have been processed successfully, otherwise the error code of the first
+*         image which failed (other images are processed nevertheless) or one of the following error codes:
+*           - `ARTOS_RES_INVALID_HANDLE`
+*           - `ARTOS_DETECT_RES_NO_MODELS`
+*/
+int detect_batch_files_jpeg(const unsigned int detector,
+                            const char * const * imagefiles, const unsigned int num_images,
+                            FlatDetection * detection_buf, const unsigned int max_detections, unsigned int * num_detections,
+                            int * image_results = 0, const unsigned int num_threads = 0, FlatBatchStatistics * stats = 0);
+
+/**
+* Pushes a frame of a video stream to the stream detector associated with a detector, which will be started with the
+* first frame. The stages of detection (feature extraction, convolution and non-maximum suppression) of consecutive frames
+* are processed concurrently in a pipeline by background threads. This function does not block: If frames are pushed faster
+* than they can be processed, frames which are still waiting for being processed are discarded in favour of the newest one.
+* The results can be retrieved using stream_get_detections().
+*
+* Adding models to the detector stops the stream.
+*
+* @param[in] detector The handle of the detector instance obtained by create_detector().
+* @param[in] img_data Pointer to the raw image data (see detect_raw()).
+* @param[in] img_width The width of the image.
+* @param[in] img_height The height of the image.
+* @param[in] grayscale If set to true, a bit depth of 1 byte per pixel is assumed (intensity), otherwise bit depth is set to 3 (RGB).
+* @param[out] frame_id Optionally, a pointer to an unsigned integer which will receive the ID of the frame. Frames are numbered
+*                      consecutively beginning with 1.
+* @return Returns `ARTOS_RES_OK` on success or one of the following error codes on failure:
+*           - `ARTOS_RES_INVALID_HANDLE`
+*           - `ARTOS_DETECT_RES_NO_MODELS`
+*           - `ARTOS_DETECT_RES_INVALID_IMG_DATA`
+*           - `ARTOS_RES_INTERNAL_ERROR`
+*/
+int stream_push_raw(const unsigned int detector,
+                    const unsigned char * img_data, const unsigned int img_width, const unsigned int img_height, const bool grayscale,
+                    unsigned int * frame_id = 0);
+
+/**
+* Retrieves the detections of the most recent frame pushed by stream_push_raw() which has been processed completely,
+* if they have not been retrieved before. Results of older frames which have not been retrieved are discarded.
+* @param[in] detector The handle of the detector instance obtained by create_detector().
+* @param[out] detection_buf A beforehand allocated buffer array of FlatDetection structs, that will be filled up with the
+*                           detection results ordered descending by their detection score.
+* @param[in,out] detection_buf_size The number of allocated array slots of `detection_buf`.
+*                                   In turn, the number of actually stored results will be written to this pointer's location.
+* @param[out] frame_id Optionally, a pointer to an unsigned integer which will receive the ID of the frame the detections belong to.
+* @param[in] timeout The maximum number of milliseconds to wait for new results. 0 means not to wait at all.
+* @return Returns `ARTOS_RES_OK` on success or one of the following error codes on failure:
+*           - `ARTOS_RES_INVALID_HANDLE`
+*           - `ARTOS_DETECT_RES_NO_RESULTS` (no new results available)
+*           - `ARTOS_DETECT_RES_INVALID_IMAGE` (the frame couldn't be processed)
+*           - `ARTOS_RES_INTERNAL_ERROR`
+*/
+int stream_get_detections(const unsigned int detector,
+                          FlatDetection * detection_buf, unsigned int * detection_buf_size,
+                          unsigned int * frame_id = 0, const unsigned int timeout = 0);
+
+/**
+* Stops the stream detector associated with a detector and discards all frames which are being processed.
+* The next call to stream_push_raw() will start a new stream.
+* @param[in] detector The handle of the detector instance obtained by create_detector().
+* @return Returns `ARTOS_RES_OK` on success or `ARTOS_RES_INVALID_HANDLE` if the given handle is invalid.
+*/
+int stream_stop(const unsigned int detector);
+
 /** @} */
 
 
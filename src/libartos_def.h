@@ -45,6 +45,16 @@
 #define ARTOS_THOPT_LOOCV 2
 
 
+#define ARTOS_FILTER_CACHE_FULL 0
+#define ARTOS_FILTER_CACHE_HALF_PRECISION 1
+#define ARTOS_FILTER_CACHE_ON_THE_FLY 2
+
+
+#define ARTOS_FFT_PLANNING_ESTIMATE 0
+#define ARTOS_FFT_PLANNING_MEASURE 1
+#define ARTOS_FFT_PLANNING_PATIENT 2
+
+
 #define ARTOS_PARAM_TYPE_INT 0
 #define ARTOS_PARAM_TYPE_SCALAR 1
 #define ARTOS_PARAM_TYPE_STRING 2
@@ -1,3 +1,3 @@
 #include "timingtools.h"
 
-std::vector<std::chrono::high_resolution_clock::time_point> TimingStarts;
\ No newline at end of file
+thread_local std::vector<std::chrono::high_resolution_clock::time_point> TimingStarts;
\ No newline at end of file
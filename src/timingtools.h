@@ -4,7 +4,7 @@
 #include <chrono>
 #include <vector>
 
-extern std::vector<std::chrono::high_resolution_clock::time_point> TimingStarts;
+extern thread_local std::vector<std::chrono::high_resolution_clock::time_point> TimingStarts;
 
 inline void start()
 {
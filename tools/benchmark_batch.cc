@@ -0,0 +1,101 @@
+/**
+* @file
+* Compares the throughput and latency of `DPMDetection` when processing a set of images one
+* after another using `DPMDetection::detect()` and concurrently using `DPMDetection::detectBatch()`.
+*
+* Usage: benchmark_batch <model-filename> <num-threads> <jpeg-filename> [<jpeg-filename> ...]
+*
+* A number of threads of 0 means the number of threads available to OpenMP.
+* Each set of images is processed twice and only the second run is reported,
+* so that FFTW planning does not distort the results.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "DPMDetection.h"
+#include "JPEGImage.h"
+#include "timingtools.h"
+using namespace std;
+using namespace ARTOS;
+
+static void printStatistics(const char * name, const BatchStatistics & stats)
+{
+    cout << setw(12) << left << name << right << fixed << setprecision(2)
+         << setw(8) << stats.imagesPerSecond << " img/s  latency mean " << setw(8) << stats.meanLatency
+         << " ms, p50 " << setw(8) << stats.latencyP50 << " ms, p90 " << setw(8) << stats.latencyP90
+         << " ms, p99 " << setw(8) << stats.latencyP99 << " ms, max " << setw(8) << stats.maxLatency << " ms" << endl;
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 4)
+    {
+        cout << "Usage: " << argv[0] << " <model-filename> <num-threads> <jpeg-filename> [<jpeg-filename> ...]" << endl;
+        return 0;
+    }
+
+    vector<JPEGImage> images;
+    for (int i = 3; i < argc; ++i)
+    {
+        JPEGImage img(argv[i]);
+        if (img.empty())
+            cerr << "Could not read image: " << argv[i] << endl;
+        else
+            images.push_back(img);
+    }
+    if (images.empty())
+        return 1;
+
+    DPMDetection detector;
+    if (detector.addModel("model", argv[1], 0.0) != ARTOS_RES_OK)
+    {
+        cerr << "Could not load model: " << argv[1] << endl;
+        return 1;
+    }
+
+    // Sequential processing
+    BatchStatistics seqStats;
+    vector<double> latencies(images.size());
+    vector<Detection> detections;
+    for (int run = 0; run < 2; ++run)
+    {
+        start();
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            start();
+            detector.detect(images[i], detections);
+            latencies[i] = stop();
+        }
+        seqStats.seconds = stop() / 1000.0;
+    }
+    sort(latencies.begin(), latencies.end());
+    seqStats.numImages = images.size();
+    seqStats.numThreads = 1;
+    seqStats.imagesPerSecond = (seqStats.seconds > 0) ? images.size() / seqStats.seconds : 0;
+    for (double latency : latencies)
+        seqStats.meanLatency += latency / latencies.size();
+    seqStats.latencyP50 = latencies[static_cast<size_t>(ceil(0.5 * latencies.size())) - 1];
+    seqStats.latencyP90 = latencies[static_cast<size_t>(ceil(0.9 * latencies.size())) - 1];
+    seqStats.latencyP99 = latencies[static_cast<size_t>(ceil(0.99 * latencies.size())) - 1];
+    seqStats.maxLatency = latencies.back();
+
+    // Batch processing
+    BatchStatistics batchStats;
+    vector< vector<Detection> > batchDetections;
+    for (int run = 0; run < 2; ++run)
+        if (detector.detectBatch(images, batchDetections, &batchStats, NULL, atoi(argv[2])) != ARTOS_RES_OK)
+        {
+            cerr << "Batch detection failed." << endl;
+            return 1;
+        }
+
+    cout << images.size() << " images" << endl;
+    printStatistics("detect", seqStats);
+    cout << "detectBatch with " << batchStats.numThreads << " threads:" << endl;
+    printStatistics("detectBatch", batchStats);
+    return 0;
+}
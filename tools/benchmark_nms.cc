@@ -0,0 +1,70 @@
+/**
+* @file
+* Compares the run-time of greedy non-maximum suppression by testing each detection against all
+* preceding survivors with `Intersector` and by `SuppressNonMaxima()` for random detections and
+* verifies that both yield identical results.
+*
+* Usage: benchmark_nms [<threshold> [<num-detections> ...]]
+*
+* The threshold of Felzenszwalb's criterion defaults to 0.5. If no numbers of detections are given,
+* 1000, 10000 and 50000 will be used.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "Rectangle.h"
+#include "Intersector.h"
+#include "NonMaximaSuppression.h"
+#include "timingtools.h"
+using namespace std;
+using namespace ARTOS;
+
+static bool sameRectangles(const vector<Rectangle> & a, const vector<Rectangle> & b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].x() != b[i].x() || a[i].y() != b[i].y() || a[i].width() != b[i].width() || a[i].height() != b[i].height())
+            return false;
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    double threshold = (argc > 1) ? atof(argv[1]) : 0.5;
+    vector<int> sizes;
+    for (int i = 2; i < argc; ++i)
+        sizes.push_back(atoi(argv[i]));
+    if (sizes.empty())
+        sizes = { 1000, 10000, 50000 };
+
+    srand(42);
+    bool allEqual = true;
+    for (int n : sizes)
+    {
+        // Detections of different size scattered over a large image, ordered by a random score
+        vector<Rectangle> rects;
+        rects.reserve(n);
+        for (int i = 0; i < n; ++i)
+            rects.push_back(Rectangle(rand() % 4000, rand() % 3000, 40 + rand() % 200, 40 + rand() % 200));
+
+        vector<Rectangle> naive = rects;
+        start();
+        for (size_t i = 1; i < naive.size(); ++i)
+            naive.resize(remove_if(naive.begin() + i, naive.end(), Intersector(naive[i - 1], threshold, true)) - naive.begin());
+        unsigned int naiveTime = stop();
+
+        vector<Rectangle> grid = rects;
+        start();
+        SuppressNonMaxima(grid, threshold, true);
+        unsigned int gridTime = stop();
+
+        bool equal = sameRectangles(naive, grid);
+        allEqual = allEqual && equal;
+        cout << n << " detections: Intersector " << naiveTime << " ms, SuppressNonMaxima " << gridTime << " ms, "
+             << grid.size() << " kept" << ((equal) ? "" : " (MISMATCH)") << endl;
+    }
+    return (allEqual) ? 0 : 1;
+}
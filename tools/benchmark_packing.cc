@@ -0,0 +1,140 @@
+/**
+* @file
+* Reports the number of patchwork planes needed for the feature pyramids of images of different
+* resolutions when packing the levels with the original bottom-left fill algorithm (`BLF()`)
+* and with `PackRectangles()`.
+*
+* Usage: benchmark_packing [<filter-size> [<width>x<height> ...]]
+*
+* The padding added to each level is derived from the given filter size (default: 8 cells).
+* If no resolutions are given, a set of common resolutions from 320x240 to 2560x1440 will be used.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "JPEGImage.h"
+#include "FeatureExtractor.h"
+#include "FeaturePyramid.h"
+#include "PatchworkContext.h"
+#include "blf.h"
+#include "timingtools.h"
+using namespace std;
+using namespace ARTOS;
+
+/**
+* Checks that all rectangles lie within their plane and do not overlap.
+*/
+static bool validPacking(const vector<PatchworkRectangle> & rectangles, int numPlanes, int maxWidth, int maxHeight)
+{
+    for (size_t i = 0; i < rectangles.size(); ++i)
+    {
+        const PatchworkRectangle & a = rectangles[i];
+        if (a.plane() < 0 || a.plane() >= numPlanes || a.x() < 0 || a.y() < 0
+                || a.x() + a.width() > maxWidth || a.y() + a.height() > maxHeight)
+            return false;
+        for (size_t j = i + 1; j < rectangles.size(); ++j)
+        {
+            const PatchworkRectangle & b = rectangles[j];
+            if (a.plane() == b.plane() && a.x() < b.x() + b.width() && b.x() < a.x() + a.width()
+                    && a.y() < b.y() + b.height() && b.y() < a.y() + a.height())
+                return false;
+        }
+    }
+    return true;
+}
+
+static void benchmark(int width, int height, const Size & filterSize)
+{
+    JPEGImage img(width, height, 3);
+    for (int i = 0; i < width * height * 3; ++i)
+        img.bits()[i] = rand() % 256;
+
+    shared_ptr<FeatureExtractor> fe = FeatureExtractor::defaultFeatureExtractor();
+    FeaturePyramid pyramid(img, fe, 10);
+    if (pyramid.empty())
+    {
+        cerr << "Could not build feature pyramid for " << width << "x" << height << endl;
+        return;
+    }
+
+    const Size padding = filterSize / 2 + 1;
+    vector<Size> levels;
+    vector<PatchworkRectangle> rectangles;
+    for (const FeatureMatrix & level : pyramid.levels())
+    {
+        levels.push_back(Size(level.cols(), level.rows()));
+        rectangles.push_back(PatchworkRectangle(level.cols() + padding.width, level.rows() + padding.height));
+    }
+
+    // Plane sizes formerly used by ARTOS and chosen by the cost model
+    start();
+    const Size chosenSize = PatchworkContext::choosePlaneSize(levels, padding, fe->numFeatures(), 1);
+    const unsigned int chooseTime = stop();
+    const Size planeSizes[] = {
+        Size((pyramid.levels()[0].cols() + filterSize.width + 2 + 15) & ~15,
+             (pyramid.levels()[0].rows() + filterSize.height + 2 + 15) & ~15),
+        chosenSize
+    };
+    const char * planeSizeNames[] = { "legacy", "cost model" };
+
+    for (int g = 0; g < 2; ++g)
+    {
+        const Size & planeSize = planeSizes[g];
+
+        vector<PatchworkRectangle> blf(rectangles), packed(rectangles);
+        start();
+        const int blfPlanes = BLF(blf, planeSize.width, planeSize.height);
+        const unsigned int blfTime = stop();
+        start();
+        const int packedPlanes = PackRectangles(packed, planeSize.width, planeSize.height);
+        const unsigned int packedTime = stop();
+
+        char resolution[32];
+        sprintf(resolution, "%dx%d", width, height);
+        cout << setw(10) << resolution << "  " << setw(3) << levels.size() << " levels  "
+             << setw(10) << planeSizeNames[g] << " " << setw(4) << planeSize.height << " x " << setw(4) << planeSize.width << "  "
+             << "lower bound " << setw(2) << PackingLowerBound(rectangles, planeSize.width, planeSize.height) << "  "
+             << "BLF " << setw(2) << blfPlanes << " (" << blfTime << " ms)  "
+             << "packed " << setw(2) << packedPlanes << " (" << packedTime << " ms)";
+        if (g == 1)
+            cout << "  (size chosen in " << chooseTime << " ms)";
+        if (!validPacking(blf, blfPlanes, planeSize.width, planeSize.height)
+                || !validPacking(packed, packedPlanes, planeSize.width, planeSize.height))
+            cout << "  INVALID PACKING";
+        cout << endl;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    const int filterSize = (argc > 1) ? atoi(argv[1]) : 8;
+    if (filterSize < 1)
+    {
+        cout << "Usage: " << argv[0] << " [<filter-size> [<width>x<height> ...]]" << endl;
+        return 1;
+    }
+
+    vector< pair<int, int> > resolutions;
+    for (int i = 2; i < argc; ++i)
+    {
+        int w, h;
+        if (sscanf(argv[i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0)
+            resolutions.push_back(make_pair(w, h));
+        else
+            cerr << "Ignoring invalid resolution: " << argv[i] << endl;
+    }
+    if (resolutions.empty())
+    {
+        const int defaults[][2] = { { 320, 240 }, { 640, 480 }, { 800, 600 }, { 1024, 768 },
+                                    { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 } };
+        for (const auto & r : defaults)
+            resolutions.push_back(make_pair(r[0], r[1]));
+    }
+
+    for (const auto & r : resolutions)
+        benchmark(r.first, r.second, Size(filterSize));
+    return 0;
+}
@@ -0,0 +1,142 @@
+/**
+* @file
+* Benchmarks the convolution of HOG feature pyramids with filters in the Fourier domain
+* using the `Patchwork` class with and without batched FFTW plans, using planes of the size
+* formerly used by ARTOS (multiples of 16) and of the FFT-friendly size chosen by the cost model
+* of `PatchworkContext::choosePlaneSize()`.
+*
+* Usage: benchmark_patchwork [<num-filters> [<repetitions> [<jpeg-filename>]]]
+*
+* If no image is given, random images of size 640x480 and 1920x1080 will be used.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include "JPEGImage.h"
+#include "FeatureExtractor.h"
+#include "FeaturePyramid.h"
+#include "PatchworkContext.h"
+#include "timingtools.h"
+using namespace std;
+using namespace ARTOS;
+
+static JPEGImage randomImage(int width, int height)
+{
+    JPEGImage img(width, height, 3);
+    for (int i = 0; i < width * height * 3; ++i)
+        img.bits()[i] = rand() % 256;
+    return img;
+}
+
+static void benchmark(const JPEGImage & img, const vector<FeatureMatrix> & filters, int repetitions)
+{
+    shared_ptr<FeatureExtractor> fe = FeatureExtractor::defaultFeatureExtractor();
+    FeaturePyramid pyramid(img, fe, 10);
+    if (pyramid.empty())
+    {
+        cerr << "Could not build feature pyramid." << endl;
+        return;
+    }
+
+    vector<const FeatureMatrix *> filterPointers;
+    for (const FeatureMatrix & filter : filters)
+        filterPointers.push_back(&filter);
+    const Size padding(filters[0].cols() / 2 + 1, filters[0].rows() / 2 + 1);
+    const int legacyRows = (pyramid.levels()[0].rows() + filters[0].rows() + 2 + 15) & ~15;
+    const int legacyCols = (pyramid.levels()[0].cols() + filters[0].cols() + 2 + 15) & ~15;
+    vector<Size> levels;
+    for (const FeatureMatrix & level : pyramid.levels())
+        levels.push_back(Size(level.cols(), level.rows()));
+    const Size planeSizes[] = {
+        Size(legacyCols, legacyRows),
+        PatchworkContext::choosePlaneSize(levels, padding, fe->numFeatures(), filters.size())
+    };
+    const char * planeSizeNames[] = { "legacy", "cost model" };
+
+    cout << "Image: " << img.width() << " x " << img.height() << ", " << pyramid.levels().size() << " levels, "
+         << filters.size() << " filters" << endl;
+
+    for (int g = 0; g < 2; ++g)
+    {
+        const int maxRows = planeSizes[g].height;
+        const int maxCols = planeSizes[g].width;
+        
+        const int batchSizes[] = { 1, 8 };
+        for (int batchSize : batchSizes)
+        {
+            PatchworkContext context;
+            if (!context.init(maxRows, maxCols, fe->numFeatures(), batchSize))
+            {
+                cerr << "Could not initialize patchwork context." << endl;
+                return;
+            }
+
+            // Transform filters
+            PatchworkContext::FilterList transformed;
+            start();
+            for (int r = 0; r < repetitions; ++r)
+                context.transformFilters(filterPointers, transformed);
+            const double filterTime = static_cast<double>(stop()) / repetitions;
+
+            // Build patchwork and convolve
+            vector< vector<ScalarMatrix> > convolutions;
+            int numPlanes = 0;
+            start();
+            for (int r = 0; r < repetitions; ++r)
+            {
+                Patchwork patchwork(context, pyramid, padding);
+                patchwork.convolve(transformed, convolutions);
+                numPlanes = patchwork.nbPlanes();
+            }
+            const double convolutionTime = static_cast<double>(stop()) / repetitions;
+
+            if (batchSize == batchSizes[0])
+                cout << "  " << planeSizeNames[g] << " planes: " << maxRows << " x " << maxCols << " x " << numPlanes
+                     << ", estimated cost " << PatchworkContext::estimateCost(planeSizes[g], numPlanes, fe->numFeatures(), filters.size()) / 1e9
+                     << " GFLOP" << endl;
+            cout << "    batch size " << setw(2) << batchSize << ": "
+                 << "filter transform " << setw(8) << filterTime << " ms, "
+                 << "patchwork + convolution " << setw(8) << convolutionTime << " ms" << endl;
+        }
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    const int numFilters = (argc > 1) ? atoi(argv[1]) : 64;
+    const int repetitions = (argc > 2) ? atoi(argv[2]) : 5;
+    if (numFilters < 1 || repetitions < 1)
+    {
+        cout << "Usage: " << argv[0] << " [<num-filters> [<repetitions> [<jpeg-filename>]]]" << endl;
+        return 1;
+    }
+
+    // Random filters
+    vector<FeatureMatrix> filters(numFilters);
+    const int numFeatures = FeatureExtractor::defaultFeatureExtractor()->numFeatures();
+    for (FeatureMatrix & filter : filters)
+    {
+        filter = FeatureMatrix(6, 6, numFeatures);
+        for (int i = 0; i < filter.numEl(); ++i)
+            filter.raw()[i] = static_cast<FeatureScalar>(rand()) / RAND_MAX - 0.5f;
+    }
+
+    if (argc > 3)
+    {
+        JPEGImage img(argv[3]);
+        if (img.empty())
+        {
+            cout << "Could not read JPEG file: " << argv[3] << endl;
+            return 2;
+        }
+        benchmark(img, filters, repetitions);
+    }
+    else
+    {
+        benchmark(randomImage(640, 480), filters, repetitions);
+        benchmark(randomImage(1920, 1080), filters, repetitions);
+    }
+    return 0;
+}
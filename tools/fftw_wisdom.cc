@@ -0,0 +1,105 @@
+/**
+* @file
+* Precomputes FFTW wisdom for a list of patchwork plane sizes, so that detectors using
+* those sizes can create their plans quickly instead of planning at run-time.
+*
+* Usage: fftw_wisdom [-o <wisdom-file>] [-f <num-features>] [-b <batch-size>] [-r estimate|measure|patient] <rows>x<cols> ...
+*
+* The wisdom is added to the given file (default: the one used by `PatchworkContext`, i.e. the value
+* of the environment variable `ARTOS_FFTW_WISDOM` or "wisdom.fftw"). The number of features defaults
+* to the number of features of the default feature extractor, the batch size to the one used by
+* `DPMDetection` and the planning rigor to "patient".
+*
+* The plane sizes used by a detector can be obtained from `DPMDetection::getPlaneSize()`.
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "FeatureExtractor.h"
+#include "PatchworkContext.h"
+#include "timingtools.h"
+using namespace std;
+using namespace ARTOS;
+
+static void printUsage(const char * progName)
+{
+    cout << "Usage: " << progName << " [-o <wisdom-file>] [-f <num-features>] [-b <batch-size>] "
+         << "[-r estimate|measure|patient] <rows>x<cols> ..." << endl;
+}
+
+int main(int argc, char * argv[])
+{
+    string wisdomFile = PatchworkContext::wisdomFile();
+    int numFeatures = FeatureExtractor::defaultFeatureExtractor()->numFeatures();
+    int batchSize = 8;
+    PlanningRigor rigor = PlanningRigor::PATIENT;
+    vector<Size> planeSizes;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            wisdomFile = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            numFeatures = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            batchSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            const string r = argv[++i];
+            if (r == "estimate")
+                rigor = PlanningRigor::ESTIMATE;
+            else if (r == "measure")
+                rigor = PlanningRigor::MEASURE;
+            else if (r == "patient")
+                rigor = PlanningRigor::PATIENT;
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else
+        {
+            int rows, cols;
+            if (sscanf(argv[i], "%dx%d", &rows, &cols) == 2 && rows > 1 && cols > 1)
+                planeSizes.push_back(Size(cols, rows));
+            else
+                cerr << "Ignoring invalid plane size: " << argv[i] << endl;
+        }
+    }
+
+    if (planeSizes.empty() || numFeatures < 1 || batchSize < 1 || wisdomFile.empty())
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    PatchworkContext::setWisdomFile(wisdomFile);
+    int numFailed = 0;
+    for (const Size & planeSize : planeSizes)
+    {
+        PatchworkContext context;
+        context.setPlanningRigor(rigor);
+        cout << planeSize.height << " x " << planeSize.width << " x " << numFeatures << ": " << flush;
+        start();
+        if (context.init(planeSize.height, planeSize.width, numFeatures, batchSize))
+            cout << stop() << " ms" << endl;
+        else
+        {
+            cout << "planning failed" << endl;
+            numFailed++;
+        }
+    }
+
+    if (!PatchworkContext::saveWisdom())
+    {
+        cerr << "Could not write " << wisdomFile << endl;
+        return 1;
+    }
+    cout << "Wisdom written to " << wisdomFile << endl;
+    return (numFailed > 0) ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+/**
+* @file
+* This tool estimates the exponents of the power law which relates the features of a downscaled
+* image to the features of the original image for each channel of the default feature extractor
+* (usually HOG). Those can be used with the `scalingExponents` parameter of `HOGFeatureExtractor`
+* for approximating feature pyramids (see `FeatureExtractor::approximatePyramid()`).
+*
+* For each scale `s` between 0.5 and 1, the mean value of each channel `c` of the features extracted
+* from the downscaled images is compared with the mean of the features extracted from the original images.
+* The exponent `lambda_c` is then fitted, so that the ratio of those means is approximately `s^-lambda_c`.
+*/
+
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "FeaturePyramid.h"
+#include "ImageRepository.h"
+using namespace ARTOS;
+using namespace std;
+
+void printHelp(const char *);
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2)
+    {
+        printHelp(argv[0]);
+        return 0;
+    }
+
+    // Collect images either from an image repository or from the given files
+    const int interval = 10;
+    vector<JPEGImage> images;
+    if (ImageRepository::hasRepositoryStructure(argv[1]))
+    {
+        unsigned int numImages = (argc >= 3) ? strtoul(argv[2], NULL, 0) : 0;
+        if (numImages == 0)
+            numImages = 1000;
+        MixedImageIterator imgIt(argv[1], 1);
+        for (imgIt.rewind(); imgIt.ready() && (unsigned int) imgIt < numImages; ++imgIt)
+        {
+            JPEGImage img = (*imgIt).getImage();
+            if (!img.empty())
+                images.push_back(img);
+        }
+    }
+    else
+        for (int i = 1; i < argc; ++i)
+        {
+            JPEGImage img(argv[i]);
+            if (img.empty())
+                cerr << "Could not read image: " << argv[i] << endl;
+            else
+                images.push_back(img);
+        }
+    if (images.empty())
+    {
+        cout << "No images found." << endl;
+        return 1;
+    }
+
+    // Average the ratio of the channel means of downscaled and original images for each scale
+    shared_ptr<FeatureExtractor> fe = FeatureExtractor::defaultFeatureExtractor();
+    const int numChannels = fe->numFeatures();
+    vector<double> scales(interval);
+    vector<FeatureCell> ratios(interval, FeatureCell::Zero(numChannels));
+    vector<FeatureCell> counts(interval, FeatureCell::Zero(numChannels));
+    for (int k = 0; k < interval; ++k)
+        scales[k] = pow(2.0, -(k + 1.0) / interval);
+    int i, k, c;
+    #pragma omp parallel for private(i, k, c)
+    for (i = 0; i < images.size(); ++i)
+    {
+        FeatureMatrix feat;
+        fe->extract(images[i], feat);
+        if (feat.numCells() == 0)
+            continue;
+        const FeatureCell mean = feat.asCellMatrix().colwise().mean().transpose();
+        for (k = 0; k < interval; ++k)
+        {
+            FeatureMatrix scaledFeat;
+            fe->extract(images[i].resize(images[i].width() * scales[k] + 0.5, images[i].height() * scales[k] + 0.5), scaledFeat);
+            if (scaledFeat.numCells() == 0)
+                continue;
+            const FeatureCell scaledMean = scaledFeat.asCellMatrix().colwise().mean().transpose();
+            #pragma omp critical
+            for (c = 0; c < numChannels; ++c)
+                if (mean(c) > 1e-6)
+                {
+                    ratios[k](c) += scaledMean(c) / mean(c);
+                    counts[k](c) += 1;
+                }
+        }
+    }
+
+    // Least-squares fit of log(ratio) = -lambda * log(s)
+    vector<FeatureScalar> exponents(numChannels, 0);
+    for (c = 0; c < numChannels; ++c)
+    {
+        double num = 0, denom = 0;
+        for (k = 0; k < interval; ++k)
+            if (counts[k](c) > 0 && ratios[k](c) > 0)
+            {
+                num += log(ratios[k](c) / counts[k](c)) * log(scales[k]);
+                denom += log(scales[k]) * log(scales[k]);
+            }
+        if (denom > 0)
+            exponents[c] = static_cast<FeatureScalar>(-num / denom);
+    }
+
+    // Compare the approximation error with and without correction
+    double errUncorrected = 0, errCorrected = 0;
+    int numComparisons = 0;
+    for (i = 0; i < images.size(); ++i)
+    {
+        FeatureMatrix feat;
+        fe->extract(images[i], feat);
+        for (k = 0; k < interval - 1; ++k)
+        {
+            FeatureMatrix scaledFeat, approx;
+            fe->extract(images[i].resize(images[i].width() * scales[k] + 0.5, images[i].height() * scales[k] + 0.5), scaledFeat);
+            const FeatureScalar norm = scaledFeat.asVector().norm();
+            if (norm <= 0)
+                continue;
+            const Size size(scaledFeat.cols(), scaledFeat.rows());
+            FeaturePyramid::approximateScale(feat, scales[k], size, vector<FeatureScalar>(), approx);
+            errUncorrected += (approx.asVector() - scaledFeat.asVector()).norm() / norm;
+            FeaturePyramid::approximateScale(feat, scales[k], size, exponents, approx);
+            errCorrected += (approx.asVector() - scaledFeat.asVector()).norm() / norm;
+            numComparisons++;
+        }
+    }
+
+    cout << "Estimated from " << images.size() << " images." << endl << endl;
+    cout << "Channel  Exponent" << endl;
+    for (c = 0; c < numChannels; ++c)
+        cout << setw(7) << c << "  " << setw(8) << fixed << setprecision(4) << exponents[c] << endl;
+    if (numComparisons > 0)
+        cout << endl << "Mean relative error of approximated features:" << endl
+             << "    without correction: " << setprecision(4) << errUncorrected / numComparisons << endl
+             << "    with correction:    " << setprecision(4) << errCorrected / numComparisons << endl;
+    cout << endl << "scalingExponents:" << endl;
+    for (c = 0; c < numChannels; ++c)
+        cout << ((c > 0) ? "," : "") << setprecision(4) << exponents[c];
+    cout << endl;
+
+    return 0;
+}
+
+
+void printHelp(const char * progName)
+{
+    cout << "Estimates the exponents of the power law relating the features of downscaled images" << endl
+         << "to those of the original images for each channel of the default feature extractor." << endl
+         << "The exponents may be used for approximating feature pyramids." << endl << endl
+         << "Usage: " << progName << " <image-repository> <num-images = 1000>" << endl
+         << "   or: " << progName << " <jpeg-filename> [<jpeg-filename> ...]" << endl << endl
+         << "ARGUMENTS" << endl << endl
+         << "    image-repository       Path to the image repository." << endl
+         << endl
+         << "    num-images             Number of images from the repository to take into account." << endl
+         << endl
+         << "    jpeg-filename          Images to take into account if no repository is given." << endl
+         << endl;
+}
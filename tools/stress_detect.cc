@@ -0,0 +1,157 @@
+/**
+* @file
+* Calls `DPMDetection::detect()` concurrently from multiple threads on a single shared detector
+* and checks that the results are the same as those obtained by detecting objects on the images
+* one after another.
+*
+* Usage: stress_detect [-s <alternate-model>] <model-filename> <num-threads> <iterations> <jpeg-filename> [<jpeg-filename> ...]
+*
+* All images are resized to the size of the first one, so that all detections use patchwork planes of
+* the same size and the results do not depend on the patchwork context used for a detection.
+* Each thread processes all images `iterations` times, starting at a different image.
+* If an alternate model is given, another thread keeps replacing the model with the alternate one and back
+* while the detections are running, whose results must then match the sequential results of either model.
+* The exit code is non-zero if any result differs from the sequential one.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DPMDetection.h"
+#include "JPEGImage.h"
+#include "timingtools.h"
+using namespace std;
+using namespace ARTOS;
+
+static bool sameDetections(const vector<Detection> & a, const vector<Detection> & b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (a[i].classname != b[i].classname || a[i].left() != b[i].left() || a[i].top() != b[i].top()
+                || a[i].width() != b[i].width() || a[i].height() != b[i].height()
+                || abs(a[i].score - b[i].score) > 1e-4 * max(static_cast<FeatureScalar>(1), abs(a[i].score)))
+            return false;
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    const char * alternateModel = NULL;
+    if (argc > 2 && string(argv[1]) == "-s")
+    {
+        alternateModel = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc < 5)
+    {
+        cout << "Usage: " << argv[0] << " [-s <alternate-model>] <model-filename> <num-threads> <iterations> <jpeg-filename> [<jpeg-filename> ...]" << endl;
+        return 0;
+    }
+    const int numThreads = max(1, atoi(argv[2]));
+    const int iterations = max(1, atoi(argv[3]));
+
+    vector<JPEGImage> images;
+    for (int i = 4; i < argc; ++i)
+    {
+        JPEGImage img(argv[i]);
+        if (img.empty())
+            cerr << "Could not read image: " << argv[i] << endl;
+        else if (!images.empty() && (img.width() != images[0].width() || img.height() != images[0].height()))
+            images.push_back(img.resize(images[0].width(), images[0].height()));
+        else
+            images.push_back(img);
+    }
+    if (images.empty())
+        return 1;
+
+    DPMDetection detector;
+    if (detector.addModel("model", argv[1], 0.0) != ARTOS_RES_OK)
+    {
+        cerr << "Could not load model: " << argv[1] << endl;
+        return 1;
+    }
+
+    // Sequential reference results
+    vector< vector<Detection> > reference(images.size());
+    start();
+    for (size_t i = 0; i < images.size(); ++i)
+        if (detector.detect(images[i], reference[i]) != ARTOS_RES_OK)
+        {
+            cerr << "Detection failed." << endl;
+            return 1;
+        }
+    const double seqSeconds = stop() / 1000.0;
+    
+    vector< vector<Detection> > alternateReference(images.size());
+    if (alternateModel)
+    {
+        if (detector.addModel("model", alternateModel, 0.0) != ARTOS_RES_OK)
+        {
+            cerr << "Could not load model: " << alternateModel << endl;
+            return 1;
+        }
+        for (size_t i = 0; i < images.size(); ++i)
+            detector.detect(images[i], alternateReference[i]);
+        detector.addModel("model", argv[1], 0.0);
+    }
+
+    // Concurrent detections on the shared detector
+    atomic<unsigned int> numMismatches(0), numFailures(0), numSwaps(0);
+    atomic<bool> finished(false);
+    auto worker = [&](int t)
+    {
+        for (int it = 0; it < iterations; ++it)
+            for (size_t k = 0; k < images.size(); ++k)
+            {
+                const size_t i = (k + t) % images.size();
+                vector<Detection> detections;
+                if (detector.detect(images[i], detections) != ARTOS_RES_OK)
+                    numFailures++;
+                else if (!sameDetections(detections, reference[i])
+                        && (!alternateModel || !sameDetections(detections, alternateReference[i])))
+                    numMismatches++;
+            }
+    };
+    auto swapper = [&]()
+    {
+        while (!finished)
+        {
+            this_thread::sleep_for(chrono::milliseconds(20));
+            detector.addModel("model", (numSwaps % 2 == 0) ? alternateModel : argv[1], 0.0);
+            numSwaps++;
+        }
+    };
+    start();
+    vector<thread> threads;
+    for (int t = 0; t < numThreads; ++t)
+        threads.push_back(thread(worker, t));
+    thread swapThread;
+    if (alternateModel)
+        swapThread = thread(swapper);
+    for (thread & t : threads)
+        t.join();
+    const double concSeconds = stop() / 1000.0;
+    finished = true;
+    if (swapThread.joinable())
+        swapThread.join();
+
+    const size_t numDetections = static_cast<size_t>(numThreads) * iterations * images.size();
+    cout << images.size() << " images of size " << images[0].width() << " x " << images[0].height() << endl;
+    cout << fixed << setprecision(2)
+         << "sequential:  " << setw(8) << ((seqSeconds > 0) ? images.size() / seqSeconds : 0) << " img/s" << endl
+         << "concurrent:  " << setw(8) << ((concSeconds > 0) ? numDetections / concSeconds : 0) << " img/s ("
+         << numThreads << " threads, " << numDetections << " detections)" << endl;
+    if (alternateModel)
+        cout << "model swaps: " << numSwaps << endl;
+    cout << "failures:    " << numFailures << endl
+         << "mismatches:  " << numMismatches << endl;
+    return (numFailures > 0 || numMismatches > 0) ? 1 : 0;
+}